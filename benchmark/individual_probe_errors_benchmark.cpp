@@ -1,5 +1,6 @@
 #include <benchmark/benchmark.h>
 #include "combinator.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
 #include "omni_sketch/standard_omni_sketch.hpp"
 
 #include <random>
@@ -11,7 +12,14 @@ static constexpr size_t ITERATION_COUNT = 1;
 static constexpr size_t MIN_PROBE_SET_SIZE = 128;
 static constexpr double SKEW = 3.0;
 
-template <bool IsUniform>
+// 32-bit samples (SampleWidth::BITS_32) keep the upper halves of the 64-bit hashes. With n_cell records and a sample
+// size of k, a cell keeps the hashes below roughly 2^64 * k / n_cell, so its truncated samples are spread over about
+// 2^32 * k / n_cell distinct values. Two cells that share no record therefore match on about k^2 / (2^32 * k / n_cell)
+// = k * n_cell / 2^32 samples, and about k * n_cell / 2^33 samples of one cell collapse into each other. Both stay far
+// below one sample as long as k * n_cell << 2^32: e.g., k * n_cell <= 2^26 adds at most 1/64 false matches per
+// intersection, which vanishes against the sampling error of the estimate itself. The *32 benchmarks below compare the
+// q-errors of both widths. Note that truncated samples must not be probed into other sketches as join keys.
+template <bool IsUniform, omnisketch::SampleWidth Width = omnisketch::SampleWidth::BITS_64>
 class ProbeErrorFixture : public benchmark::Fixture {
 public:
     void SetUp(::benchmark::State& state) override {
@@ -36,8 +44,7 @@ public:
         }
 
         if (!omni_sketch) {
-            omni_sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(SKETCH_WIDTH, SKETCH_DEPTH,
-                                                                                     min_hash_sample_size);
+            omni_sketch = CreateOmniSketch();
             cardinalities = FillOmniSketch(*omni_sketch, IsUniform);
             all_values.resize(attribute_count);
             for (size_t valueIdx = 1; valueIdx < attribute_count + 1; ++valueIdx) {
@@ -46,6 +53,18 @@ public:
         }
     }
 
+    std::shared_ptr<omnisketch::TypedPointOmniSketch<size_t>> CreateOmniSketch() const {
+        if (Width == omnisketch::SampleWidth::BITS_64) {
+            return std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(SKETCH_WIDTH, SKETCH_DEPTH,
+                                                                              min_hash_sample_size);
+        }
+        return std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+            SKETCH_WIDTH, SKETCH_DEPTH, min_hash_sample_size,
+            std::make_shared<omnisketch::MurmurHashFunction<size_t>>(), std::make_shared<omnisketch::ProbeAllSum>(),
+            std::make_shared<omnisketch::BarrettModSplitHashMapper>(SKETCH_WIDTH),
+            std::make_shared<omnisketch::MinHashSketchVector32::SketchFactory>());
+    }
+
     std::unordered_map<size_t, size_t> FillOmniSketch(omnisketch::TypedPointOmniSketch<size_t>& sketch, bool uniform) {
         std::unordered_map<size_t, size_t> cards;
         cards.reserve(attribute_count);
@@ -152,6 +171,16 @@ BENCHMARK_TEMPLATE_DEFINE_F(ProbeErrorFixture, ProbeErrorSkewed, false)(benchmar
     ProbeSketch(state);
 }
 
+BENCHMARK_TEMPLATE2_DEFINE_F(ProbeErrorFixture, ProbeErrorUniform32, true, omnisketch::SampleWidth::BITS_32)
+(benchmark::State& state) {
+    ProbeSketch(state);
+}
+
+BENCHMARK_TEMPLATE2_DEFINE_F(ProbeErrorFixture, ProbeErrorSkewed32, false, omnisketch::SampleWidth::BITS_32)
+(benchmark::State& state) {
+    ProbeSketch(state);
+}
+
 BENCHMARK_TEMPLATE_DEFINE_F(ProbeErrorFixture, SetMembershipProbeErrorUniform, true)(benchmark::State& state) {
     SetMembershipProbeSketch(state);
 }
@@ -176,6 +205,14 @@ BENCHMARK_REGISTER_F(ProbeErrorFixture, ProbeErrorSkewed)
     ->Iterations(ITERATION_COUNT)
     ->ArgsProduct({benchmark::CreateRange(1 << 3, 1 << 18, 2), {64, 1024}});
 
+BENCHMARK_REGISTER_F(ProbeErrorFixture, ProbeErrorUniform32)
+    ->Iterations(ITERATION_COUNT)
+    ->ArgsProduct({benchmark::CreateRange(1 << 3, 1 << 18, 2), {64, 1024}});
+
+BENCHMARK_REGISTER_F(ProbeErrorFixture, ProbeErrorSkewed32)
+    ->Iterations(ITERATION_COUNT)
+    ->ArgsProduct({benchmark::CreateRange(1 << 3, 1 << 18, 2), {64, 1024}});
+
 BENCHMARK_REGISTER_F(ProbeErrorFixture, SetMembershipProbeErrorUniform)
     ->Iterations(ITERATION_COUNT)
     ->ArgsProduct({benchmark::CreateRange(1 << 3, 1 << 18, 2), {64, 1024}});
@@ -16,6 +16,42 @@ BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, MultiwayIntersect64Vector, MAX
     IntersectVectors(state);
 }
 
+BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, TwoWayIntersect64Scalar, MAX_SAMPLE_SIZE_LARGE, MATCH_COUNT)
+(benchmark::State& state) {
+    IntersectSortedPairs<uint64_t>(state, omnisketch::sorted_intersection::IntersectScalar);
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, TwoWayIntersect64SIMD, MAX_SAMPLE_SIZE_LARGE, MATCH_COUNT)
+(benchmark::State& state) {
+    IntersectSortedPairs<uint64_t>(state, omnisketch::sorted_intersection::IntersectLinear);
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, TwoWayIntersect32Scalar, MAX_SAMPLE_SIZE_LARGE, MATCH_COUNT)
+(benchmark::State& state) {
+    IntersectSortedPairs<uint32_t>(state, omnisketch::sorted_intersection::IntersectScalar);
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, TwoWayIntersect32SIMD, MAX_SAMPLE_SIZE_LARGE, MATCH_COUNT)
+(benchmark::State& state) {
+    IntersectSortedPairs<uint32_t>(state, omnisketch::sorted_intersection::IntersectLinear);
+}
+
+// A point-predicate result with few samples against a full cell, e.g., in PlanNode::ExpandPrimaryKeys
+BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, SkewedIntersectLinear, MAX_SAMPLE_SIZE_LARGE, MATCH_COUNT)
+(benchmark::State& state) {
+    IntersectSkewed(state, omnisketch::IntersectionStrategy::LINEAR_MERGE);
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, SkewedIntersectGalloping, MAX_SAMPLE_SIZE_LARGE, MATCH_COUNT)
+(benchmark::State& state) {
+    IntersectSkewed(state, omnisketch::IntersectionStrategy::GALLOPING);
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, SkewedIntersectAdaptive, MAX_SAMPLE_SIZE_LARGE, MATCH_COUNT)
+(benchmark::State& state) {
+    IntersectSkewed(state, omnisketch::IntersectionStrategy::ADAPTIVE);
+}
+
 BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, MultiwayUnion64Tree, MAX_SAMPLE_SIZE_SMALL, 0)
 (benchmark::State& state) {
     UnionTrees(state);
@@ -28,6 +64,13 @@ BENCHMARK_TEMPLATE_DEFINE_F(MinHashSketchFixture, MultiwayUnion64Vector, MAX_SAM
 
 BENCHMARK_REGISTER_F(MinHashSketchFixture, MultiwayIntersect64Tree)->RangeMultiplier(2)->Range(2, 4096);
 BENCHMARK_REGISTER_F(MinHashSketchFixture, MultiwayIntersect64Vector)->RangeMultiplier(2)->Range(2, 4096);
+BENCHMARK_REGISTER_F(MinHashSketchFixture, TwoWayIntersect64Scalar)->Arg(2);
+BENCHMARK_REGISTER_F(MinHashSketchFixture, TwoWayIntersect64SIMD)->Arg(2);
+BENCHMARK_REGISTER_F(MinHashSketchFixture, TwoWayIntersect32Scalar)->Arg(2);
+BENCHMARK_REGISTER_F(MinHashSketchFixture, TwoWayIntersect32SIMD)->Arg(2);
+BENCHMARK_REGISTER_F(MinHashSketchFixture, SkewedIntersectLinear)->ArgsProduct({{2}, {1, 4, 16, 64, 256, 1024}});
+BENCHMARK_REGISTER_F(MinHashSketchFixture, SkewedIntersectGalloping)->ArgsProduct({{2}, {1, 4, 16, 64, 256, 1024}});
+BENCHMARK_REGISTER_F(MinHashSketchFixture, SkewedIntersectAdaptive)->ArgsProduct({{2}, {1, 4, 16, 64, 256, 1024}});
 BENCHMARK_REGISTER_F(MinHashSketchFixture, MultiwayUnion64Tree)->RangeMultiplier(2)->Range(2, 4096);
 BENCHMARK_REGISTER_F(MinHashSketchFixture, MultiwayUnion64Vector)->RangeMultiplier(2)->Range(2, 4096);
 
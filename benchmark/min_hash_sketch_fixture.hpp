@@ -1,6 +1,8 @@
 #pragma once
 
 #include "min_hash_sketch/min_hash_sketch_set.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector.hpp"
+#include "min_hash_sketch/sorted_intersection.hpp"
 #include "util/hash.hpp"
 
 template <unsigned int MaxSampleSize, unsigned int MatchCount>
@@ -58,6 +60,43 @@ public:
         state.counters["MatchCount"] = static_cast<double>(result_count);
     }
 
+    // Intersects the first two sketches with the given kernel; 32-bit kernels get the upper halves of the samples
+    template <class T>
+    void IntersectSortedPairs(::benchmark::State& state,
+                              size_t (*intersect)(const T*, size_t, const T*, size_t, T*)) {
+        Flatten();
+        const auto a = ToSamples<T>(sketches_flattened[0]);
+        const auto b = ToSamples<T>(sketches_flattened[1]);
+        std::vector<T> result(std::min(a.size(), b.size()));
+        size_t result_count = 0;
+        for (auto _ : state) {
+            result_count = intersect(a.data(), a.size(), b.data(), b.size(), result.data());
+            benchmark::DoNotOptimize(result.data());
+        }
+        state.counters["MatchCount"] = static_cast<double>(result_count);
+    }
+
+    // Intersects state.range(1) evenly spread samples of one sketch with all samples of another
+    void IntersectSkewed(::benchmark::State& state, omnisketch::IntersectionStrategy strategy) {
+        Flatten();
+        const auto& large = std::static_pointer_cast<omnisketch::MinHashSketchVector>(sketches_flattened[0])->Data();
+        const auto& other = std::static_pointer_cast<omnisketch::MinHashSketchVector>(sketches_flattened[1])->Data();
+        const size_t small_size = std::min(static_cast<size_t>(state.range(1)), other.size());
+        std::vector<uint64_t> small;
+        small.reserve(small_size);
+        for (size_t i = 0; i < small_size; i++) {
+            small.push_back(other[(i + 1) * other.size() / small_size - 1]);
+        }
+        std::vector<uint64_t> result(small_size);
+        size_t result_count = 0;
+        for (auto _ : state) {
+            result_count = omnisketch::sorted_intersection::Intersect(small.data(), small.size(), large.data(),
+                                                                      large.size(), result.data(), strategy);
+            benchmark::DoNotOptimize(result.data());
+        }
+        state.counters["MatchCount"] = static_cast<double>(result_count);
+    }
+
     void UnionTrees(::benchmark::State& state) {
         size_t result_count = 0;
         for (auto _ : state) {
@@ -83,6 +122,18 @@ public:
     }
 
 private:
+    template <class T>
+    static std::vector<T> ToSamples(const std::shared_ptr<omnisketch::MinHashSketch>& sketch) {
+        const auto& data = std::static_pointer_cast<omnisketch::MinHashSketchVector>(sketch)->Data();
+        std::vector<T> samples;
+        samples.reserve(data.size());
+        for (const uint64_t hash : data) {
+            samples.push_back(static_cast<T>(hash >> (64 - 8 * sizeof(T))));
+        }
+        samples.erase(std::unique(samples.begin(), samples.end()), samples.end());
+        return samples;
+    }
+
     std::vector<std::shared_ptr<omnisketch::MinHashSketch>> sketches;
     std::vector<std::shared_ptr<omnisketch::MinHashSketch>> sketches_flattened;
 };
@@ -1,6 +1,10 @@
 #include "omni_sketch_fixture.hpp"
 
 #include "include/combinator.hpp"
+#include "include/csv_importer.hpp"
+#include "include/omni_sketch/static_omni_sketch.hpp"
+
+#include <random>
 
 constexpr size_t WIDTH = 256;
 constexpr size_t DEPTH = 3;
@@ -20,6 +24,106 @@ BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, AddRecords, WIDTH, DEPTH, 1024)
     state.SetItemsProcessed(items_processed);
 }
 
+BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, AddRecordsBatched, WIDTH, DEPTH, 1024)
+(::benchmark::State& state) {
+    const auto batch_size = static_cast<size_t>(state.range());
+    std::vector<size_t> values(batch_size);
+    std::vector<uint64_t> rids(batch_size);
+
+    size_t items_processed = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (size_t i = 0; i < batch_size; i++) {
+            values[i] = current_repetition;
+            rids[i] = current_repetition;
+            current_repetition++;
+        }
+        state.ResumeTiming();
+        omni_sketch->AddRecords(values.data(), rids.data(), batch_size);
+        items_processed += batch_size;
+    }
+    state.SetItemsProcessed(items_processed);
+}
+
+// Inserts chunks of CSV tokens with state.range(0) distinct values through the import path, with (state.range(1) == 1)
+// or without the dictionary cache
+template <typename T>
+void InsertColumnChunks(benchmark::State& state, std::shared_ptr<omnisketch::TypedPointOmniSketch<T>> sketch,
+                        const std::string& token_prefix) {
+    constexpr size_t CHUNK_SIZE = 1024;
+    const auto distinct_count = static_cast<size_t>(state.range(0));
+    std::vector<std::string> tokens(distinct_count);
+    for (size_t value_idx = 0; value_idx < distinct_count; value_idx++) {
+        tokens[value_idx] = token_prefix + std::to_string(value_idx * 7919);
+    }
+    std::mt19937 gen(42);
+    std::vector<omnisketch::CSVField> column(CHUNK_SIZE);
+    std::vector<uint64_t> rids(CHUNK_SIZE);
+    auto insert_func = omnisketch::CSVImporter::CreateInsertFunc<T>(sketch, {}, state.range(1) == 1);
+
+    size_t items_processed = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (size_t row_idx = 0; row_idx < CHUNK_SIZE; row_idx++) {
+            const auto& token = tokens[gen() % distinct_count];
+            column[row_idx] = omnisketch::CSVField{token.data(), token.size()};
+            rids[row_idx] = items_processed + row_idx;
+        }
+        state.ResumeTiming();
+        insert_func(column, rids);
+        items_processed += CHUNK_SIZE;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(items_processed));
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, InsertUIntTokens, WIDTH, DEPTH, SAMPLE_COUNT)
+(::benchmark::State& state) {
+    InsertColumnChunks<size_t>(state, omni_sketch, "");
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, InsertVarcharTokens, WIDTH, DEPTH, SAMPLE_COUNT)
+(::benchmark::State& state) {
+    auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<std::string>>(
+        WIDTH, DEPTH, SAMPLE_COUNT, std::make_shared<omnisketch::MurmurHashFunction<std::string>>(),
+        std::make_shared<omnisketch::ProbeAllSum>(), std::make_shared<omnisketch::BarrettModSplitHashMapper>(WIDTH),
+        std::make_shared<omnisketch::MinHashSketchBuffered::SketchFactory>());
+    InsertColumnChunks<std::string>(state, sketch, "production company ");
+}
+
+// Maps chunks of hashes to their cells in a sketch of width state.range(1), row by row (state.range(0) == 0), all rows
+// of a hash at once (1), or the whole chunk at once (2)
+static void MapCellIdxs(benchmark::State& state) {
+    constexpr size_t CHUNK_SIZE = 1024;
+    omnisketch::BarrettModSplitHashMapper mapper(static_cast<size_t>(state.range(1)));
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> hashes(CHUNK_SIZE);
+    for (auto& hash : hashes) {
+        hash = gen();
+    }
+    std::vector<size_t> col_idxs(CHUNK_SIZE * DEPTH);
+
+    size_t items_processed = 0;
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            for (size_t hash_idx = 0; hash_idx < CHUNK_SIZE; hash_idx++) {
+                for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+                    col_idxs[hash_idx * DEPTH + row_idx] = mapper.ComputeCellIdx(hashes[hash_idx], row_idx);
+                }
+            }
+        } else if (state.range(0) == 1) {
+            for (size_t hash_idx = 0; hash_idx < CHUNK_SIZE; hash_idx++) {
+                mapper.ComputeCellIdxs(hashes[hash_idx], DEPTH, col_idxs.data() + hash_idx * DEPTH);
+            }
+        } else {
+            mapper.ComputeCellIdxs(hashes.data(), CHUNK_SIZE, DEPTH, col_idxs.data());
+        }
+        benchmark::DoNotOptimize(col_idxs.data());
+        benchmark::ClobberMemory();
+        items_processed += CHUNK_SIZE;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(items_processed));
+}
+
 BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, PointQuery, 1, 1, 1)
 (::benchmark::State& state) {
     const auto sample_count = static_cast<size_t>(state.range());
@@ -84,6 +188,211 @@ BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, PointQueryFlattened, 1, 1, 1)
     state.counters["OmniSketchSizeMB"] = static_cast<double>(omni_sketch->EstimateByteSize()) / 1024.0 / 1024.0;
 }
 
+BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, PointQueryArena, 1, 1, 1)
+(::benchmark::State& state) {
+    const auto sample_count = static_cast<size_t>(state.range());
+
+    omnisketch::OmniSketchConfig config;
+    config.sample_count = sample_count;
+    config.SetWidth(WIDTH);
+    config.depth = DEPTH;
+    config.hash_processor = std::make_shared<omnisketch::BarrettModSplitHashMapper>(WIDTH);
+    omni_sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+        config.width, config.depth, config.sample_count, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+        config.set_membership_algo, config.hash_processor);
+
+    const size_t target_record_count = WIDTH * sample_count * 8;
+    const size_t attribute_values = WIDTH * 64;
+    const size_t multiplicity = target_record_count / attribute_values;
+    FillOmniSketch(attribute_values, multiplicity);
+
+    omni_sketch->Flatten();
+
+    std::shared_ptr<omnisketch::OmniSketchCell> card;
+
+    int64_t items_processed = 0;
+    for (auto _ : state) {
+        card = omni_sketch->Probe((1 + items_processed) % target_record_count);
+        benchmark::DoNotOptimize(card);
+        items_processed++;
+    }
+
+    state.SetItemsProcessed(items_processed);
+    state.counters["OmniSketchSizeMB"] = static_cast<double>(omni_sketch->EstimateByteSize()) / 1024.0 / 1024.0;
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, PointQueryProbeContext, 1, 1, 1)
+(::benchmark::State& state) {
+    const auto sample_count = static_cast<size_t>(state.range());
+
+    omnisketch::OmniSketchConfig config;
+    config.sample_count = sample_count;
+    config.SetWidth(WIDTH);
+    config.depth = DEPTH;
+    config.hash_processor = std::make_shared<omnisketch::BarrettModSplitHashMapper>(WIDTH);
+    omni_sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+        config.width, config.depth, config.sample_count, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+        config.set_membership_algo, config.hash_processor);
+
+    const size_t target_record_count = WIDTH * sample_count * 8;
+    const size_t attribute_values = WIDTH * 64;
+    const size_t multiplicity = target_record_count / attribute_values;
+    FillOmniSketch(attribute_values, multiplicity);
+
+    omni_sketch->Flatten();
+
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    omnisketch::ProbeContext context;
+
+    int64_t items_processed = 0;
+    for (auto _ : state) {
+        omni_sketch->ProbeHash(hf.Hash((1 + items_processed) % target_record_count), context);
+        benchmark::DoNotOptimize(context.RecordCount());
+        items_processed++;
+    }
+
+    state.SetItemsProcessed(items_processed);
+    state.counters["OmniSketchSizeMB"] = static_cast<double>(omni_sketch->EstimateByteSize()) / 1024.0 / 1024.0;
+}
+
+// PointQueryProbeContext and AddRecords with a sketch of the production shape 256 x 3 x 512, which is either a
+// StaticOmniSketch (state.range(0) == 1) or a TypedPointOmniSketch
+static void StaticShapePointQuery(benchmark::State& state) {
+    constexpr size_t STATIC_SAMPLE_COUNT = 512;
+    constexpr size_t TARGET_RECORD_COUNT = WIDTH * STATIC_SAMPLE_COUNT * 8;
+    constexpr size_t ATTRIBUTE_VALUES = WIDTH * 64;
+    std::shared_ptr<omnisketch::OmniSketch> sketch;
+    if (state.range(0) == 1) {
+        auto static_sketch =
+            std::make_shared<omnisketch::StaticOmniSketch<size_t, WIDTH, DEPTH, STATIC_SAMPLE_COUNT>>();
+        for (size_t i = 0; i < TARGET_RECORD_COUNT; i++) {
+            static_sketch->AddRecord(i % ATTRIBUTE_VALUES, i);
+        }
+        sketch = static_sketch;
+    } else {
+        auto dynamic_sketch =
+            std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(WIDTH, DEPTH, STATIC_SAMPLE_COUNT);
+        for (size_t i = 0; i < TARGET_RECORD_COUNT; i++) {
+            dynamic_sketch->AddRecord(i % ATTRIBUTE_VALUES, i);
+        }
+        dynamic_sketch->Flatten();
+        sketch = dynamic_sketch;
+    }
+
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    omnisketch::ProbeContext context;
+    int64_t items_processed = 0;
+    for (auto _ : state) {
+        sketch->ProbeHash(hf.Hash((1 + items_processed) % TARGET_RECORD_COUNT), context);
+        benchmark::DoNotOptimize(context.RecordCount());
+        items_processed++;
+    }
+    state.SetItemsProcessed(items_processed);
+}
+
+static void StaticShapeAddRecords(benchmark::State& state) {
+    constexpr size_t STATIC_SAMPLE_COUNT = 512;
+    auto static_sketch = std::make_shared<omnisketch::StaticOmniSketch<size_t, WIDTH, DEPTH, STATIC_SAMPLE_COUNT>>();
+    auto dynamic_sketch =
+        std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(WIDTH, DEPTH, STATIC_SAMPLE_COUNT);
+    size_t items_processed = 0;
+    for (auto _ : state) {
+        if (state.range(0) == 1) {
+            static_sketch->AddRecord(items_processed % 50000, items_processed);
+        } else {
+            dynamic_sketch->AddRecord(items_processed % 50000, items_processed);
+        }
+        items_processed++;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(items_processed));
+}
+
+// The probes of one join expansion (MAX_JOIN_PROBE_COUNT random keys) into a flattened sketch of width state.range(1),
+// either one ProbeHash() per key (state.range(0) == 0) or one ProbeHashes() for all of them
+static void JoinExpansionProbes(benchmark::State& state) {
+    const auto width = static_cast<size_t>(state.range(1));
+    const size_t record_count = width * 64;
+    auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(width, DEPTH, 32);
+    for (size_t i = 0; i < record_count; i++) {
+        sketch->AddRecord(i % (width * 8), i);
+    }
+    sketch->Flatten();
+
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> hashes(omnisketch::MAX_JOIN_PROBE_COUNT);
+    omnisketch::ProbeContext context;
+    omnisketch::ProbeBatch batch;
+    size_t record_count_sum = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& hash : hashes) {
+            hash = hf.Hash(gen() % (width * 8));
+        }
+        state.ResumeTiming();
+        if (state.range(0) == 1) {
+            sketch->ProbeHashes(hashes.data(), hashes.size(), batch);
+            for (size_t probe_idx = 0; probe_idx < batch.Size(); probe_idx++) {
+                record_count_sum += batch.RecordCount(probe_idx);
+            }
+        } else {
+            for (const uint64_t hash : hashes) {
+                sketch->ProbeHash(hash, context);
+                record_count_sum += context.RecordCount();
+            }
+        }
+    }
+    benchmark::DoNotOptimize(record_count_sum);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * hashes.size()));
+    state.counters["OmniSketchSizeMB"] = static_cast<double>(sketch->EstimateByteSize()) / 1024.0 / 1024.0;
+}
+
+// The latency of single probes of random keys into a flattened sketch of width state.range(1), whose cells are laid out
+// row by row (state.range(0) == 0) or in blocks that hold the cells of a key in all rows (state.range(0) == 1, see
+// BlockedSplitHashMapper). Every key depends on the previous result, so the probes cannot overlap. The larger width
+// exceeds the last-level cache of most machines (about 200 MB).
+static void ProbeLatency(benchmark::State& state) {
+    const auto width = static_cast<size_t>(state.range(1));
+    const size_t value_count = width * 8;
+    std::shared_ptr<omnisketch::CellIdxMapper> mapper = std::make_shared<omnisketch::BarrettModSplitHashMapper>(width);
+    if (state.range(0) == 1) {
+        mapper = std::make_shared<omnisketch::BlockedSplitHashMapper>(width);
+    }
+    auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+        width, DEPTH, 32, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+        std::make_shared<omnisketch::ProbeAllSum>(), mapper,
+        std::make_shared<omnisketch::MinHashSketchVector::SketchFactory>());
+    std::vector<size_t> values(1024);
+    std::vector<uint64_t> rids(1024);
+    for (size_t batch_start = 0; batch_start < width * 48; batch_start += values.size()) {
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = (batch_start + i) % value_count;
+            rids[i] = batch_start + i;
+        }
+        sketch->AddRecords(values.data(), rids.data(), values.size());
+    }
+    sketch->Flatten();
+
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> keys(1 << 16);
+    for (auto& key : keys) {
+        key = gen() % value_count;
+    }
+    omnisketch::ProbeContext context;
+    size_t key_idx = 0;
+    size_t record_count = 0;
+    for (auto _ : state) {
+        // Never true, but the compiler cannot know that
+        const uint64_t key = keys[key_idx++ & (keys.size() - 1)] + (record_count == SIZE_MAX);
+        sketch->ProbeHash(hf.Hash(key), context);
+        record_count = context.RecordCount();
+    }
+    benchmark::DoNotOptimize(record_count);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.counters["OmniSketchSizeMB"] = static_cast<double>(sketch->EstimateByteSize()) / 1024.0 / 1024.0;
+}
+
 BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, ConjunctPointQueries, WIDTH, DEPTH, 10 * BYTES_PER_MB / BYTES_PER_SAMPLE)
 (::benchmark::State& state) {
     FillOmniSketch(ATTRIBUTE_VALUE_COUNT, 50);
@@ -219,8 +528,18 @@ BENCHMARK_TEMPLATE_DEFINE_F(OmniSketchFixture, SetMembershipFlattened, WIDTH, DE
 }
 
 BENCHMARK_REGISTER_F(OmniSketchFixture, AddRecords)->Iterations(10000)->Repetitions(2000);
+BENCHMARK_REGISTER_F(OmniSketchFixture, AddRecordsBatched)->Arg(1024)->Iterations(10)->Repetitions(2000);
+BENCHMARK_REGISTER_F(OmniSketchFixture, InsertUIntTokens)->ArgsProduct({{4, 64, 1024, 100000}, {0, 1}});
+BENCHMARK_REGISTER_F(OmniSketchFixture, InsertVarcharTokens)->ArgsProduct({{4, 64, 1024, 100000}, {0, 1}});
+BENCHMARK(MapCellIdxs)->ArgsProduct({{0, 1, 2}, {256, 1000}});
 BENCHMARK_REGISTER_F(OmniSketchFixture, PointQuery)->RangeMultiplier(2)->Range(128, 4096);
 BENCHMARK_REGISTER_F(OmniSketchFixture, PointQueryFlattened)->RangeMultiplier(2)->Range(128, 4096);
+BENCHMARK_REGISTER_F(OmniSketchFixture, PointQueryArena)->RangeMultiplier(2)->Range(128, 4096);
+BENCHMARK_REGISTER_F(OmniSketchFixture, PointQueryProbeContext)->RangeMultiplier(2)->Range(128, 4096);
+BENCHMARK(StaticShapePointQuery)->Arg(0)->Arg(1);
+BENCHMARK(StaticShapeAddRecords)->Arg(0)->Arg(1);
+BENCHMARK(JoinExpansionProbes)->ArgsProduct({{0, 1}, {256, 65536}});
+BENCHMARK(ProbeLatency)->ArgsProduct({{0, 1}, {4096, 262144}});
 BENCHMARK_REGISTER_F(OmniSketchFixture, ConjunctPointQueries);
 BENCHMARK_REGISTER_F(OmniSketchFixture, ConjunctPointQueriesFlattened);
 BENCHMARK_REGISTER_F(OmniSketchFixture, DisjunctPointQueries)->RangeMultiplier(2)->Range(2, 32768);
@@ -16,7 +16,7 @@ public:
         config.hash_processor = std::make_shared<omnisketch::BarrettModSplitHashMapper>(WIDTH);
         omni_sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
             config.width, config.depth, config.sample_count, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
-            config.set_membership_algo, config.hash_processor);
+            config.set_membership_algo, config.hash_processor, config.sketch_factory);
     }
 
     void FillOmniSketch(size_t value_count, size_t multiplicity,
@@ -26,12 +26,24 @@ public:
         }
         const size_t rid_count = value_count * multiplicity;
 
-        for (size_t i = 0; i < rid_count; ++i) {
-            sketch->AddRecord(i % value_count, i);
+        std::vector<size_t> values;
+        std::vector<uint64_t> rids;
+        values.reserve(FILL_BATCH_SIZE);
+        rids.reserve(FILL_BATCH_SIZE);
+        for (size_t batch_start = 0; batch_start < rid_count; batch_start += FILL_BATCH_SIZE) {
+            values.clear();
+            rids.clear();
+            for (size_t i = batch_start; i < std::min(batch_start + FILL_BATCH_SIZE, rid_count); ++i) {
+                values.push_back(i % value_count);
+                rids.push_back(i);
+            }
+            sketch->AddRecords(values.data(), rids.data(), values.size());
         }
     }
 
 protected:
+    static constexpr size_t FILL_BATCH_SIZE = 1024;
+
     std::shared_ptr<omnisketch::TypedPointOmniSketch<size_t>> omni_sketch;
     size_t current_repetition = 0;
 };
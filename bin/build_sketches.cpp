@@ -11,18 +11,27 @@ constexpr size_t DEFAULT_CELL_SIZE = 32;
 void PrintUsage(const std::string& programName) {
     std::cout << "Usage: " << programName
               << " --in=some_file.csv --table_name=some_name --column_names=col1,..,coln --data_types=uint,..,varchar "
-                 "--out=some/path [--width=16] [--depth=3] [--cell_size=32] [--ref_sketch=some_sketch.json] [--help]\n";
+                 "--out=some/path [--width=16] [--depth=3] [--cell_size=32] [--ref_sketch=some_sketch.json] "
+                 "[--threads=1] [--format=json] [--sample_width=64] [--checkpoint=some/path] [--help]\n";
     std::cout << "Options:\n";
     std::cout << "  --in=some_file.csv              Location of the table CSV file\n";
     std::cout << "  --table_name=some_name          Table name\n";
     std::cout << "  --column_names=col1,..,coln     Comma-separated column names\n";
     std::cout
         << "  --data_types=uint,..,varchar    Comma-separated data types: allowed are uint, int, double, and varchar\n";
-    std::cout << "  --out=some/path                 Target location for sketches as JSON\n";
+    std::cout << "  --out=some/path                 Target location for sketches\n";
     std::cout << "  --width=16                      OmniSketch width\n";
     std::cout << "  --depth=3                       OmniSketch depth\n";
     std::cout << "  --cell_size=32                  Min-Hash Sketch size per cell\n";
-    std::cout << "  --ref_sketch=some_sketch.json   Location of OmniSketch to be referenced\n";
+    std::cout << "  --ref_sketch=some_sketch.json   Location of OmniSketch to be referenced (JSON or binary)\n";
+    std::cout << "  --threads=1                     Number of threads that build the sketches\n";
+    std::cout << "  --format=json                   Output format: json, binary for memory-mappable .omni files, or\n";
+    std::cout << "                                  compressed for .omni files with delta-encoded samples\n";
+    std::cout << "  --sample_width=64               Bits per sample: 64, or 32 for smaller sketches with rare sample\n";
+    std::cout << "                                  collisions (keep 64 for tables that are joined on their row ids)\n";
+    std::cout << "  --checkpoint=some/path          Sketches of an earlier run to append the CSV file to. The file\n";
+    std::cout << "                                  must only hold new rids, and the sketch dimensions are taken\n";
+    std::cout << "                                  from the checkpoint\n";
     std::cout << "  --help                          Display this help message\n";
 }
 
@@ -89,40 +98,110 @@ int main(int argc, char* argv[]) {
         config.sample_count = DEFAULT_CELL_SIZE;
     }
 
+    if (options.find("sample_width") != options.end()) {
+        const size_t sample_width = std::stoul(options["sample_width"]);
+        if (sample_width != 64 && sample_width != 32) {
+            std::cerr << "Unsupported sample width: " << sample_width << std::endl;
+            return 1;
+        }
+        config.SetSampleWidth(static_cast<omnisketch::SampleWidth>(sample_width));
+    }
+
+    size_t thread_count = 1;
+    if (options.find("threads") != options.end()) {
+        thread_count = std::stoul(options["threads"]);
+    }
+
+    const std::string format = options["format"].empty() ? "json" : options["format"];
+    if (format != "json" && format != "binary" && format != "compressed") {
+        std::cerr << "Unknown format: " << format << std::endl;
+        return 1;
+    }
+    const std::string file_extension = format == "json" ? ".json" : omnisketch::sketch_file::FILE_EXTENSION;
+    const auto sample_encoding = format == "compressed" ? omnisketch::sketch_file::SampleEncoding::DELTA
+                                                        : omnisketch::sketch_file::SampleEncoding::RAW;
+    const auto serialize = [&](const std::string& table_name, const std::string& column_name,
+                               const std::string& referencing_table_name, const std::string& path) {
+        if (format == "json") {
+            omnisketch::Registry::Serialize(table_name, column_name, referencing_table_name, path);
+        } else {
+            omnisketch::Registry::SerializeBinary(table_name, column_name, referencing_table_name, path,
+                                                  sample_encoding);
+        }
+    };
+
     auto& registry = omnisketch::Registry::Get();
 
     std::string referencing_table_name;
+    std::vector<std::string> referencing_table_names;
+    std::vector<std::string> referencing_column_names;
     if (options.find("ref_sketch") != options.end()) {
         config.referencing_type = std::make_shared<omnisketch::OmniSketchType>(omnisketch::OmniSketchType::PRE_JOINED);
         registry.Deserialize(options["ref_sketch"]);
-        nlohmann::json json_obj;
-        std::ifstream file;
-        file.open(options["ref_sketch"]);
-        file >> json_obj;
-        file.close();
-        referencing_table_name = json_obj["table_name"];
-        const std::string referencingColumnName = json_obj["column_name"];
+        std::string referencingColumnName;
+        if (omnisketch::sketch_file::HasFileExtension(options["ref_sketch"])) {
+            const auto info = omnisketch::sketch_file::Map(options["ref_sketch"]).info;
+            referencing_table_name = info.table_name;
+            referencingColumnName = info.column_name;
+        } else {
+            nlohmann::json json_obj;
+            std::ifstream file;
+            file.open(options["ref_sketch"]);
+            file >> json_obj;
+            file.close();
+            referencing_table_name = json_obj["table_name"];
+            referencingColumnName = json_obj["column_name"];
+        }
+        referencing_table_names.push_back(referencing_table_name);
+        referencing_column_names.push_back(referencingColumnName);
+    }
 
-        omnisketch::CSVImporter::ImportTable(options["in"], options["table_name"], column_names,
-                                             {referencing_table_name}, {referencingColumnName}, data_types, config);
+    // Sketch files are named <table>__<column>[__<referencing table>], and the rid sample <table>__RIDS
+    const auto file_stem = [&](const std::string& column_name) {
+        std::string stem = options["table_name"] + "__" + column_name;
+        if (!referencing_table_name.empty()) {
+            stem += "__" + referencing_table_name;
+        }
+        return stem;
+    };
+    const std::string rid_file_stem = options["table_name"] + "__RIDS";
+
+    if (options.find("checkpoint") != options.end()) {
+        // Checkpoints may be written in any format
+        const auto load_checkpoint_file = [&](const std::string& stem) {
+            for (const std::string extension : {".json", omnisketch::sketch_file::FILE_EXTENSION}) {
+                const std::string path = options["checkpoint"] + "/" + stem + extension;
+                if (std::ifstream(path).good()) {
+                    registry.Deserialize(path);
+                    return true;
+                }
+            }
+            std::cerr << "Missing checkpoint file: " << options["checkpoint"] << "/" << stem << std::endl;
+            return false;
+        };
+        if (!load_checkpoint_file(rid_file_stem)) {
+            return 1;
+        }
+        for (size_t i = 1; i < column_names.size(); ++i) {
+            if (!load_checkpoint_file(file_stem(column_names[i]))) {
+                return 1;
+            }
+        }
+        omnisketch::CSVImporter::AppendTable(options["in"], options["table_name"], column_names,
+                                             referencing_table_names, referencing_column_names, data_types,
+                                             thread_count);
     } else {
-        omnisketch::CSVImporter::ImportTable(options["in"], options["table_name"], column_names, {}, {}, data_types,
-                                             config);
+        omnisketch::CSVImporter::ImportTable(options["in"], options["table_name"], column_names,
+                                             referencing_table_names, referencing_column_names, data_types, config,
+                                             thread_count);
     }
 
     for (size_t i = 1; i < column_names.size(); ++i) {
-        const auto& column_name = column_names[i];
-        std::string output_file_path = options["out"] + "/";
-        output_file_path += options["table_name"] + "__" + column_name;
-        if (!referencing_table_name.empty()) {
-            output_file_path += "__" + referencing_table_name;
-        }
-        output_file_path += ".json";
-        omnisketch::Registry::Serialize(options["table_name"], column_name, referencing_table_name, output_file_path);
+        serialize(options["table_name"], column_names[i], referencing_table_name,
+                  options["out"] + "/" + file_stem(column_names[i]) + file_extension);
     }
 
-    omnisketch::Registry::Serialize(options["table_name"], {}, {},
-                                    options["out"] + "/" + options["table_name"] + "__RIDS.json");
+    serialize(options["table_name"], {}, {}, options["out"] + "/" + rid_file_stem + file_extension);
 
     return 0;
 }
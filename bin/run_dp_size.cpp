@@ -9,11 +9,14 @@
 
 void PrintUsage(const std::string& program_name) {
     std::cout << "Usage: " << program_name
-              << " --sketches=path/to/sketches --queries=query_file [--out=path/to/out_file] [--help]\n";
+              << " --sketches=path/to/sketches --queries=query_file [--out=path/to/out_file] [--loading=eager] "
+                 "[--memory_budget=0] [--help]\n";
     std::cout << "Options:\n";
-    std::cout << "  --sketches=path/to/sketches     Directory with JSON-serialized sketches\n";
+    std::cout << "  --sketches=path/to/sketches     Directory with JSON or binary (.omni) sketches\n";
     std::cout << "  --queries=query_file            File containing the query in OmniCpp-Format\n";
     std::cout << "  --out=path/to/out_file          Target file for results\n";
+    std::cout << "  --loading=eager                 eager loads all sketches up front, lazy on their first use\n";
+    std::cout << "  --memory_budget=0               Bytes of lazily loaded sketches to keep before evicting (0: all)\n";
     std::cout << "  --help                          Display this help message\n";
 }
 
@@ -47,7 +50,12 @@ int main(int argc, char* argv[]) {
     assert(options.find("queries") != options.end());
 
     auto& registry = omnisketch::Registry::Get();
-    registry.SetSketchDirectory(options["sketches"]);
+    if (options["loading"] == "lazy") {
+        const size_t memory_budget = options["memory_budget"].empty() ? 0 : std::stoul(options["memory_budget"]);
+        registry.SetLazySketchDirectory(options["sketches"], memory_budget);
+    } else {
+        registry.SetSketchDirectory(options["sketches"]);
+    }
     std::cout << "Estimated sketch size: " << registry.EstimateByteSize() << " B\n";
 
     omnisketch::CSVImporter csvImporter;
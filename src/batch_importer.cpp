@@ -0,0 +1,211 @@
+#include "batch_importer.hpp"
+
+#include <cstring>
+
+namespace omnisketch {
+
+namespace {
+
+size_t CountValid(const uint64_t* validity, size_t row_count) {
+    if (!validity) {
+        return row_count;
+    }
+    size_t valid_count = 0;
+    for (size_t word_idx = 0; word_idx < row_count / 64; word_idx++) {
+        valid_count += static_cast<size_t>(__builtin_popcountll(validity[word_idx]));
+    }
+    if (row_count % 64 != 0) {
+        const uint64_t tail_mask = (uint64_t(1) << (row_count % 64)) - 1;
+        valid_count += static_cast<size_t>(__builtin_popcountll(validity[row_count / 64] & tail_mask));
+    }
+    return valid_count;
+}
+
+// Compares like std::string::compare
+int CompareBytes(const char* a, size_t a_size, const char* b, size_t b_size) {
+    const int result = std::memcmp(a, b, std::min(a_size, b_size));
+    if (result != 0) {
+        return result;
+    }
+    return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+}  // namespace
+
+class BatchImporter::ColumnSink {
+public:
+    virtual ~ColumnSink() = default;
+    // The rid hashes are computed once per batch and shared by all columns
+    virtual void Append(const ColumnVector& column, const uint64_t* rid_hashes, size_t row_count) = 0;
+    virtual std::shared_ptr<PointOmniSketch> Sketch() const = 0;
+};
+
+namespace {
+
+template <typename T>
+class TypedColumnSink : public BatchImporter::ColumnSink {
+public:
+    TypedColumnSink(ColumnType type_p, const OmniSketchConfig& config)
+        : type(type_p),
+          sketch(std::make_shared<TypedPointOmniSketch<T>>(
+              config.width, config.depth, config.sample_count, std::make_shared<MurmurHashFunction<T>>(),
+              config.set_membership_algo, config.hash_processor, config.sketch_factory)) {
+    }
+
+    void Append(const ColumnVector& column, const uint64_t* rid_hashes, size_t row_count) override {
+        if (column.type != type) {
+            throw std::logic_error("Column type of the batch does not match the sketch.");
+        }
+        const auto values = static_cast<const T*>(column.values);
+        const size_t valid_count = CountValid(column.validity, row_count);
+        if (valid_count == row_count) {
+            sketch->AddRecordsWithRidHashes(values, rid_hashes, row_count);
+            return;
+        }
+
+        valid_values.clear();
+        valid_rid_hashes.clear();
+        for (size_t row_idx = 0; row_idx < row_count; row_idx++) {
+            if (column.IsValid(row_idx)) {
+                valid_values.push_back(values[row_idx]);
+                valid_rid_hashes.push_back(rid_hashes[row_idx]);
+            }
+        }
+        sketch->AddNullValues(row_count - valid_count);
+        sketch->AddRecordsWithRidHashes(valid_values.data(), valid_rid_hashes.data(), valid_count);
+    }
+
+    std::shared_ptr<PointOmniSketch> Sketch() const override {
+        return sketch;
+    }
+
+private:
+    const ColumnType type;
+    std::shared_ptr<TypedPointOmniSketch<T>> sketch;
+    std::vector<T> valid_values;
+    std::vector<uint64_t> valid_rid_hashes;
+};
+
+// Hashes the strings in place, only the smallest and largest string of a batch are materialized for the bounds
+class StringColumnSink : public BatchImporter::ColumnSink {
+public:
+    explicit StringColumnSink(const OmniSketchConfig& config)
+        : sketch(std::make_shared<TypedPointOmniSketch<std::string>>(
+              config.width, config.depth, config.sample_count, std::make_shared<MurmurHashFunction<std::string>>(),
+              config.set_membership_algo, config.hash_processor, config.sketch_factory)) {
+    }
+
+    void Append(const ColumnVector& column, const uint64_t* rid_hashes, size_t row_count) override {
+        if (column.type != ColumnType::VARCHAR) {
+            throw std::logic_error("Column type of the batch does not match the sketch.");
+        }
+        const auto data = static_cast<const char*>(column.values);
+        value_hashes.clear();
+        valid_rid_hashes.clear();
+        size_t min_idx = row_count;
+        size_t max_idx = row_count;
+        for (size_t row_idx = 0; row_idx < row_count; row_idx++) {
+            if (!column.IsValid(row_idx)) {
+                continue;
+            }
+            const char* value = data + column.offsets[row_idx];
+            const size_t size = column.offsets[row_idx + 1] - column.offsets[row_idx];
+            value_hashes.push_back(hash_functions::HashBytes(value, size));
+            valid_rid_hashes.push_back(rid_hashes[row_idx]);
+            if (min_idx == row_count || CompareBytes(value, size, data + column.offsets[min_idx],
+                                                     column.offsets[min_idx + 1] - column.offsets[min_idx]) < 0) {
+                min_idx = row_idx;
+            }
+            if (max_idx == row_count || CompareBytes(value, size, data + column.offsets[max_idx],
+                                                     column.offsets[max_idx + 1] - column.offsets[max_idx]) > 0) {
+                max_idx = row_idx;
+            }
+        }
+
+        if (row_count > value_hashes.size()) {
+            sketch->AddNullValues(row_count - value_hashes.size());
+        }
+        if (value_hashes.empty()) {
+            return;
+        }
+        // The same bounds as adding the records one by one
+        std::string min = std::min(sketch->GetMin(), ToString(column, min_idx));
+        std::string max = std::max(sketch->GetMax(), ToString(column, max_idx));
+        sketch->SetMin(min);
+        sketch->SetMax(max);
+        sketch->AddRecordsHashed(value_hashes.data(), valid_rid_hashes.data(), value_hashes.size());
+    }
+
+    std::shared_ptr<PointOmniSketch> Sketch() const override {
+        return sketch;
+    }
+
+private:
+    static std::string ToString(const ColumnVector& column, size_t row_idx) {
+        const auto data = static_cast<const char*>(column.values);
+        return std::string(data + column.offsets[row_idx], column.offsets[row_idx + 1] - column.offsets[row_idx]);
+    }
+
+    std::shared_ptr<TypedPointOmniSketch<std::string>> sketch;
+    std::vector<uint64_t> value_hashes;
+    std::vector<uint64_t> valid_rid_hashes;
+};
+
+}  // namespace
+
+BatchImporter::BatchImporter(std::string table_name_p, std::vector<std::string> column_names_p,
+                             const std::vector<ColumnType>& types, const OmniSketchConfig& config)
+    : table_name(std::move(table_name_p)),
+      column_names(std::move(column_names_p)),
+      rids(std::make_shared<OmniSketchCell>(config.sample_count)) {
+    assert(types.size() == column_names.size());
+    sinks.reserve(types.size());
+    for (const auto type : types) {
+        switch (type) {
+            case ColumnType::INT:
+                sinks.push_back(std::make_unique<TypedColumnSink<int32_t>>(type, config));
+                break;
+            case ColumnType::UINT:
+                sinks.push_back(std::make_unique<TypedColumnSink<size_t>>(type, config));
+                break;
+            case ColumnType::DOUBLE:
+                sinks.push_back(std::make_unique<TypedColumnSink<double>>(type, config));
+                break;
+            case ColumnType::VARCHAR:
+                sinks.push_back(std::make_unique<StringColumnSink>(config));
+                break;
+        }
+    }
+}
+
+BatchImporter::~BatchImporter() = default;
+
+void BatchImporter::Append(const ColumnBatch& batch) {
+    if (finished) {
+        throw std::logic_error("The sketches of the table have already been registered.");
+    }
+    if (batch.columns.size() != sinks.size()) {
+        throw std::logic_error("Batch does not have the columns of the table.");
+    }
+    rid_hashes.resize(batch.row_count);
+    for (size_t row_idx = 0; row_idx < batch.row_count; row_idx++) {
+        rid_hashes[row_idx] = hash_functions::MurmurHash64(batch.rids[row_idx]);
+    }
+    rids->AddRecords(rid_hashes.data(), batch.row_count);
+    for (size_t column_idx = 0; column_idx < sinks.size(); column_idx++) {
+        sinks[column_idx]->Append(batch.columns[column_idx], rid_hashes.data(), batch.row_count);
+    }
+}
+
+void BatchImporter::Finish() {
+    TableEntry columns;
+    for (size_t column_idx = 0; column_idx < sinks.size(); column_idx++) {
+        auto sketch = sinks[column_idx]->Sketch();
+        sketch->Flatten();
+        columns[column_names[column_idx]] = OmniSketchEntry{std::move(sketch), {}};
+    }
+    Registry::Get().ReplaceTable(table_name, columns, rids);
+    finished = true;
+}
+
+}  // namespace omnisketch
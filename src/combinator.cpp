@@ -1,28 +1,56 @@
 #include "combinator.hpp"
 
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
 #include "omni_sketch/pre_joined_omni_sketch.hpp"
 #include "omni_sketch/standard_omni_sketch.hpp"
 
 namespace omnisketch {
 
-size_t GetMaxRecordCount(const std::vector<std::shared_ptr<OmniSketchCell>>& matches) {
-    size_t max_record_count = 0;
-    for (const auto& match : matches) {
-        max_record_count = std::max(max_record_count, match->RecordCount());
+// The (hash, n_max) pairs and counts that one thread collects for a part of a probe set
+struct ProbeRun {
+    std::vector<std::pair<uint64_t, uint64_t>> hashes;
+    size_t cardinality = 0;
+    size_t max_record_count_sum = 0;
+};
+
+void ProbeAll(const OmniSketch& omni_sketch, const uint64_t* probe_hashes, size_t probe_count,
+              size_t max_sample_count, ProbeRun& run) {
+    ProbeBatch batch;
+    omni_sketch.ProbeHashes(probe_hashes, probe_count, batch, max_sample_count);
+    for (size_t probe_idx = 0; probe_idx < batch.Size(); probe_idx++) {
+        const size_t max_record_count = batch.MaxRecordCount(probe_idx);
+        run.max_record_count_sum += max_record_count;
+        for (auto hash = batch.SamplesBegin(probe_idx); hash != batch.SamplesEnd(probe_idx); hash++) {
+            run.hashes.emplace_back(*hash, max_record_count);
+        }
+        run.cardinality += batch.RecordCount(probe_idx);
     }
-    return max_record_count;
-}
 
-void AddResultHashesToMap(const std::shared_ptr<OmniSketchCell>& result, const std::shared_ptr<MinHashSketchMap>& map,
-                          size_t max_record_count) {
-    for (auto it = result->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
-        map->AddRecord(it->Current(), max_record_count);
+    // Later probes overwrite the n_max of a hash, so keep the last pair of every hash
+    std::stable_sort(run.hashes.begin(), run.hashes.end(),
+                     [](const std::pair<uint64_t, uint64_t>& lhs, const std::pair<uint64_t, uint64_t>& rhs) {
+                         return lhs.first < rhs.first;
+                     });
+    size_t unique_count = 0;
+    for (const auto& hash : run.hashes) {
+        if (unique_count > 0 && run.hashes[unique_count - 1].first == hash.first) {
+            run.hashes[unique_count - 1] = hash;
+        } else {
+            run.hashes[unique_count++] = hash;
+        }
     }
+    run.hashes.resize(unique_count);
+}
+
+bool HasNarrowSamples(const OmniSketch& omni_sketch) {
+    const auto* point_omni_sketch = dynamic_cast<const PointOmniSketch*>(&omni_sketch);
+    return point_omni_sketch && point_omni_sketch->GetSampleWidth() == SampleWidth::BITS_32;
 }
 
 void CombinedPredicateEstimator::AddPredicate(const std::shared_ptr<OmniSketch>& omni_sketch,
                                               const std::shared_ptr<OmniSketchCell>& probe_sample) {
     base_card = std::max(base_card, omni_sketch->RecordCount());
+    has_narrow_samples |= HasNarrowSamples(*omni_sketch);
 
     if (probe_sample->SampleCount() > MAX_JOIN_PROBE_COUNT) {
         probe_sample->SetMinHashSketch(probe_sample->GetMinHashSketch()->Resize(MAX_JOIN_PROBE_COUNT));
@@ -32,26 +60,24 @@ void CombinedPredicateEstimator::AddPredicate(const std::shared_ptr<OmniSketch>&
     predicate_result.is_set_membership = probe_sample->SampleCount() > 1;
     predicate_result.sampling_probability = probe_sample->SamplingProbability();
 
-    std::vector<std::shared_ptr<OmniSketchCell>> matches(omni_sketch->Depth());
-
     if (probe_sample->SampleCount() == 1) {
-        ProcessSingleSamplePredicate(omni_sketch, probe_sample, matches, predicate_result);
+        ProbeContext probe_context;
+        ProcessSingleSamplePredicate(omni_sketch, probe_sample, probe_context, predicate_result);
         return;
     }
 
-    ProcessMultiSamplePredicate(omni_sketch, probe_sample, matches, predicate_result);
+    ProcessMultiSamplePredicate(omni_sketch, probe_sample, predicate_result);
 }
 
 void CombinedPredicateEstimator::ProcessSingleSamplePredicate(const std::shared_ptr<OmniSketch>& omni_sketch,
                                                               const std::shared_ptr<OmniSketchCell>& probe_sample,
-                                                              std::vector<std::shared_ptr<OmniSketchCell>>& matches,
+                                                              ProbeContext& probe_context,
                                                               PredicateResult& predicate_result) {
-    auto probe_result =
-        omni_sketch->ProbeHash(probe_sample->GetMinHashSketch()->Iterator()->Current(), matches, max_sample_count);
+    omni_sketch->ProbeHash(probe_sample->GetMinHashSketch()->Iterator()->Current(), probe_context, max_sample_count);
 
-    predicate_result.sketch = probe_result->GetMinHashSketch();
-    predicate_result.n_max = GetMaxRecordCount(matches);
-    predicate_result.selectivity = static_cast<double>(probe_result->RecordCount()) / static_cast<double>(base_card);
+    predicate_result.sketch = probe_context.ToCell()->GetMinHashSketch();
+    predicate_result.n_max = probe_context.MaxRecordCount();
+    predicate_result.selectivity = static_cast<double>(probe_context.RecordCount()) / static_cast<double>(base_card);
 
     if (predicate_result.selectivity == 0.0) {
         const double normalized_max_count =
@@ -64,20 +90,41 @@ void CombinedPredicateEstimator::ProcessSingleSamplePredicate(const std::shared_
 
 void CombinedPredicateEstimator::ProcessMultiSamplePredicate(const std::shared_ptr<OmniSketch>& omni_sketch,
                                                              const std::shared_ptr<OmniSketchCell>& probe_sample,
-                                                             std::vector<std::shared_ptr<OmniSketchCell>>& matches,
                                                              PredicateResult& predicate_result) {
+    std::vector<uint64_t> probe_hashes;
+    probe_hashes.reserve(probe_sample->SampleCount());
+    for (auto probe_it = probe_sample->GetMinHashSketch()->Iterator(); !probe_it->IsAtEnd(); probe_it->Next()) {
+        probe_hashes.push_back(probe_it->Current());
+    }
+
+    // Every thread probes a contiguous part of the probe set into a sorted run, which are merged in probe order
+    size_t thread_count = 1;
+    if (omni_sketch->IsFlattened()) {
+        thread_count = std::min(thread_pool->WorkerCount() + 1, probe_hashes.size() / MIN_PROBES_PER_THREAD);
+        thread_count = std::max<size_t>(thread_count, 1);
+    }
+    std::vector<ProbeRun> runs(thread_count);
+    auto probe_part = [&](size_t thread_idx) {
+        const size_t begin = probe_hashes.size() * thread_idx / thread_count;
+        const size_t end = probe_hashes.size() * (thread_idx + 1) / thread_count;
+        ProbeAll(*omni_sketch, probe_hashes.data() + begin, end - begin, max_sample_count, runs[thread_idx]);
+    };
+    if (thread_count == 1) {
+        probe_part(0);
+    } else {
+        thread_pool->ParallelFor(thread_count, probe_part);
+    }
+
     size_t cardinality = 0;
-    auto result_map = std::make_shared<MinHashSketchMap>(UINT64_MAX);
-    predicate_result.sketch = result_map;
     size_t max_record_count_sum = 0;
-
-    for (auto probe_it = probe_sample->GetMinHashSketch()->Iterator(); !probe_it->IsAtEnd(); probe_it->Next()) {
-        auto probe_result = omni_sketch->ProbeHash(probe_it->Current(), matches, max_sample_count);
-        const size_t max_record_count = GetMaxRecordCount(matches);
-        max_record_count_sum += max_record_count;
-        AddResultHashesToMap(probe_result, result_map, max_record_count);
-        cardinality += probe_result->RecordCount();
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> run_hashes;
+    run_hashes.reserve(runs.size());
+    for (auto& run : runs) {
+        cardinality += run.cardinality;
+        max_record_count_sum += run.max_record_count_sum;
+        run_hashes.push_back(std::move(run.hashes));
     }
+    predicate_result.sketch = MinHashSketchMap::FromSortedRuns(run_hashes, UINT64_MAX);
 
     predicate_result.selectivity = static_cast<double>(cardinality) / static_cast<double>(base_card);
 
@@ -188,6 +235,7 @@ std::shared_ptr<OmniSketchCell> CombinedPredicateEstimator::FilterProbeSet(
     const std::shared_ptr<OmniSketch>& omni_sketch, const std::shared_ptr<OmniSketchCell>& probe_sample) const {
     CombinedPredicateEstimator estimator(omni_sketch->MinHashSketchSize());
     estimator.intermediate_results = intermediate_results;
+    estimator.has_narrow_samples = has_narrow_samples;
     estimator.AddPredicate(omni_sketch, probe_sample);
     return estimator.ComputeResult(probe_sample->MaxSampleCount());
 }
@@ -198,6 +246,7 @@ void CombinedPredicateEstimator::AddUnfilteredRids(const std::shared_ptr<OmniSke
                                    static_cast<double>(omni_sketch->RecordCount());
     predicate_result.is_set_membership = true;
     predicate_result.sampling_probability = 1.0;
+    has_narrow_samples |= HasNarrowSamples(*omni_sketch);
     auto all_rids = omni_sketch->GetRids();
     predicate_result.sketch = all_rids->GetMinHashSketch();
     intermediate_results.push_back(std::move(predicate_result));
@@ -207,6 +256,7 @@ void CombinedPredicateEstimator::AddUnfilteredRids(const std::shared_ptr<OmniSke
                                                    size_t base_card_p) {
     base_card = std::max(base_card, probe_sample->RecordCount());
     base_card = std::max(base_card, base_card_p);
+    has_narrow_samples |= dynamic_cast<const MinHashSketchVector32*>(probe_sample->GetMinHashSketch().get()) != nullptr;
     PredicateResult predicate_result{probe_sample->GetMinHashSketch(), 1.0, 1.0, 1.0, true, 0};
     intermediate_results.push_back(std::move(predicate_result));
 }
@@ -215,6 +265,13 @@ bool CombinedPredicateEstimator::HasPredicates() const {
     return !intermediate_results.empty();
 }
 
+void CombinedPredicateEstimator::CheckJoinKeys(const std::string& table_name) const {
+    if (has_narrow_samples) {
+        throw std::runtime_error("Table " + table_name +
+                                 " has 32-bit samples, so its record ids cannot be probed as join keys.");
+    }
+}
+
 // Order intermediate results descending by selectivity to get matches as long as possible
 void CombinedPredicateEstimator::Finalize() {
     if (intermediate_results.size() <= 1) {
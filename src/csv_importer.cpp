@@ -3,6 +3,7 @@
 #include "execution/plan_node.hpp"
 #include "execution/query_graph.hpp"
 #include "registry.hpp"
+#include "util/thread_pool.hpp"
 
 namespace omnisketch {
 
@@ -10,117 +11,280 @@ void CSVImporter::ImportTable(const std::string& path, const std::string& table_
                               const std::vector<std::string>& column_names,
                               const std::vector<std::string>& referencing_table_names,
                               const std::vector<std::string>& referencing_column_names,
-                              const std::vector<ColumnType>& types, const OmniSketchConfig& config) {
+                              const std::vector<ColumnType>& types, const OmniSketchConfig& config,
+                              size_t thread_count) {
     std::vector<OmniSketchConfig> configs(column_names.size(), config);
     ImportTable(path, table_name, column_names, referencing_table_names, referencing_column_names, types,
-                std::move(configs));
+                std::move(configs), thread_count);
 }
 
-template <typename T>
-std::function<void(const std::string&, const size_t)> CreateExtendingSketchAndFunc(
-    const std::string& table_name, const std::string& column_name,
-    const std::vector<std::string>& referencing_table_names, const std::vector<std::string>& referencing_column_names,
-    const OmniSketchConfig& config) {
-    auto& registry = Registry::Get();
+InsertFunc CreateRidInsertFunc(std::shared_ptr<OmniSketchCell> rids) {
+    std::vector<uint64_t> rid_hashes;
+    return [rids, rid_hashes](const std::vector<CSVField>&, const std::vector<uint64_t>& chunk_rids) mutable {
+        rid_hashes.resize(chunk_rids.size());
+        for (size_t rid_idx = 0; rid_idx < chunk_rids.size(); rid_idx++) {
+            rid_hashes[rid_idx] = hash_functions::MurmurHash64(chunk_rids[rid_idx]);
+        }
+        rids->AddRecords(rid_hashes.data(), rid_hashes.size());
+    };
+}
 
-    registry.CreateOmniSketch<T>(table_name, column_name, config);
-    if (!config.referencing_type) {
-        return CSVImporter::CreateInsertFunc<T>(table_name, column_name);
+// The sketches of a table that one import thread fills. sketches and insert_funcs are indexed like the table's
+// columns, the first column holds the rids, which go into the rid sketch.
+struct TableSketches {
+    void Combine(const TableSketches& other) {
+        rids->Combine(*other.rids);
+        for (size_t i = 1; i < sketches.size(); i++) {
+            sketches[i]->Combine(other.sketches[i]);
+        }
     }
 
-    if (*config.referencing_type == OmniSketchType::PRE_JOINED) {
+    std::shared_ptr<OmniSketchCell> rids;
+    std::vector<std::shared_ptr<OmniSketch>> sketches;
+    std::vector<InsertFunc> insert_funcs;
+    // The sketches (including pre-joined ones) by column name, as they are registered
+    TableEntry columns;
+};
+
+template <typename T>
+void AddColumnSketches(const std::string& column_name, const std::vector<std::string>& referencing_table_names,
+                       const std::vector<std::string>& referencing_column_names, const OmniSketchConfig& config,
+                       TableSketches& table_sketches) {
+    // All sketches share the cell mapper of the config, which is stateless, so they can still be filled and probed
+    // concurrently
+    auto sketch = std::make_shared<TypedPointOmniSketch<T>>(
+        config.width, config.depth, config.sample_count, std::make_shared<MurmurHashFunction<T>>(),
+        config.set_membership_algo, config.hash_processor, config.sketch_factory);
+    OmniSketchEntry entry{sketch, {}};
+
+    std::vector<std::shared_ptr<PreJoinedOmniSketch<T>>> ref_sketches;
+    if (config.referencing_type) {
+        if (*config.referencing_type != OmniSketchType::PRE_JOINED) {
+            throw std::runtime_error("Referencing type not supported.");
+        }
         for (size_t i = 0; i < referencing_table_names.size(); ++i) {
-            registry.CreateExtendingOmniSketch<PreJoinedOmniSketch<T>, T>(
-                table_name, column_name, referencing_table_names[i], referencing_column_names[i], config);
+            auto ref_sketch = std::make_shared<PreJoinedOmniSketch<T>>(
+                Registry::Get().GetOmniSketch(referencing_table_names[i], referencing_column_names[i]), config.width,
+                config.depth, config.sample_count, std::make_shared<MurmurHashFunction<T>>(),
+                config.set_membership_algo, config.hash_processor, config.sketch_factory);
+            entry.referencing_sketches[referencing_table_names[i]] = ref_sketch;
+            ref_sketches.push_back(ref_sketch);
         }
-        return CSVImporter::CreateInsertFunc<T, PreJoinedOmniSketch<T>>(table_name, column_name,
-                                                                        referencing_table_names);
     }
 
-    throw std::runtime_error("Referencing type not supported.");
+    table_sketches.sketches.push_back(sketch);
+    table_sketches.insert_funcs.push_back(CSVImporter::CreateInsertFunc<T>(sketch, ref_sketches));
+    table_sketches.columns[column_name] = std::move(entry);
 }
 
-bool ReadLogicalLine(std::ifstream& in, std::string& line_out) {
-    line_out.clear();
-    bool escaping = false;
-
-    char c;
-    while (in.get(c)) {
-        if (escaping) {
-            line_out += '\\';  // preserve the backslash
-            line_out += c;     // preserve escaped char (e.g., 'n')
-            escaping = false;
-        } else if (c == '\\') {
-            escaping = true;
-        } else if (c == '\n') {
-            // Unescaped newline: end of logical line
-            return true;
-        } else {
-            line_out += c;
+TableSketches CreateTableSketches(const std::vector<std::string>& column_names,
+                                  const std::vector<std::string>& referencing_table_names,
+                                  const std::vector<std::string>& referencing_column_names,
+                                  const std::vector<ColumnType>& types, const std::vector<OmniSketchConfig>& configs) {
+    TableSketches table_sketches;
+    table_sketches.rids = std::make_shared<OmniSketchCell>(configs.front().sample_count);
+    table_sketches.sketches.emplace_back();
+    table_sketches.insert_funcs.push_back(CreateRidInsertFunc(table_sketches.rids));
+    for (size_t i = 1; i < types.size(); i++) {
+        switch (types[i]) {
+            case ColumnType::INT: {
+                AddColumnSketches<int32_t>(column_names[i], referencing_table_names, referencing_column_names,
+                                           configs[i], table_sketches);
+                break;
+            }
+            case ColumnType::UINT: {
+                AddColumnSketches<size_t>(column_names[i], referencing_table_names, referencing_column_names,
+                                          configs[i], table_sketches);
+                break;
+            }
+            case ColumnType::DOUBLE: {
+                AddColumnSketches<double>(column_names[i], referencing_table_names, referencing_column_names,
+                                          configs[i], table_sketches);
+                break;
+            }
+            case ColumnType::VARCHAR: {
+                AddColumnSketches<std::string>(column_names[i], referencing_table_names, referencing_column_names,
+                                               configs[i], table_sketches);
+                break;
+            }
         }
     }
+    return table_sketches;
+}
 
-    // If we reached EOF and accumulated content, return the final line
-    return !line_out.empty();
+void CSVImporter::ImportLines(CSVReader reader, size_t begin, size_t end, std::vector<InsertFunc>& insert_funcs) {
+    // The lines are inserted in chunks of IMPORT_CHUNK_SIZE rows, which are stored column-wise
+    const size_t column_count = insert_funcs.size();
+    std::vector<uint64_t> chunk_rids;
+    std::vector<std::vector<CSVField>> chunk_columns(column_count);
+    auto insert_chunk = [&]() {
+        for (size_t i = 0; i < column_count; i++) {
+            insert_funcs[i](chunk_columns[i], chunk_rids);
+            chunk_columns[i].clear();
+        }
+        chunk_rids.clear();
+        reader.ClearUnquotedLines();
+    };
+
+    size_t position = begin;
+    std::vector<CSVField> fields;
+    while (reader.ReadLine(position, end, fields)) {
+        if (fields.empty()) {
+            continue;
+        }
+        if (fields.size() < column_count) {
+            throw std::runtime_error("Line with rid " + fields[0].ToString() + " has too few fields.");
+        }
+        chunk_rids.push_back(CSVReader::Parse<size_t>(fields[0]));
+        for (size_t i = 1; i < column_count; i++) {
+            chunk_columns[i].push_back(fields[i]);
+        }
+        if (chunk_rids.size() == IMPORT_CHUNK_SIZE) {
+            insert_chunk();
+        }
+    }
+    insert_chunk();
 }
 
 void CSVImporter::ImportTable(const std::string& path, const std::string& table_name,
                               const std::vector<std::string>& column_names,
                               const std::vector<std::string>& referencing_table_names,
                               const std::vector<std::string>& referencing_column_names,
-                              const std::vector<ColumnType>& types, std::vector<OmniSketchConfig> configs) {
+                              const std::vector<ColumnType>& types, std::vector<OmniSketchConfig> configs,
+                              size_t thread_count) {
     assert(types.size() == column_names.size());
     assert(types.size() == configs.size());
     assert(types.size() > 1);
     assert(types.front() == ColumnType::UINT);
     std::cout << "Reading " << table_name << " table file..." << std::endl;
 
-    std::vector<std::function<void(const std::string&, const size_t)>> insert_funcs;
-    insert_funcs.reserve(column_names.size());
+    // Pre-joined sketches probe the referenced sketch, whose cell mapper must not be shared between threads
+    for (const auto& config : configs) {
+        if (config.referencing_type && thread_count > 1) {
+            std::cout << "Building pre-joined sketches with a single thread." << std::endl;
+            thread_count = 1;
+        }
+    }
+    thread_count = std::max<size_t>(thread_count, 1);
 
-    auto rids = Registry::Get().CreateRidSketch(table_name, configs.front().sample_count);
-    insert_funcs.emplace_back(
-        [&rids](const std::string&, const size_t rid) { rids->AddRecord(hash_functions::MurmurHash64(rid)); });
+    // The sketches are only registered once they are complete, which atomically replaces the previous sketches of
+    // the table (if any)
+    std::vector<TableSketches> table_sketches;
+    table_sketches.reserve(thread_count);
+    for (size_t thread_idx = 0; thread_idx < thread_count; thread_idx++) {
+        table_sketches.push_back(
+            CreateTableSketches(column_names, referencing_table_names, referencing_column_names, types, configs));
+    }
+    ReadTableFile(path, table_sketches);
 
+    auto& result = table_sketches.front();
     for (size_t i = 1; i < column_names.size(); i++) {
-        switch (types[i]) {
-            case ColumnType::INT: {
-                insert_funcs.emplace_back(CreateExtendingSketchAndFunc<int32_t>(
-                    table_name, column_names[i], referencing_table_names, referencing_column_names, configs[i]));
-                break;
-            }
-            case ColumnType::UINT: {
-                insert_funcs.emplace_back(CreateExtendingSketchAndFunc<size_t>(
-                    table_name, column_names[i], referencing_table_names, referencing_column_names, configs[i]));
-                break;
-            }
-            case ColumnType::DOUBLE: {
-                insert_funcs.emplace_back(CreateExtendingSketchAndFunc<double>(
-                    table_name, column_names[i], referencing_table_names, referencing_column_names, configs[i]));
-                break;
-            }
-            case ColumnType::VARCHAR: {
-                insert_funcs.emplace_back(CreateExtendingSketchAndFunc<std::string>(
-                    table_name, column_names[i], referencing_table_names, referencing_column_names, configs[i]));
-                break;
-            }
-        }
+        result.sketches[i]->Flatten();
     }
+    Registry::Get().ReplaceTable(table_name, result.columns, result.rids);
+}
 
-    std::ifstream table_stream(path);
-    std::string line;
-    while (ReadLogicalLine(table_stream, line)) {
-        auto tokens = Split(line);
-        size_t rid = std::stoul(tokens[0]);
-        insert_funcs.front()({}, rid);
-        for (size_t i = 1; i < column_names.size(); i++) {
-            insert_funcs[i](tokens[i], rid);
+void CSVImporter::AppendTable(const std::string& path, const std::string& table_name,
+                              const std::vector<std::string>& column_names,
+                              const std::vector<std::string>& referencing_table_names,
+                              const std::vector<std::string>& referencing_column_names,
+                              const std::vector<ColumnType>& types, size_t thread_count) {
+    assert(types.size() == column_names.size());
+    assert(types.size() > 1);
+    auto& registry = Registry::Get();
+    const auto snapshot = registry.Snapshot();
+    const auto previous_rids = snapshot->FindRidSample(table_name);
+    if (!previous_rids) {
+        throw std::runtime_error("No sketches to append to for table " + table_name + ".");
+    }
+
+    std::vector<OmniSketchConfig> configs(column_names.size());
+    configs.front().sample_count = previous_rids->MaxSampleCount();
+    for (size_t i = 1; i < column_names.size(); i++) {
+        // Columns may only have kept their pre-joined sketches, which share the dimensions of the main sketch
+        auto previous = snapshot->FindOmniSketch(table_name, column_names[i]);
+        if (!previous && !referencing_table_names.empty()) {
+            previous =
+                snapshot->FindReferencingOmniSketch(table_name, column_names[i], referencing_table_names.front());
+        }
+        if (!previous) {
+            throw std::runtime_error("No sketch to append to for column " + table_name + "." + column_names[i] + ".");
+        }
+        configs[i].SetWidth(previous->Width());
+        configs[i].depth = previous->Depth();
+        configs[i].sample_count = previous->MinHashSketchSize();
+        configs[i].SetSampleWidth(previous->GetSampleWidth());
+        if (!referencing_table_names.empty()) {
+            configs[i].referencing_type = std::make_shared<OmniSketchType>(OmniSketchType::PRE_JOINED);
         }
     }
+    std::cout << "Appending to " << table_name << " sketches..." << std::endl;
 
-    table_stream.close();
+    std::vector<TableSketches> table_sketches;
+    const size_t sketch_count = referencing_table_names.empty() ? std::max<size_t>(thread_count, 1) : 1;
+    table_sketches.reserve(sketch_count);
+    for (size_t thread_idx = 0; thread_idx < sketch_count; thread_idx++) {
+        table_sketches.push_back(
+            CreateTableSketches(column_names, referencing_table_names, referencing_column_names, types, configs));
+    }
+    ReadTableFile(path, table_sketches);
+
+    // Registered sketches may be read concurrently, so they are combined into the new ones instead of the other way
+    auto& result = table_sketches.front();
+    result.rids->Combine(*previous_rids);
     for (size_t i = 1; i < column_names.size(); i++) {
-        Registry::Get().GetOmniSketch(table_name, column_names[i])->Flatten();
+        auto& entry = result.columns.at(column_names[i]);
+        const auto previous = snapshot->FindOmniSketch(table_name, column_names[i]);
+        if (previous) {
+            entry.main_sketch->Combine(previous);
+            entry.main_sketch->Flatten();
+        } else {
+            // Without a previous main sketch, the new one would only hold the appended rows
+            entry.main_sketch = nullptr;
+        }
+        for (auto& referencing_sketch : entry.referencing_sketches) {
+            const auto previous_referencing =
+                snapshot->FindReferencingOmniSketch(table_name, column_names[i], referencing_sketch.first);
+            if (!previous_referencing) {
+                throw std::runtime_error("No pre-joined sketch to append to for column " + table_name + "." +
+                                         column_names[i] + " referencing " + referencing_sketch.first + ".");
+            }
+            referencing_sketch.second->Combine(previous_referencing);
+            referencing_sketch.second->Flatten();
+        }
+    }
+    registry.ReplaceTable(table_name, result.columns, result.rids);
+}
+
+void CSVImporter::ReadTableFile(const std::string& path, std::vector<TableSketches>& table_sketches) {
+    const size_t thread_count = table_sketches.size();
+    const CSVReader reader(path);
+    if (thread_count == 1) {
+        ImportLines(reader, 0, reader.FileSize(), table_sketches.front().insert_funcs);
+        return;
+    }
+
+    // Split the file into byte ranges that begin at line starts
+    const size_t file_size = reader.FileSize();
+    std::vector<size_t> range_starts(thread_count + 1, file_size);
+    for (size_t thread_idx = 0; thread_idx < thread_count; thread_idx++) {
+        range_starts[thread_idx] = reader.FindLineStart(file_size / thread_count * thread_idx);
+    }
+
+    // Every thread reads through its own copy of the reader, which shares the mapping
+    ThreadPool thread_pool(thread_count - 1);
+    thread_pool.ParallelFor(thread_count, [&](size_t thread_idx) {
+        ImportLines(reader, range_starts[thread_idx], range_starts[thread_idx + 1],
+                    table_sketches[thread_idx].insert_funcs);
+    });
+
+    // Min-hash sketches are mergeable, so combining the partial sketches in a tree yields the serial result
+    for (size_t stride = 1; stride < thread_count; stride *= 2) {
+        const size_t pair_count = (thread_count - stride + 2 * stride - 1) / (2 * stride);
+        thread_pool.ParallelFor(pair_count, [&](size_t pair_idx) {
+            const size_t target_idx = pair_idx * 2 * stride;
+            table_sketches[target_idx].Combine(table_sketches[target_idx + stride]);
+        });
     }
 }
 
@@ -553,9 +717,4 @@ double CSVImporter::ConvertString<double>(const std::string& in) {
     return std::stod(in);
 }
 
-template <>
-uint64_t CSVImporter::ConvertString<uint64_t>(const std::string& in) {
-    return std::stoull(in);
-}
-
 }  // namespace omnisketch
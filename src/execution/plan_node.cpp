@@ -2,6 +2,7 @@
 
 #include "combinator.hpp"
 #include "min_hash_sketch/min_hash_sketch_map.hpp"
+#include "min_hash_sketch/min_hash_sketch_span.hpp"
 #include "registry.hpp"
 
 namespace omnisketch {
@@ -83,6 +84,9 @@ std::shared_ptr<OmniSketchCell> PlanNode::Estimate() const {
         estimator.AddUnfilteredRids(registry.GetRidSample(table_name), base_card);
     }
     estimator.Finalize();
+    if (!pk_join_expansions.empty()) {
+        estimator.CheckJoinKeys(table_name);
+    }
 
     auto result = estimator.ComputeResult(UINT64_MAX);
 
@@ -120,21 +124,49 @@ std::shared_ptr<OmniSketchCell> PlanNode::ExpandPrimaryKeys(const std::string& c
     auto remaining_primary_keys = std::make_shared<OmniSketchCell>(primary_keys.MaxSampleCount());
     double result_card = 0;
 
-    std::vector<std::shared_ptr<OmniSketchCell>> matches(omni_sketch->Depth());
-    size_t probe_count = 0;
-    for (auto pk_it = primary_keys.GetMinHashSketch()->Iterator();
-         !pk_it->IsAtEnd() && probe_count++ < MAX_JOIN_PROBE_COUNT; pk_it->Next()) {
-        auto probe_result = omni_sketch->ProbeHash(pk_it->Current(), matches);
-        size_t n_max = 0;
-        for (auto& match : matches) {
-            n_max = std::max(n_max, match->RecordCount());
+    // The filtered rids are intersected with every probe result, so we extract their samples only once
+    std::vector<uint64_t> filtered_rid_samples;
+    size_t filtered_rid_sample_limit = 0;
+    if (has_predicates) {
+        filtered_rid_sample_limit = std::min(filtered_rids->MaxSampleCount(), omni_sketch->MinHashSketchSize());
+        for (auto it = filtered_rids->GetMinHashSketch()->Iterator(filtered_rid_sample_limit); !it->IsAtEnd();
+             it->Next()) {
+            filtered_rid_samples.push_back(it->Current());
         }
-        if (probe_result->RecordCount() > 0) {
+    }
+
+    std::vector<uint64_t> probe_hashes;
+    for (auto pk_it = primary_keys.GetMinHashSketch()->Iterator();
+         !pk_it->IsAtEnd() && probe_hashes.size() < MAX_JOIN_PROBE_COUNT; pk_it->Next()) {
+        probe_hashes.push_back(pk_it->Current());
+    }
+    ProbeBatch probe_batch;
+    omni_sketch->ProbeHashes(probe_hashes.data(), probe_hashes.size(), probe_batch);
+
+    std::vector<const uint64_t*> offsets(2);
+    std::vector<const uint64_t*> ends(2);
+    std::vector<uint64_t> filtered_probe_samples;
+    for (size_t probe_idx = 0; probe_idx < probe_batch.Size(); probe_idx++) {
+        const size_t probe_card = probe_batch.RecordCount(probe_idx);
+        const size_t n_max = probe_batch.MaxRecordCount(probe_idx);
+        if (probe_card > 0) {
             if (has_predicates) {
-                auto filtered_probe_result = OmniSketchCell::Intersect({probe_result, filtered_rids});
-                if (filtered_probe_result->RecordCount() > 0) {
-                    remaining_primary_keys->GetMinHashSketch()->AddRecord(pk_it->Current());
-                    result_card += (double)filtered_probe_result->RecordCount();
+                offsets[0] = probe_batch.SamplesBegin(probe_idx);
+                ends[0] = offsets[0] + std::min(probe_batch.SampleCount(probe_idx), filtered_rid_sample_limit);
+                offsets[1] = filtered_rid_samples.data();
+                ends[1] = offsets[1] + filtered_rid_samples.size();
+                filtered_probe_samples.clear();
+                MinHashSketchSpan::IntersectSorted(offsets, ends, filtered_probe_samples);
+
+                const bool probe_is_larger = probe_card >= filtered_rids->RecordCount();
+                const size_t filtered_probe_card = OmniSketchCell::EstimateIntersectionCard(
+                    std::min(probe_card, filtered_rids->RecordCount()),
+                    std::max(probe_card, filtered_rids->RecordCount()),
+                    probe_is_larger ? probe_batch.SampleCount(probe_idx) : filtered_rids->SampleCount(),
+                    filtered_probe_samples.size());
+                if (filtered_probe_card > 0) {
+                    remaining_primary_keys->GetMinHashSketch()->AddRecord(probe_hashes[probe_idx]);
+                    result_card += (double)filtered_probe_card;
                 } else {
                     double match_granularity = (double)n_max / (double)omni_sketch->MinHashSketchSize();
                     result_card += match_granularity * filter_selectivity;
@@ -199,16 +231,12 @@ PlanNode::OmniSketchProbeResultSet PlanNode::EstimatePredicate(const std::shared
     OmniSketchProbeResultSet result_set;
     result_set.p_sample = probe_values.SamplingProbability();
 
-    std::vector<std::shared_ptr<OmniSketchCell>> matches(omni_sketch->Depth());
+    ProbeContext probe_context;
 
     if (probe_values.SampleCount() == 1) {
-        auto probe_result = omni_sketch->ProbeHash(probe_values.GetMinHashSketch()->Iterator()->Current(), matches);
-        if (probe_result->RecordCount() > 0) {
-            size_t n_max = 0;
-            for (auto& match : matches) {
-                n_max = std::max(n_max, match->RecordCount());
-            }
-            result_set.results.push_back(OmniSketchProbeResult{n_max, probe_result});
+        omni_sketch->ProbeHash(probe_values.GetMinHashSketch()->Iterator()->Current(), probe_context);
+        if (probe_context.RecordCount() > 0) {
+            result_set.results.push_back(OmniSketchProbeResult{probe_context.MaxRecordCount(), probe_context.ToCell()});
         } else {
             result_set.results.push_back(OmniSketchProbeResult{0, std::make_shared<OmniSketchCell>()});
         }
@@ -217,21 +245,24 @@ PlanNode::OmniSketchProbeResultSet PlanNode::EstimatePredicate(const std::shared
 
     auto probe_result_map = std::make_shared<MinHashSketchMap>(UINT64_MAX);
 
+    std::vector<uint64_t> probe_hashes;
+    probe_hashes.reserve(probe_values.SampleCount());
+    for (auto join_key_it = probe_values.GetMinHashSketch()->Iterator(); !join_key_it->IsAtEnd(); join_key_it->Next()) {
+        probe_hashes.push_back(join_key_it->Current());
+    }
+    ProbeBatch probe_batch;
+    omni_sketch->ProbeHashes(probe_hashes.data(), probe_hashes.size(), probe_batch);
+
     size_t card_sum = 0;
     size_t n_max_sum = 0;
-    for (auto join_key_it = probe_values.GetMinHashSketch()->Iterator(); !join_key_it->IsAtEnd(); join_key_it->Next()) {
-        auto hash = join_key_it->Current();
-        auto probe_result = omni_sketch->ProbeHash(hash, matches);
-        size_t n_max = 0;
-        for (auto& match : matches) {
-            n_max = std::max(n_max, match->RecordCount());
-        }
+    for (size_t probe_idx = 0; probe_idx < probe_batch.Size(); probe_idx++) {
+        const size_t n_max = probe_batch.MaxRecordCount(probe_idx);
         n_max_sum += n_max;
 
-        for (auto it = probe_result->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
-            probe_result_map->AddRecord(it->Current(), n_max);
+        for (auto sample = probe_batch.SamplesBegin(probe_idx); sample != probe_batch.SamplesEnd(probe_idx); sample++) {
+            probe_result_map->AddRecord(*sample, n_max);
         }
-        card_sum += probe_result->RecordCount();
+        card_sum += probe_batch.RecordCount(probe_idx);
     }
     probe_result_map->ShrinkToSize();
 
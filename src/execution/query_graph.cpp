@@ -2,6 +2,7 @@
 
 #include "registry.hpp"
 
+#include <chrono>
 #include <iostream>
 #include <queue>
 #include <sstream>
@@ -9,6 +10,8 @@
 namespace omnisketch {
 
 double QueryGraph::Estimate() {
+    // All lookups of this estimate see the same sketches, even if they are replaced concurrently
+    Registry::SnapshotPin snapshot_pin;
     while (graph.size() > 1) {
         bool removed_node = TryMergeSingleConnection();
 
@@ -415,6 +418,7 @@ std::string TreeToString(JoinNode* root) {
 }
 
 std::vector<DpSizeResult> QueryGraph::RunDpSizeAlgo() {
+    Registry::SnapshotPin snapshot_pin;
     auto& registry = Registry::Get();
     std::unordered_map<size_t, std::vector<QueryPlan>> best_plans;
     std::unordered_map<std::string, double> estimates;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "csv_importer.hpp"
+#include "registry.hpp"
+
+namespace omnisketch {
+
+// One column of a ColumnBatch. The values are an array of the column's type (int32_t for INT, size_t for UINT, double
+// for DOUBLE) or, for VARCHAR, the concatenated bytes of the strings, of which string row_idx spans
+// [offsets[row_idx], offsets[row_idx + 1]). Bit row_idx % 64 of validity[row_idx / 64] is set for the rows that are
+// not null; without a validity bitmap, no row is null. All arrays are borrowed for the duration of
+// BatchImporter::Append().
+struct ColumnVector {
+    static ColumnVector FromValues(const int32_t* values, const uint64_t* validity = nullptr) {
+        return ColumnVector{ColumnType::INT, values, nullptr, validity};
+    }
+    static ColumnVector FromValues(const size_t* values, const uint64_t* validity = nullptr) {
+        return ColumnVector{ColumnType::UINT, values, nullptr, validity};
+    }
+    static ColumnVector FromValues(const double* values, const uint64_t* validity = nullptr) {
+        return ColumnVector{ColumnType::DOUBLE, values, nullptr, validity};
+    }
+    static ColumnVector FromStrings(const char* data, const uint32_t* offsets, const uint64_t* validity = nullptr) {
+        return ColumnVector{ColumnType::VARCHAR, data, offsets, validity};
+    }
+
+    bool IsValid(size_t row_idx) const {
+        return !validity || ((validity[row_idx / 64] >> (row_idx % 64)) & 1) != 0;
+    }
+
+    ColumnType type;
+    const void* values;
+    const uint32_t* offsets;
+    const uint64_t* validity;
+};
+
+struct ColumnBatch {
+    size_t row_count = 0;
+    const uint64_t* rids = nullptr;
+    // Indexed like the value columns of the BatchImporter
+    std::vector<ColumnVector> columns;
+};
+
+// Fills the sketches of a table from columnar batches, e.g., as produced by the scan operator of an engine, without a
+// CSV round trip. Every column of a batch goes into its typed sketch at once: values (strings, too) are hashed in
+// place, and only columns with nulls are compacted first. Like CSVImporter::ImportTable, Finish() registers the
+// sketches, replacing earlier sketches of the same columns. Readers may probe the registered sketches from then on, so
+// Append() throws after Finish().
+class BatchImporter {
+public:
+    class ColumnSink;
+
+    // The value columns of the table; the rids of every batch are passed separately
+    BatchImporter(std::string table_name_p, std::vector<std::string> column_names_p,
+                  const std::vector<ColumnType>& types, const OmniSketchConfig& config = OmniSketchConfig());
+    ~BatchImporter();
+
+    void Append(const ColumnBatch& batch);
+    void Finish();
+
+private:
+    std::string table_name;
+    std::vector<std::string> column_names;
+    std::shared_ptr<OmniSketchCell> rids;
+    std::vector<std::unique_ptr<ColumnSink>> sinks;
+    bool finished = false;
+    // Reused between batches
+    std::vector<uint64_t> rid_hashes;
+};
+
+}  // namespace omnisketch
@@ -2,11 +2,14 @@
 
 #include "min_hash_sketch/min_hash_sketch_map.hpp"
 #include "omni_sketch/omni_sketch.hpp"
+#include "util/thread_pool.hpp"
 #include "util/value.hpp"
 
 namespace omnisketch {
 
 constexpr size_t MAX_JOIN_PROBE_COUNT = 32;
+// Probe sets are only distributed over multiple threads if every thread gets at least this many probes
+constexpr size_t MIN_PROBES_PER_THREAD = 8;
 
 class PredicateConverter {
 public:
@@ -53,7 +56,8 @@ struct PredicateResult {
 
 class CombinedPredicateEstimator {
 public:
-    explicit CombinedPredicateEstimator(size_t max_sample_count_p) : max_sample_count(max_sample_count_p) {
+    explicit CombinedPredicateEstimator(size_t max_sample_count_p, ThreadPool& thread_pool_p = ThreadPool::Global())
+        : max_sample_count(max_sample_count_p), thread_pool(&thread_pool_p) {
     }
     void AddPredicate(const std::shared_ptr<OmniSketch>& omni_sketch,
                       const std::shared_ptr<OmniSketchCell>& probe_sample);
@@ -67,22 +71,28 @@ public:
     void SetBaseCard(size_t base_card_p) {
         base_card = base_card_p;
     }
+    // The samples of the result are record id hashes of the estimated table. Joins probe them as keys into the sketches
+    // of referencing tables, which needs the full 64-bit hashes: a 32-bit sample maps to other cells than the hash it
+    // was truncated from. Throws if a sketch of this estimate has 32-bit samples.
+    void CheckJoinKeys(const std::string& table_name) const;
 
 private:
     void ProcessSingleSamplePredicate(const std::shared_ptr<OmniSketch>& omni_sketch,
                                       const std::shared_ptr<OmniSketchCell>& probe_sample,
-                                      std::vector<std::shared_ptr<OmniSketchCell>>& matches,
-                                      PredicateResult& predicateResult);
+                                      ProbeContext& probe_context, PredicateResult& predicateResult);
 
     void ProcessMultiSamplePredicate(const std::shared_ptr<OmniSketch>& omni_sketch,
                                      const std::shared_ptr<OmniSketchCell>& probe_sample,
-                                     std::vector<std::shared_ptr<OmniSketchCell>>& matches,
                                      PredicateResult& predicateResult);
 
 protected:
     std::vector<PredicateResult> intermediate_results;
     size_t max_sample_count;
     size_t base_card = 0;
+    // Whether the samples of a predicate or the unfiltered rids are 32-bit (see SampleWidth)
+    bool has_narrow_samples = false;
+    // Evaluates the probes of set-membership predicates
+    ThreadPool* thread_pool;
 };
 
 }  // namespace omnisketch
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "dictionary_cache.hpp"
 #include "execution/query_graph.hpp"
 #include "omni_sketch/pre_joined_omni_sketch.hpp"
 #include "plan_generator.hpp"
 #include "registry.hpp"
+#include "util/csv_reader.hpp"
 
 #include <fstream>
 #include <iostream>
@@ -13,6 +15,11 @@ namespace omnisketch {
 
 enum class ColumnType { INT, UINT, DOUBLE, VARCHAR };
 
+// Inserts a chunk of a column's fields together with their record ids
+using InsertFunc = std::function<void(const std::vector<CSVField>&, const std::vector<uint64_t>&)>;
+
+struct TableSketches;
+
 struct RelationInfo {
     std::vector<std::string> predicates;
     std::map<std::string, std::string> join_conditions;
@@ -30,12 +37,25 @@ public:
                             const std::vector<std::string>& column_names,
                             const std::vector<std::string>& referencing_table_names,
                             const std::vector<std::string>& referencing_column_names,
-                            const std::vector<ColumnType>& types, const OmniSketchConfig& config = OmniSketchConfig());
+                            const std::vector<ColumnType>& types, const OmniSketchConfig& config = OmniSketchConfig(),
+                            size_t thread_count = 1);
+    // The sketches are registered once the whole file has been read, replacing earlier sketches of the same columns.
+    // With multiple threads, every thread builds private sketches for a byte range of the file, which are combined
+    // afterwards. Pre-joined sketches are always built by a single thread.
     static void ImportTable(const std::string& path, const std::string& table_name,
                             const std::vector<std::string>& column_names,
                             const std::vector<std::string>& referencing_table_names,
                             const std::vector<std::string>& referencing_column_names,
-                            const std::vector<ColumnType>& types, std::vector<OmniSketchConfig> configs);
+                            const std::vector<ColumnType>& types, std::vector<OmniSketchConfig> configs,
+                            size_t thread_count = 1);
+    // Appends the rows of the file to the registered sketches of the table (e.g., as loaded from a checkpoint) and
+    // registers the result. The rows must have new record ids. The new rows are sketched with the dimensions of the
+    // registered sketches, and the registered sketches are combined into them, since min-hash sketches are mergeable.
+    static void AppendTable(const std::string& path, const std::string& table_name,
+                            const std::vector<std::string>& column_names,
+                            const std::vector<std::string>& referencing_table_names,
+                            const std::vector<std::string>& referencing_column_names,
+                            const std::vector<ColumnType>& types, size_t thread_count = 1);
     static void ImportTables(const std::string& path_to_definition_file);
     static std::vector<CountQuery> ImportQueries(const std::string& path_to_query_file);
 
@@ -49,23 +69,13 @@ public:
     }
 
     template <typename T>
-    static std::function<void(const std::string&, const size_t)> CreateInsertFunc(const std::string& table_name,
-                                                                                  const std::string& column_name) {
-        auto& registry = Registry::Get();
-        auto sketch = registry.GetOmniSketchTyped<T>(table_name, column_name);
-
-        return [sketch](const std::string& val, const size_t rid) {
-            if (val.empty()) {
-                sketch->AddNullValues(1);
-            } else {
-                sketch->AddRecord(ConvertString<T>(val), rid);
-            }
-        };
+    static InsertFunc CreateInsertFunc(const std::string& table_name, const std::string& column_name) {
+        return CreateInsertFunc<T, PreJoinedOmniSketch<T>>(table_name, column_name, {});
     }
 
     template <typename T, typename U>
-    static std::function<void(const std::string&, const size_t)> CreateInsertFunc(
-        const std::string& table_name, const std::string& column_name, const std::vector<std::string>& ref_tbl_names) {
+    static InsertFunc CreateInsertFunc(const std::string& table_name, const std::string& column_name,
+                                       const std::vector<std::string>& ref_tbl_names) {
         auto& registry = Registry::Get();
         auto sketch = registry.GetOmniSketchTyped<T>(table_name, column_name);
         std::vector<std::shared_ptr<U>> ref_sketches;
@@ -74,22 +84,71 @@ public:
             assert(ref_sketch);
             ref_sketches.push_back(ref_sketch);
         }
+        return CreateInsertFunc<T, U>(std::move(sketch), std::move(ref_sketches));
+    }
 
-        return [sketch, ref_sketches](const std::string& val, const size_t rid) {
-            if (val.empty()) {
-                sketch->AddNullValues(1);
-                for (auto& rs : ref_sketches) {
-                    rs->AddNullValues(1);
+    // Without pre-joined sketches, the tokens are looked up in a DictionaryCache of the column first
+    template <typename T, typename U = PreJoinedOmniSketch<T>>
+    static InsertFunc CreateInsertFunc(std::shared_ptr<TypedPointOmniSketch<T>> sketch,
+                                       std::vector<std::shared_ptr<U>> ref_sketches = {},
+                                       bool use_dictionary_cache = true) {
+        // Converted values, the cells of cached values, and their record ids, reused between chunks
+        std::vector<T> values;
+        std::vector<uint64_t> value_rids;
+        std::vector<uint32_t> cached_cell_idxs;
+        std::vector<uint64_t> cached_rids;
+        DictionaryCache<T> cache(sketch->Depth());
+        const bool use_cache = use_dictionary_cache && ref_sketches.empty();
+        return [sketch, ref_sketches, values, value_rids, cached_cell_idxs, cached_rids, cache, use_cache](
+                   const std::vector<CSVField>& column, const std::vector<uint64_t>& rids) mutable {
+            values.clear();
+            value_rids.clear();
+            cached_cell_idxs.clear();
+            cached_rids.clear();
+            const bool lookup = use_cache && cache.IsEnabled();
+            for (size_t row_idx = 0; row_idx < column.size(); row_idx++) {
+                if (column[row_idx].Empty()) {
+                    continue;
+                }
+                if (lookup) {
+                    const uint32_t entry_idx = cache.Lookup(column[row_idx], *sketch);
+                    if (entry_idx != DictionaryCache<T>::NOT_CACHED) {
+                        const uint32_t* cell_idxs = cache.CellIdxs(entry_idx);
+                        cached_cell_idxs.insert(cached_cell_idxs.end(), cell_idxs, cell_idxs + sketch->Depth());
+                        cached_rids.push_back(rids[row_idx]);
+                        continue;
+                    }
                 }
+                values.push_back(CSVReader::Parse<T>(column[row_idx]));
+                value_rids.push_back(rids[row_idx]);
             }
-            sketch->AddRecord(ConvertString<T>(val), rid);
+            if (lookup) {
+                cache.FinishChunk();
+            }
+
+            const size_t null_count = column.size() - values.size() - cached_rids.size();
+            if (null_count > 0) {
+                sketch->AddNullValues(null_count);
+            }
+            sketch->AddMappedRecords(cached_cell_idxs.data(), cached_rids.data(), cached_rids.size());
+            sketch->AddRecords(values.data(), value_rids.data(), values.size());
             for (auto& rs : ref_sketches) {
-                rs->AddRecord(ConvertString<T>(val), rid);
+                if (null_count > 0) {
+                    rs->AddNullValues(null_count);
+                }
+                rs->AddRecords(values.data(), value_rids.data(), values.size());
             }
         };
     }
 
 private:
+    static constexpr size_t IMPORT_CHUNK_SIZE = 1024;
+
+    // Fills the sketches of every thread with a part of the table file and combines them into the first ones
+    static void ReadTableFile(const std::string& path, std::vector<TableSketches>& table_sketches);
+    // Inserts the lines of the table file that start in the byte range [begin, end)
+    static void ImportLines(CSVReader reader, size_t begin, size_t end, std::vector<InsertFunc>& insert_funcs);
+
     static CountQuery ParseSingleQuery(const std::string& line);
     static void ProcessJoins(const std::string& joinString, CountQuery& query);
     static void ProcessPredicates(const std::string& predicateString, CountQuery& query);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "omni_sketch/standard_omni_sketch.hpp"
+#include "util/csv_reader.hpp"
+
+#include <cstring>
+
+namespace omnisketch {
+
+// Remembers the converted value and the cells of the first distinct tokens of a column, so that the repeated tokens of
+// low-cardinality columns (type ids, kinds, roles, ...) skip conversion, value hashing, and cell mapping. The tokens
+// are kept in an open-addressing table keyed by their bytes. Once the cache is full, new tokens are not cached, and a
+// cache that misses for most tokens of a chunk disables itself.
+template <typename T>
+class DictionaryCache {
+public:
+    static constexpr uint32_t NOT_CACHED = UINT32_MAX;
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+    explicit DictionaryCache(size_t depth_p, size_t capacity_p = DEFAULT_CAPACITY)
+        : depth(depth_p), capacity(capacity_p), slot_mask(0) {
+        size_t slot_count = 1;
+        while (slot_count < 2 * capacity) {
+            slot_count *= 2;
+        }
+        slots.assign(slot_count, 0);
+        slot_mask = slot_count - 1;
+        token_offsets.push_back(0);
+    }
+
+    bool IsEnabled() const {
+        return enabled;
+    }
+
+    // Returns the entry of the token, which is converted and mapped to the cells of the sketch (see
+    // TypedPointOmniSketch::MapValue()) on its first occurrence. Returns NOT_CACHED for new tokens of a full cache.
+    uint32_t Lookup(const CSVField& token, TypedPointOmniSketch<T>& sketch) {
+        lookup_count++;
+        const uint64_t token_hash = hash_functions::HashBytes(token.data, token.size);
+        size_t slot_idx = token_hash & slot_mask;
+        for (; slots[slot_idx] != 0; slot_idx = (slot_idx + 1) & slot_mask) {
+            const uint32_t entry_idx = slots[slot_idx] - 1;
+            const size_t token_offset = token_offsets[entry_idx];
+            if (token_hashes[entry_idx] == token_hash && token_offsets[entry_idx + 1] - token_offset == token.size &&
+                std::memcmp(tokens.data() + token_offset, token.data, token.size) == 0) {
+                return entry_idx;
+            }
+        }
+        if (token_hashes.size() == capacity) {
+            miss_count++;
+            return NOT_CACHED;
+        }
+
+        const T value = CSVReader::Parse<T>(token);
+        const auto entry_idx = static_cast<uint32_t>(token_hashes.size());
+        cell_idxs.resize(cell_idxs.size() + depth);
+        sketch.MapValue(value, cell_idxs.data() + entry_idx * depth);
+        slots[slot_idx] = entry_idx + 1;
+        token_hashes.push_back(token_hash);
+        tokens.append(token.data, token.size);
+        token_offsets.push_back(tokens.size());
+        return entry_idx;
+    }
+
+    const uint32_t* CellIdxs(uint32_t entry_idx) const {
+        return cell_idxs.data() + entry_idx * depth;
+    }
+
+    // Disables the cache if most lookups of the chunk missed it
+    void FinishChunk() {
+        if (2 * miss_count > lookup_count) {
+            enabled = false;
+        }
+        lookup_count = 0;
+        miss_count = 0;
+    }
+
+private:
+    const size_t depth;
+    const size_t capacity;
+    bool enabled = true;
+    size_t lookup_count = 0;
+    size_t miss_count = 0;
+
+    // Entry index + 1 per slot, 0 for empty slots
+    std::vector<uint32_t> slots;
+    size_t slot_mask;
+    // The bytes of token entry_idx are [token_offsets[entry_idx], token_offsets[entry_idx + 1]) of tokens
+    std::string tokens;
+    std::vector<size_t> token_offsets;
+    std::vector<uint64_t> token_hashes;
+    std::vector<uint32_t> cell_idxs;
+};
+
+template <typename T>
+constexpr uint32_t DictionaryCache<T>::NOT_CACHED;
+template <typename T>
+constexpr size_t DictionaryCache<T>::DEFAULT_CAPACITY;
+
+}  // namespace omnisketch
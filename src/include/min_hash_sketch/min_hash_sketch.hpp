@@ -1,13 +1,28 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <vector>
 
 namespace omnisketch {
 
+// Width of the stored samples. 32-bit samples keep only the upper half of every hash, which halves the memory of a
+// sample and doubles the lanes of the SIMD intersection kernels. They are exposed in the 64-bit hash space with the
+// lower half cleared, so they compare equal to the truncated 64-bit hash of the same record. Distinct records collide
+// with probability 2^-32 per pair; see individual_probe_errors_benchmark.cpp for the resulting estimation error.
+enum class SampleWidth : uint32_t { BITS_64 = 64, BITS_32 = 32 };
+
+constexpr uint64_t TRUNCATED_HASH_MASK = 0xFFFFFFFF00000000ULL;
+
+inline uint64_t TruncateHash(uint64_t hash) {
+    return hash & TRUNCATED_HASH_MASK;
+}
+
 class MinHashSketch {
 public:
     class SketchIterator {
@@ -29,6 +44,11 @@ public:
 public:
     virtual ~MinHashSketch() = default;
     virtual void AddRecord(uint64_t hash) = 0;
+    virtual void AddRecords(const uint64_t* hashes, size_t count) {
+        for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+            AddRecord(hashes[hash_idx]);
+        }
+    }
     virtual void EraseRecord(uint64_t hash) = 0;
     virtual size_t Size() const = 0;
     virtual size_t MaxCount() const = 0;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <limits>
+
+#include "min_hash_sketch.hpp"
+#include "min_hash_sketch_span.hpp"
+
+namespace omnisketch {
+
+// Bottom-k sketch for streaming inserts: a hash is rejected with a single comparison against the current k-th smallest
+// hash, and accepted hashes are collected in an unsorted buffer that is sorted, merged and truncated in batches.
+// Pending inserts are merged on the next read, so (like building) reading a sketch under construction is not
+// thread-safe.
+class MinHashSketchBuffered : public MinHashSketch {
+public:
+    using SketchIterator = MinHashSketchSpan::SketchIterator;
+
+    class SketchFactory : public MinHashSketch::SketchFactory {
+    public:
+        virtual std::shared_ptr<MinHashSketch> Create(size_t max_sample_count) {
+            return std::make_shared<MinHashSketchBuffered>(max_sample_count);
+        }
+    };
+
+public:
+    explicit MinHashSketchBuffered(size_t max_count_p);
+
+    void AddRecord(uint64_t hash) override {
+        if (hash >= threshold && data.size() == max_count) {
+            return;
+        }
+        buffer.push_back(hash);
+        if (buffer.size() >= max_count) {
+            Compact();
+        }
+    }
+
+    void AddRecords(const uint64_t* hashes, size_t count) override {
+        for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+            MinHashSketchBuffered::AddRecord(hashes[hash_idx]);
+        }
+    }
+
+    void EraseRecord(uint64_t hash) override;
+    size_t Size() const override;
+    size_t MaxCount() const override;
+    std::shared_ptr<MinHashSketch> Resize(size_t size) const override;
+    std::shared_ptr<MinHashSketch> Flatten() const override;
+    std::shared_ptr<MinHashSketch> Intersect(const std::vector<std::shared_ptr<MinHashSketch>>& sketches,
+                                             size_t max_sample_count = 0) override;
+    void Combine(const MinHashSketch& other) override;
+    std::shared_ptr<MinHashSketch> Combine(const std::vector<std::shared_ptr<MinHashSketch>>& others) const override;
+    std::shared_ptr<MinHashSketch> Copy() const override;
+    size_t EstimateByteSize() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator(size_t max_sample_count) const override;
+    SketchIterator TypedIterator(size_t max_sample_count) const;
+    const std::vector<uint64_t>& Data() const;
+
+private:
+    // Merges the buffered hashes into data
+    void Compact() const;
+
+    // The (at most max_count) smallest hashes seen so far, sorted and without duplicates
+    mutable std::vector<uint64_t> data;
+    mutable std::vector<uint64_t> buffer;
+    mutable std::vector<uint64_t> merge_buffer;
+    // The largest hash in data once it is full, i.e., every hash >= threshold can be rejected
+    mutable uint64_t threshold = std::numeric_limits<uint64_t>::max();
+    size_t max_count;
+};
+
+}  // namespace omnisketch
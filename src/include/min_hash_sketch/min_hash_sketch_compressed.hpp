@@ -0,0 +1,108 @@
+#pragma once
+
+#include "min_hash_sketch.hpp"
+
+namespace omnisketch {
+
+// Read-only bottom-k sketch that stores its sorted hashes in blocks of BLOCK_SIZE hashes. Every block keeps its first
+// and last hash and bit-packs the deltas between consecutive hashes with the smallest bit width that fits all of them
+// (frame of reference). Iterators decode one block at a time, and intersections skip blocks by their first and last
+// hash without decoding them. Blocks and words are either owned or point into memory that someone else owns, e.g., a
+// memory-mapped sketch file.
+class MinHashSketchCompressed : public MinHashSketch {
+public:
+    static constexpr size_t BLOCK_SIZE = 32;
+
+    struct Block {
+        uint64_t first;
+        uint64_t last;
+        // Position of the packed deltas in the words of the sketch
+        uint32_t word_offset;
+        uint32_t bit_width;
+    };
+
+    class SketchIterator final : public MinHashSketch::SketchIterator {
+    public:
+        SketchIterator(const Block* blocks_p, const uint64_t* words_p, size_t size_p, size_t value_count_p);
+        uint64_t Current() override {
+            return decoded[offset % BLOCK_SIZE];
+        }
+        size_t CurrentIdx() override {
+            return offset;
+        }
+        void Next() override {
+            ++offset;
+            if (offset % BLOCK_SIZE == 0 && offset < value_count) {
+                DecodeBlock(offset / BLOCK_SIZE);
+            }
+        }
+        uint64_t CurrentValueOrDefault(uint64_t default_val) override {
+            return default_val;
+        }
+        bool IsAtEnd() override {
+            return offset >= value_count;
+        }
+        // Moves to the first hash >= hash. Blocks that end before hash are skipped without decoding them.
+        void SeekGE(uint64_t hash);
+
+    private:
+        void DecodeBlock(size_t block_idx);
+
+        const Block* blocks;
+        const uint64_t* words;
+        size_t size;
+        size_t offset;
+        size_t value_count;
+        uint64_t decoded[BLOCK_SIZE];
+    };
+
+public:
+    // Compresses the given strictly increasing hashes
+    MinHashSketchCompressed(const uint64_t* hashes, size_t size_p, size_t max_count_p);
+    // Wraps encoded blocks without copying them. They must stay valid as long as owner is alive.
+    MinHashSketchCompressed(const Block* blocks_p, const uint64_t* words_p, size_t size_p, size_t max_count_p,
+                            std::shared_ptr<const void> owner_p);
+    MinHashSketchCompressed(const MinHashSketchCompressed&) = delete;
+    MinHashSketchCompressed& operator=(const MinHashSketchCompressed&) = delete;
+
+    static std::shared_ptr<MinHashSketchCompressed> Compress(const MinHashSketch& sketch);
+    // Appends the blocks of the given strictly increasing hashes, with word offsets relative to the end of words
+    static void Encode(const uint64_t* hashes, size_t count, std::vector<Block>& blocks, std::vector<uint64_t>& words);
+    static size_t BlockCount(size_t hash_count) {
+        return (hash_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    }
+    // Appends the hashes that occur in all sketches (considering at most max_sample_count hashes of each) to result
+    static void IntersectCompressed(const std::vector<const MinHashSketchCompressed*>& sketches,
+                                    size_t max_sample_count, std::vector<uint64_t>& result);
+
+    void AddRecord(uint64_t hash) override;
+    void EraseRecord(uint64_t hash) override;
+    size_t Size() const override;
+    size_t MaxCount() const override;
+    std::shared_ptr<MinHashSketch> Resize(size_t size) const override;
+    std::shared_ptr<MinHashSketch> Flatten() const override;
+    std::shared_ptr<MinHashSketch> Intersect(const std::vector<std::shared_ptr<MinHashSketch>>& sketches,
+                                             size_t max_sample_count = 0) override;
+    void Combine(const MinHashSketch& other) override;
+    std::shared_ptr<MinHashSketch> Combine(const std::vector<std::shared_ptr<MinHashSketch>>& others) const override;
+    std::shared_ptr<MinHashSketch> Copy() const override;
+    size_t EstimateByteSize() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator(size_t max_sample_count) const override;
+    SketchIterator TypedIterator(size_t max_sample_count) const;
+    const Block* Blocks() const;
+    const uint64_t* Words() const;
+    size_t WordCount() const;
+
+private:
+    std::vector<Block> owned_blocks;
+    std::vector<uint64_t> owned_words;
+    const Block* blocks;
+    const uint64_t* words;
+    size_t size;
+    size_t max_count;
+    // Keeps borrowed blocks and words alive
+    std::shared_ptr<const void> owner;
+};
+
+}  // namespace omnisketch
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "min_hash_sketch_vector.hpp"
+
+namespace omnisketch {
+
+// Intersection kernels over statically typed (final) sketch iterators. All iterator calls are resolved at compile
+// time, so the compiler can inline the whole merge loop. Matches are appended to result and, if a mask is given, the
+// matching positions of the first input are marked as invalid.
+
+template <class Iterator>
+void IntersectIterators(std::vector<Iterator>& offsets, ValidityMask* mask, std::vector<uint64_t>& result) {
+    assert(!offsets.empty());
+
+    while (!offsets[0].IsAtEnd()) {
+        const uint64_t current_hash = offsets[0].Current();
+
+        bool found_match = true;
+        for (size_t sketch_idx = 1; sketch_idx < offsets.size(); sketch_idx++) {
+            auto& other = offsets[sketch_idx];
+            while (!other.IsAtEnd() && other.Current() < current_hash) {
+                other.Next();
+            }
+
+            if (other.IsAtEnd()) {
+                // There can be no other matches
+                return;
+            }
+
+            const uint64_t other_hash = other.Current();
+            if (current_hash == other_hash) {
+                continue;
+            }
+
+            // No match, start from the beginning
+            found_match = false;
+            while (!offsets[0].IsAtEnd() && offsets[0].Current() < other_hash) {
+                offsets[0].Next();
+            }
+            break;
+        }
+        if (found_match) {
+            result.push_back(current_hash);
+            if (mask) {
+                mask->SetInvalid(offsets[0].CurrentIdx());
+            }
+            offsets[0].Next();
+        }
+    }
+}
+
+template <class LeftIterator, class RightIterator>
+void IntersectIteratorPair(LeftIterator& left, RightIterator& right, ValidityMask* mask,
+                           std::vector<uint64_t>& result) {
+    while (!left.IsAtEnd()) {
+        const uint64_t current_hash = left.Current();
+        while (!right.IsAtEnd() && right.Current() < current_hash) {
+            right.Next();
+        }
+
+        if (right.IsAtEnd()) {
+            return;
+        }
+
+        const uint64_t other_hash = right.Current();
+        if (current_hash == other_hash) {
+            result.push_back(current_hash);
+            if (mask) {
+                mask->SetInvalid(left.CurrentIdx());
+            }
+            left.Next();
+            continue;
+        }
+
+        while (!left.IsAtEnd() && left.Current() < other_hash) {
+            left.Next();
+        }
+    }
+}
+
+}  // namespace omnisketch
@@ -6,7 +6,7 @@ namespace omnisketch {
 
 class MinHashSketchMap : public MinHashSketch {
 public:
-    class SketchIterator : public MinHashSketch::SketchIterator {
+    class SketchIterator final : public MinHashSketch::SketchIterator {
     public:
         SketchIterator(std::map<uint64_t, uint64_t>::const_iterator map_it_p, size_t value_count_p)
             : map_it(map_it_p), offset(0), value_count(value_count_p) {
@@ -63,12 +63,17 @@ public:
     size_t EstimateByteSize() const override;
     std::unique_ptr<MinHashSketch::SketchIterator> Iterator() const override;
     std::unique_ptr<MinHashSketch::SketchIterator> Iterator(size_t max_sample_count) const override;
+    SketchIterator TypedIterator(size_t max_sample_count) const;
     std::map<uint64_t, uint64_t>& Data();
     const std::map<uint64_t, uint64_t>& Data() const;
     void ShrinkToSize() {
         max_count = data.size();
     }
 
+    // Builds a map from (hash, value) runs that are sorted by hash with a k-way merge. If a hash occurs more than once,
+    // the value that comes last (in a later run, or later in the same run) wins, like with repeated AddRecord calls.
+    static std::shared_ptr<MinHashSketchMap> FromSortedRuns(
+        const std::vector<std::vector<std::pair<uint64_t, uint64_t>>>& runs, size_t max_count);
     static std::shared_ptr<MinHashSketchMap> IntersectMap(std::vector<std::shared_ptr<MinHashSketch>>& sketches,
                                                           size_t n_max, size_t max_sample_size = 0);
 
@@ -6,7 +6,7 @@ namespace omnisketch {
 
 class MinHashSketchSet : public MinHashSketch {
 public:
-    class SketchIterator : public MinHashSketch::SketchIterator {
+    class SketchIterator final : public MinHashSketch::SketchIterator {
     public:
         SketchIterator(std::set<uint64_t>::const_iterator it_p, size_t value_count_p)
             : it(it_p), offset(0), value_count(value_count_p) {
@@ -59,6 +59,7 @@ public:
     size_t EstimateByteSize() const override;
     std::unique_ptr<MinHashSketch::SketchIterator> Iterator() const override;
     std::unique_ptr<MinHashSketch::SketchIterator> Iterator(size_t max_sample_count) const override;
+    SketchIterator TypedIterator(size_t max_sample_count) const;
     std::set<uint64_t>& Data();
     const std::set<uint64_t>& Data() const;
 
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "min_hash_sketch.hpp"
+#include "sorted_intersection.hpp"
+
+namespace omnisketch {
+
+// Read-only min-hash sketch over sorted hashes that are owned by someone else (e.g., a flattened OmniSketch)
+class MinHashSketchSpan : public MinHashSketch {
+public:
+    class SketchIterator final : public MinHashSketch::SketchIterator {
+    public:
+        SketchIterator(const uint64_t* it_p, size_t value_count_p) : it(it_p), offset(0), value_count(value_count_p) {
+        }
+        uint64_t Current() override {
+            return *it;
+        }
+        size_t CurrentIdx() override {
+            return offset;
+        }
+        void Next() override {
+            ++offset;
+            ++it;
+        }
+        uint64_t CurrentValueOrDefault(uint64_t default_val) override {
+            return default_val;
+        }
+        bool IsAtEnd() override {
+            return offset == value_count;
+        }
+
+    private:
+        const uint64_t* it;
+        size_t offset;
+        const size_t value_count;
+    };
+
+public:
+    MinHashSketchSpan(const uint64_t* data_p, size_t size_p, size_t max_count_p, std::shared_ptr<const void> owner_p)
+        : data(data_p), size(size_p), max_count(max_count_p), owner(std::move(owner_p)) {
+    }
+
+    void AddRecord(uint64_t hash) override;
+    void EraseRecord(uint64_t hash) override;
+    size_t Size() const override;
+    size_t MaxCount() const override;
+    std::shared_ptr<MinHashSketch> Resize(size_t size) const override;
+    std::shared_ptr<MinHashSketch> Flatten() const override;
+    std::shared_ptr<MinHashSketch> Intersect(const std::vector<std::shared_ptr<MinHashSketch>>& sketches,
+                                             size_t max_sample_count = 0) override;
+    void Combine(const MinHashSketch& other) override;
+    std::shared_ptr<MinHashSketch> Combine(const std::vector<std::shared_ptr<MinHashSketch>>& others) const override;
+    std::shared_ptr<MinHashSketch> Copy() const override;
+    size_t EstimateByteSize() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator(size_t max_sample_count) const override;
+    SketchIterator TypedIterator(size_t max_sample_count) const;
+    const uint64_t* Data() const;
+
+    // Appends the hashes that occur in all sorted ranges [offsets[i], ends[i]) to result
+    static void IntersectSorted(const std::vector<const uint64_t*>& offsets, const std::vector<const uint64_t*>& ends,
+                                std::vector<uint64_t>& result,
+                                IntersectionStrategy strategy = IntersectionStrategy::ADAPTIVE);
+
+private:
+    const uint64_t* data;
+    size_t size;
+    size_t max_count;
+    // Keeps the memory behind data alive
+    std::shared_ptr<const void> owner;
+};
+
+}  // namespace omnisketch
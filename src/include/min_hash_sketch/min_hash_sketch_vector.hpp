@@ -1,6 +1,7 @@
 #pragma once
 
 #include "min_hash_sketch.hpp"
+#include "sorted_intersection.hpp"
 
 namespace omnisketch {
 
@@ -45,10 +46,11 @@ private:
 
 class MinHashSketchVector : public MinHashSketch {
 public:
-    class SketchIterator : public MinHashSketch::SketchIterator {
+    class SketchIterator final : public MinHashSketch::SketchIterator {
     public:
         SketchIterator(std::vector<uint64_t>::const_iterator it_p, const ValidityMask* validity_p, size_t value_count_p)
             : it(it_p), validity(validity_p), offset(0), value_count(value_count_p) {
+            SkipInvalid();
         }
         uint64_t Current() override {
             return *it;
@@ -59,10 +61,7 @@ public:
         void Next() override {
             ++offset;
             ++it;
-            while (validity && !validity->IsValid(offset) && offset < value_count) {
-                ++offset;
-                ++it;
-            }
+            SkipInvalid();
         }
         uint64_t CurrentValueOrDefault(uint64_t default_val) override {
             return default_val;
@@ -72,6 +71,13 @@ public:
         }
 
     private:
+        void SkipInvalid() {
+            while (validity && offset < value_count && !validity->IsValid(offset)) {
+                ++offset;
+                ++it;
+            }
+        }
+
         std::vector<uint64_t>::const_iterator it;
         const ValidityMask* validity;
         size_t offset;
@@ -116,12 +122,16 @@ public:
     size_t EstimateByteSize() const override;
     std::unique_ptr<MinHashSketch::SketchIterator> Iterator() const override;
     std::unique_ptr<MinHashSketch::SketchIterator> Iterator(size_t max_sample_count) const override;
+    // Statically typed iterator that does not need a heap allocation or virtual calls
+    SketchIterator TypedIterator(size_t max_sample_count) const;
     std::vector<uint64_t>& Data();
     const std::vector<uint64_t>& Data() const;
+    const ValidityMask* Validity() const;
 
+    // The strategy applies to inputs that are stored contiguously (vectors, spans and buffered sketches)
     static std::shared_ptr<MinHashSketch> ComputeIntersection(
         const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask = nullptr,
-        size_t max_sample_size = 0);
+        size_t max_sample_size = 0, IntersectionStrategy strategy = IntersectionStrategy::ADAPTIVE);
 
 private:
     void ShrinkToFit();
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "min_hash_sketch.hpp"
+#include "min_hash_sketch_vector.hpp"
+#include "sorted_intersection.hpp"
+
+namespace omnisketch {
+
+// MinHashSketchVector with 32-bit samples (SampleWidth::BITS_32): stores the upper halves of the smallest hashes,
+// sorted and without duplicates. Iterators return them as truncated 64-bit hashes (see TruncateHash).
+class MinHashSketchVector32 : public MinHashSketch {
+public:
+    class SketchIterator final : public MinHashSketch::SketchIterator {
+    public:
+        SketchIterator(const uint32_t* it_p, size_t value_count_p) : it(it_p), offset(0), value_count(value_count_p) {
+        }
+        uint64_t Current() override {
+            return static_cast<uint64_t>(*it) << 32;
+        }
+        size_t CurrentIdx() override {
+            return offset;
+        }
+        void Next() override {
+            ++offset;
+            ++it;
+        }
+        uint64_t CurrentValueOrDefault(uint64_t default_val) override {
+            return default_val;
+        }
+        bool IsAtEnd() override {
+            return offset == value_count;
+        }
+
+    private:
+        const uint32_t* it;
+        size_t offset;
+        const size_t value_count;
+    };
+
+    class SketchFactory : public MinHashSketch::SketchFactory {
+    public:
+        virtual std::shared_ptr<MinHashSketch> Create(size_t max_sample_count) {
+            return std::make_shared<MinHashSketchVector32>(max_sample_count);
+        }
+    };
+
+public:
+    explicit MinHashSketchVector32(size_t max_count_p) : max_count(max_count_p) {
+        data.reserve(max_count);
+    }
+    // Takes over the given strictly increasing samples
+    MinHashSketchVector32(std::vector<uint32_t> data_p, size_t max_count_p)
+        : data(std::move(data_p)), max_count(max_count_p) {
+    }
+
+    static uint32_t ToSample(uint64_t hash) {
+        return static_cast<uint32_t>(hash >> 32);
+    }
+
+    void AddRecord(uint64_t hash) override;
+    void EraseRecord(uint64_t hash) override;
+    size_t Size() const override;
+    size_t MaxCount() const override;
+    std::shared_ptr<MinHashSketch> Resize(size_t size) const override;
+    std::shared_ptr<MinHashSketch> Flatten() const override;
+    std::shared_ptr<MinHashSketch> Intersect(const std::vector<std::shared_ptr<MinHashSketch>>& sketches,
+                                             size_t max_sample_count = 0) override;
+    void Combine(const MinHashSketch& other) override;
+    std::shared_ptr<MinHashSketch> Combine(const std::vector<std::shared_ptr<MinHashSketch>>& others) const override;
+    std::shared_ptr<MinHashSketch> Copy() const override;
+    size_t EstimateByteSize() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator() const override;
+    std::unique_ptr<MinHashSketch::SketchIterator> Iterator(size_t max_sample_count) const override;
+    SketchIterator TypedIterator(size_t max_sample_count) const;
+    const std::vector<uint32_t>& Data() const;
+
+    // Intersects sketches of which at least one has 32-bit samples. All inputs are truncated to 32 bits, and the
+    // 32-bit kernels intersect them. Marks the matches of the first input in mask, if given.
+    static std::shared_ptr<MinHashSketch> ComputeIntersection(
+        const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask = nullptr,
+        size_t max_sample_size = 0, IntersectionStrategy strategy = IntersectionStrategy::ADAPTIVE);
+
+private:
+    std::vector<uint32_t> data;
+    size_t max_count;
+};
+
+}  // namespace omnisketch
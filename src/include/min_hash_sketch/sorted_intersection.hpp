@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace omnisketch {
+
+// How two sorted hash arrays are intersected. ADAPTIVE gallops through the larger input if it is at least
+// GALLOPING_SIZE_RATIO times larger than the smaller one, and uses a (SIMD) linear merge otherwise.
+enum class IntersectionStrategy { ADAPTIVE, LINEAR_MERGE, GALLOPING };
+
+namespace sorted_intersection {
+
+constexpr size_t GALLOPING_SIZE_RATIO = 16;
+
+// Intersects two strictly increasing hash arrays. Writes the matches in ascending order to out, which needs room for
+// min(a_size, b_size) hashes and may alias a. Returns the number of matches.
+size_t Intersect(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out,
+                 IntersectionStrategy strategy = IntersectionStrategy::ADAPTIVE);
+
+// Intersects all ranges [offsets[i], ends[i]) and appends the result to result. Starts with the two smallest ranges,
+// so that every following pass only has to look at the (shrinking) intermediate result.
+void IntersectMany(const std::vector<const uint64_t*>& offsets, const std::vector<const uint64_t*>& ends,
+                   std::vector<uint64_t>& result, IntersectionStrategy strategy = IntersectionStrategy::ADAPTIVE);
+
+// Looks up every hash of the smaller input with an exponential search in the larger input
+size_t IntersectGalloping(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out);
+// The linear merge, dispatched to the best kernel for the instruction sets of the current CPU
+size_t IntersectLinear(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out);
+size_t IntersectScalar(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out);
+size_t IntersectAVX2(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out);
+size_t IntersectAVX512(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out);
+
+// The same kernels for 32-bit samples (see SampleWidth), with twice as many lanes per SIMD register
+size_t Intersect(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out,
+                 IntersectionStrategy strategy = IntersectionStrategy::ADAPTIVE);
+void IntersectMany(const std::vector<const uint32_t*>& offsets, const std::vector<const uint32_t*>& ends,
+                   std::vector<uint32_t>& result, IntersectionStrategy strategy = IntersectionStrategy::ADAPTIVE);
+size_t IntersectGalloping(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out);
+size_t IntersectLinear(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out);
+size_t IntersectScalar(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out);
+size_t IntersectAVX2(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out);
+size_t IntersectAVX512(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out);
+
+bool SupportsAVX2();
+bool SupportsAVX512();
+
+}  // namespace sorted_intersection
+}  // namespace omnisketch
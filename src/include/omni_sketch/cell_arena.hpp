@@ -0,0 +1,141 @@
+#pragma once
+
+#include "omni_sketch_cell.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace omnisketch {
+
+// Flat, read-only storage for all cells of an OmniSketch. Record counts live in one dense array, and the min-hash
+// samples of all cells share one contiguous slab. Cell (row, col) owns samples [offsets[i], offsets[i + 1]) with
+// i = CellIdx(row, col), which is row * width + col. Arenas built from cells can instead be laid out in blocks of
+// block_width columns, which hold the cells of all rows one row after the other (for sketches whose mapper keeps the
+// rows of a hash within a block, see BlockedSplitHashMapper). The arrays are either owned by the arena or point into
+// memory that someone else owns, e.g., a memory-mapped sketch file. Arenas of sketches with 32-bit samples keep them in
+// a 32-bit slab.
+class CellArena : public std::enable_shared_from_this<CellArena> {
+public:
+    CellArena(size_t width_p, size_t depth_p, size_t max_sample_count_p);
+    CellArena(const CellArena&) = delete;
+    CellArena& operator=(const CellArena&) = delete;
+
+    // Lays out the cells in blocks of block_width columns, a power of two that divides the width, or row by row if
+    // block_width is 0 or the width
+    static std::shared_ptr<CellArena> FromCells(const std::vector<std::vector<std::shared_ptr<OmniSketchCell>>>& cells,
+                                                size_t max_sample_count, size_t block_width = 0);
+    // Takes over arrays in the layout described above
+    static std::shared_ptr<CellArena> FromArrays(size_t width, size_t depth, size_t max_sample_count,
+                                                 std::vector<uint64_t> record_counts, std::vector<uint64_t> offsets,
+                                                 std::vector<uint64_t> samples);
+    static std::shared_ptr<CellArena> FromArrays(size_t width, size_t depth, size_t max_sample_count,
+                                                 std::vector<uint64_t> record_counts, std::vector<uint64_t> offsets,
+                                                 std::vector<uint32_t> samples);
+    // Wraps existing arrays without copying them. The arrays must stay valid as long as owner is alive.
+    static std::shared_ptr<CellArena> FromMemory(size_t width, size_t depth, size_t max_sample_count,
+                                                 const uint64_t* record_counts, const uint64_t* offsets,
+                                                 const uint64_t* samples, std::shared_ptr<const void> owner);
+    static std::shared_ptr<CellArena> FromMemory(size_t width, size_t depth, size_t max_sample_count,
+                                                 const uint64_t* record_counts, const uint64_t* offsets,
+                                                 const uint32_t* samples, std::shared_ptr<const void> owner);
+
+    size_t Width() const {
+        return width;
+    }
+    size_t Depth() const {
+        return depth;
+    }
+    size_t MaxSampleCount() const {
+        return max_sample_count;
+    }
+    SampleWidth GetSampleWidth() const {
+        return sample_width;
+    }
+    // Columns per block of the cell layout (see FromCells()), or the width if the cells are laid out row by row
+    size_t BlockWidth() const {
+        return block_width;
+    }
+    size_t CellIdx(size_t row_idx, size_t col_idx) const {
+        if (block_width == width) {
+            return row_idx * width + col_idx;
+        }
+        const size_t block_begin = col_idx & ~(block_width - 1);
+        return block_begin * depth + row_idx * block_width + (col_idx - block_begin);
+    }
+    size_t CellCount() const {
+        return width * depth;
+    }
+    size_t RecordCount(size_t cell_idx) const {
+        return record_counts[cell_idx];
+    }
+    size_t SampleCount(size_t cell_idx) const {
+        return offsets[cell_idx + 1] - offsets[cell_idx];
+    }
+    const uint64_t* Samples(size_t cell_idx) const {
+        assert(sample_width == SampleWidth::BITS_64);
+        return samples + offsets[cell_idx];
+    }
+    // The upper halves of the samples if the arena has 32-bit samples
+    const uint32_t* NarrowSamples(size_t cell_idx) const {
+        assert(sample_width == SampleWidth::BITS_32);
+        return narrow_samples + offsets[cell_idx];
+    }
+    // Prefetches the record count and the sample offsets of a cell
+    void PrefetchCell(size_t cell_idx) const {
+        __builtin_prefetch(record_counts + cell_idx);
+        __builtin_prefetch(offsets + cell_idx);
+    }
+    // Prefetches the first cache line of the samples of a cell, which reads its offset
+    void PrefetchSamples(size_t cell_idx) const {
+        // GCC drops prefetches that are issued in both branches of a condition, so only the address is conditional
+        const void* first_sample = sample_width == SampleWidth::BITS_32
+                                       ? static_cast<const void*>(narrow_samples + offsets[cell_idx])
+                                       : static_cast<const void*>(samples + offsets[cell_idx]);
+        __builtin_prefetch(first_sample);
+    }
+    // The raw arrays, with CellCount(), CellCount() + 1, and TotalSampleCount() entries
+    const uint64_t* RecordCounts() const {
+        return record_counts;
+    }
+    const uint64_t* Offsets() const {
+        return offsets;
+    }
+    const uint64_t* AllSamples() const {
+        return samples;
+    }
+    const uint32_t* AllNarrowSamples() const {
+        return narrow_samples;
+    }
+    size_t TotalSampleCount() const {
+        return offsets[CellCount()];
+    }
+
+    // Creates a cell whose min-hash sketch points into this arena
+    std::shared_ptr<OmniSketchCell> GetCell(size_t cell_idx) const;
+    // Creates a cell that owns a mutable copy of the samples
+    std::shared_ptr<OmniSketchCell> CopyCell(size_t cell_idx) const;
+    size_t EstimateByteSize() const;
+
+private:
+    size_t width;
+    size_t depth;
+    size_t max_sample_count;
+    size_t block_width;
+
+    const uint64_t* record_counts;
+    const uint64_t* offsets;
+    const uint64_t* samples;
+    const uint32_t* narrow_samples = nullptr;
+    SampleWidth sample_width = SampleWidth::BITS_64;
+
+    // Backing storage if the arena owns its arrays
+    std::vector<uint64_t> owned_record_counts;
+    std::vector<uint64_t> owned_offsets;
+    std::vector<uint64_t> owned_samples;
+    std::vector<uint32_t> owned_narrow_samples;
+    // Keeps borrowed arrays alive
+    std::shared_ptr<const void> owner;
+};
+
+}  // namespace omnisketch
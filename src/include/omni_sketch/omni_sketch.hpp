@@ -1,7 +1,9 @@
 #pragma once
 
+#include "cell_arena.hpp"
 #include "min_hash_sketch/min_hash_sketch_set.hpp"
 #include "omni_sketch_cell.hpp"
+#include "probe_context.hpp"
 #include "set_membership.hpp"
 #include "util/hash.hpp"
 #include "util/value.hpp"
@@ -9,6 +11,7 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <unordered_map>
 
 namespace omnisketch {
 
@@ -21,23 +24,41 @@ public:
     virtual std::shared_ptr<OmniSketchCell> ProbeHash(uint64_t hash,
                                                       std::vector<std::shared_ptr<OmniSketchCell>>& matches,
                                                       size_t max_samples = 0) const = 0;
+    virtual void ProbeHash(uint64_t hash, ProbeContext& context, size_t max_samples = 0) const = 0;
+    // Probes every hash like ProbeHash() and replaces the contents of batch with the results, in the order of the
+    // hashes. The cells of all hashes are mapped and prefetched before the first intersection.
+    virtual void ProbeHashes(const uint64_t* hashes, size_t count, ProbeBatch& batch,
+                             size_t max_samples = 0) const = 0;
     virtual std::shared_ptr<OmniSketchCell> ProbeHashedSet(const std::shared_ptr<MinHashSketch>& values) const = 0;
     virtual std::shared_ptr<OmniSketchCell> ProbeHashedSet(const std::shared_ptr<OmniSketchCell>& values) const = 0;
     virtual double EstimateAverageMatchesPerProbe() const = 0;
     virtual void AddValueRecord(const Value& value, uint64_t record_id) = 0;
     virtual void AddRecordHashed(uint64_t value_hash, uint64_t record_id_hash) = 0;
+    virtual void AddRecordsHashed(const uint64_t* value_hashes, const uint64_t* record_id_hashes, size_t count) = 0;
     virtual void AddNullValues(size_t count) = 0;
+    virtual void RemoveValueRecord(const Value& value, uint64_t record_id) = 0;
+    virtual void RemoveRecordHashed(uint64_t value_hash, uint64_t record_id_hash) = 0;
+    virtual void RemoveNullValues(size_t count) = 0;
     virtual size_t CountNulls() const = 0;
     virtual std::shared_ptr<OmniSketchCell> ProbeValue(const Value& value) const = 0;
     virtual std::shared_ptr<OmniSketchCell> ProbeValueSet(const ValueSet& values) const = 0;
     virtual void Flatten() = 0;
+    // Const probes neither modify the sketch nor its (stateless) cell mapper, so they can run concurrently, each thread
+    // with its own ProbeContext. Only MinHashSketchBuffered cells merge their buffers on reads, so sketches built from
+    // them have to be flattened before they are probed concurrently.
+    virtual bool IsFlattened() const = 0;
     virtual size_t EstimateByteSize() const = 0;
     virtual size_t Depth() const = 0;
     virtual size_t Width() const = 0;
     virtual size_t MinHashSketchSize() const = 0;
     virtual std::shared_ptr<OmniSketchCell> GetRids() const = 0;
     virtual void Combine(const std::shared_ptr<OmniSketch>& other) = 0;
-    virtual const OmniSketchCell& GetCell(size_t row_idx, size_t col_idx) const = 0;
+    virtual OmniSketchCell GetCell(size_t row_idx, size_t col_idx) const = 0;
+    // Largest record id hash that a cell which lost samples to removals may still sample, UINT64_MAX for cells that
+    // hold the smallest record id hashes of their records
+    virtual uint64_t SampleThreshold(size_t, size_t) const {
+        return UINT64_MAX;
+    }
     virtual OmniSketchType Type() const = 0;
 };
 
@@ -53,13 +74,34 @@ public:
 
     virtual void AddValueRecord(const Value& value, uint64_t record_id) override;
     virtual void AddRecordHashed(uint64_t value_hash, uint64_t record_id_hash) override;
+    // Groups the updates of a batch by cell, so that every cell is updated once per batch
+    virtual void AddRecordsHashed(const uint64_t* value_hashes, const uint64_t* record_id_hashes,
+                                  size_t count) override;
+    // Writes the cell of the value hash in every row, as row_idx * width + col_idx, to cell_idxs
+    void ComputeCellIdxs(uint64_t value_hash, uint32_t* cell_idxs);
+    // Like AddRecordsHashed(), for records whose cells were computed with ComputeCellIdxs() (depth cells per record)
+    void AddRecordsToCells(const uint32_t* cell_idxs, const uint64_t* record_id_hashes, size_t count);
     void AddNullValues(size_t count) override;
+    // Removes a record that was added with the same value and record id. A cell that loses a sample of its full
+    // min-hash sketch cannot get back the records it dropped earlier, so from then on it only samples record ids
+    // below its former largest sample, until it is full again.
+    virtual void RemoveValueRecord(const Value& value, uint64_t record_id) override;
+    virtual void RemoveRecordHashed(uint64_t value_hash, uint64_t record_id_hash) override;
+    void RemoveNullValues(size_t count) override;
+    void UpdateValueRecord(const Value& old_value, const Value& new_value, uint64_t record_id);
+    // Cells that hold fewer samples than a rebuilt sketch would, since they lost samples to removals
+    size_t UnderfilledCellCount() const;
+    // Smallest ratio of kept to expected samples over all cells (1 without underfilled cells). The standard error of
+    // a cell estimate grows with the inverse square root of its samples, i.e., by 1 / sqrt(MinSampleFill()) at most.
+    double MinSampleFill() const;
     size_t CountNulls() const override;
     size_t RecordCount() const override;
     void SetRecordCount(size_t record_count_p);
     std::shared_ptr<OmniSketchCell> ProbeValue(const Value& value) const override;
     std::shared_ptr<OmniSketchCell> ProbeHash(uint64_t hash, std::vector<std::shared_ptr<OmniSketchCell>>& matches,
                                               size_t max_samples = 0) const override;
+    void ProbeHash(uint64_t hash, ProbeContext& context, size_t max_samples = 0) const override;
+    void ProbeHashes(const uint64_t* hashes, size_t count, ProbeBatch& batch, size_t max_samples = 0) const override;
     std::shared_ptr<OmniSketchCell> ProbeHashedSet(const std::shared_ptr<MinHashSketch>& values) const override;
     std::shared_ptr<OmniSketchCell> ProbeHashedSet(const std::shared_ptr<OmniSketchCell>& values) const override;
     std::shared_ptr<OmniSketchCell> ProbeValueSet(const ValueSet& values) const override;
@@ -70,19 +112,55 @@ public:
     size_t MinHashSketchSize() const override;
     std::shared_ptr<OmniSketchCell> GetRids() const override;
     void Combine(const std::shared_ptr<OmniSketch>& other) override;
-    const OmniSketchCell& GetCell(size_t row_idx, size_t col_idx) const override;
+    OmniSketchCell GetCell(size_t row_idx, size_t col_idx) const override;
+    uint64_t SampleThreshold(size_t row_idx, size_t col_idx) const override;
+    // Sets the cells of a loaded sketch. Sketch files do not store the sample thresholds, so a cell with fewer samples
+    // than records and than the min-hash sketch holds samples up to its largest sample from then on.
     void SetCell(size_t row_idx, size_t col_idx, std::shared_ptr<OmniSketchCell> cell);
+    // Replaces all cells with already flattened ones
+    void SetArena(std::shared_ptr<CellArena> arena_p);
+    SampleWidth GetSampleWidth() const;
+    // The columns of a hash lie within blocks of this many columns (see CellIdxMapper::BlockWidth())
+    size_t BlockWidth() const;
+    bool IsFlattened() const override;
 
 protected:
+    std::shared_ptr<OmniSketchCell> CellAt(size_t row_idx, size_t col_idx) const;
+    OmniSketchCell& MutableCell(size_t row_idx, size_t col_idx);
+    void AddToCell(size_t row_idx, size_t col_idx, uint64_t record_id_hash);
+    size_t FilledCellCount(size_t row_idx) const;
+    // Prefetches the arena cells of count hashes, whose columns are given like by CellIdxMapper::ComputeCellIdxs()
+    void PrefetchColumns(const size_t* col_idxs, size_t count) const;
+    // Adds the cells of the given columns (one per row) to the context and intersects them
+    void ProbeColumns(const size_t* col_idxs, ProbeContext& context) const;
+    void Unflatten();
+    // Replaces the read-only cells of delta-encoded sketch files with modifiable ones
+    void DecompressCells();
+    // Sets the sample threshold of a cell that was set with SetCell() or SetArena() if it is underfilled
+    void RestoreSampleThreshold(size_t row_idx, size_t col_idx, const OmniSketchCell& cell);
+
     size_t width;
     size_t depth;
     size_t max_sample_count;
     std::shared_ptr<SetMembershipAlgorithm> set_membership_algo;
     std::shared_ptr<CellIdxMapper> hash_processor;
 
+    // Cells are either held individually (while the sketch is being built) or in one flat arena after Flatten()
     std::vector<std::vector<std::shared_ptr<OmniSketchCell>>> cells;
+    std::shared_ptr<CellArena> arena;
+    // Whether a cell holds a MinHashSketchCompressed, which is decompressed on the first change (see MutableCell)
+    bool has_compressed_cells = false;
     size_t record_count = 0;
     size_t null_count = 0;
+    // Largest record id hash that an underfilled cell may still sample, by cell index (row_idx * width + col_idx)
+    std::unordered_map<size_t, uint64_t> sample_thresholds;
+
+    // The columns of the records being added or removed, depth per record
+    std::vector<size_t> mapped_col_idxs;
+    // Reused between batches of AddRecordsHashed()
+    std::vector<size_t> batch_cell_offsets;
+    std::vector<uint32_t> batch_cell_idxs;
+    std::vector<uint64_t> batch_hashes;
 };
 
 }  // namespace omnisketch
@@ -2,6 +2,7 @@
 
 #include "min_hash_sketch/min_hash_sketch.hpp"
 
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <set>
@@ -16,6 +17,13 @@ public:
     OmniSketchCell();
 
     void AddRecord(uint64_t hash);
+    void AddRecords(const uint64_t* hashes, size_t count);
+    // Removes a record that was added before. Returns the largest hash up to which the remaining samples still hold
+    // all records of the cell: UINT64_MAX, unless a sample of a full sketch is erased. Records above the former
+    // largest sample were dropped when they were added, so they cannot take the place of the erased sample.
+    uint64_t RemoveRecord(uint64_t hash);
+    // Erases the samples above threshold (see RemoveRecord), keeping the record count
+    void EraseSamplesAbove(uint64_t threshold);
     size_t RecordCount() const;
     size_t SampleCount() const;
     size_t MaxSampleCount() const;
@@ -30,6 +38,10 @@ public:
     static std::shared_ptr<OmniSketchCell> Intersect(const std::vector<std::shared_ptr<OmniSketchCell>>& cells,
                                                      size_t max_samples = 0);
     static std::shared_ptr<OmniSketchCell> Combine(const std::vector<std::shared_ptr<OmniSketchCell>>& cells);
+    // Scales the samples left after an intersection by the sampling rate of the largest input cell (n_max records,
+    // n_max_sample_count samples). The result never exceeds the smallest input cell (n_min records).
+    static size_t EstimateIntersectionCard(size_t n_min, size_t n_max, size_t n_max_sample_count,
+                                           size_t result_sample_count);
 
 protected:
     std::shared_ptr<MinHashSketch> min_hash_sketch;
@@ -3,6 +3,8 @@
 #include "min_hash_sketch/min_hash_sketch_vector.hpp"
 #include "omni_sketch.hpp"
 
+#include <limits>
+
 namespace omnisketch {
 
 template <typename T>
@@ -11,9 +13,11 @@ public:
     PreJoinedOmniSketch(std::shared_ptr<OmniSketch> sketch, size_t width_p, size_t depth_p, size_t max_sample_count_p,
                         std::shared_ptr<HashFunction<T>> hash_function_p,
                         std::shared_ptr<SetMembershipAlgorithm> set_membership_algo_p,
-                        std::shared_ptr<CellIdxMapper> hash_processor_p)
+                        std::shared_ptr<CellIdxMapper> hash_processor_p,
+                        const std::shared_ptr<MinHashSketch::SketchFactory>& factory =
+                            std::make_shared<MinHashSketchSet::SketchFactory>())
         : PointOmniSketch(width_p, depth_p, max_sample_count_p, std::move(set_membership_algo_p),
-                          std::move(hash_processor_p)),
+                          std::move(hash_processor_p), factory),
           referenced_sketch(std::move(sketch)),
           hf(std::move(hash_function_p)) {
         probe_buffer.resize(depth);
@@ -31,20 +35,38 @@ public:
 
     void AddRecordHashed(uint64_t value_hash, uint64_t record_id_hash) override {
         auto probe_result = referenced_sketch->ProbeHash(record_id_hash, probe_buffer);
-        hash_processor->SetHash(value_hash);
+        mapped_col_idxs.resize(depth);
+        hash_processor->ComputeCellIdxs(value_hash, depth, mapped_col_idxs.data());
         for (size_t row_idx = 0; row_idx < depth; row_idx++) {
-            const size_t col_idx = hash_processor->ComputeCellIdx(row_idx);
-            cells[row_idx][col_idx]->Combine(*probe_result);
+            MutableCell(row_idx, mapped_col_idxs[row_idx]).Combine(*probe_result);
         }
         record_count += probe_result->RecordCount();
     }
 
+    void AddRecordsHashed(const uint64_t* value_hashes, const uint64_t* record_id_hashes, size_t count) override {
+        // Every record combines a whole probe result into its cells, so there is nothing to gain from grouping
+        for (size_t record_idx = 0; record_idx < count; record_idx++) {
+            AddRecordHashed(value_hashes[record_idx], record_id_hashes[record_idx]);
+        }
+    }
+
+    void RemoveRecordHashed(uint64_t, uint64_t) override {
+        // The cells hold unions of probe results, which cannot be taken apart again
+        throw std::logic_error("PreJoinedOmniSketch does not support removing records.");
+    }
+
     void AddRecord(const T& value, uint64_t record_id) {
         min = std::min(min, value);
         max = std::max(max, value);
         AddRecordHashed(hf->Hash(value), hf->HashRid(record_id));
     }
 
+    void AddRecords(const T* values, const uint64_t* record_ids, size_t count) {
+        for (size_t record_idx = 0; record_idx < count; record_idx++) {
+            AddRecord(values[record_idx], record_ids[record_idx]);
+        }
+    }
+
     std::shared_ptr<OmniSketchCell> Probe(const T& value) const {
         std::vector<std::shared_ptr<OmniSketchCell>> matches(depth);
         return PointOmniSketch::ProbeHash(hf->Hash(value), matches);
@@ -72,13 +94,7 @@ public:
     }
 
     double EstimateAverageMatchesPerProbe() const override {
-        size_t filled_cells_front_row = 0;
-        for (auto& cell : cells.front()) {
-            if (cell->RecordCount() > 0) {
-                filled_cells_front_row++;
-            }
-        }
-        return (double)record_count / (double)filled_cells_front_row;
+        return (double)record_count / (double)FilledCellCount(0);
     }
 
     T GetMin() const {
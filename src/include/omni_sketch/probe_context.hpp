@@ -0,0 +1,120 @@
+#pragma once
+
+#include "omni_sketch_cell.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace omnisketch {
+
+// Reusable scratch space for probing an OmniSketch. A probe adds the matching cell of every row and then intersects
+// them. All buffers are kept between probes, so once they have grown to their steady-state size, probing a flattened
+// sketch does not allocate.
+class ProbeContext {
+public:
+    ProbeContext() = default;
+
+    void Reset(size_t max_sample_count_p);
+    void AddRow(const uint64_t* row_samples, size_t row_sample_count, size_t row_record_count);
+    // Rows with 32-bit samples (see SampleWidth). All rows of a probe have to be of the same width.
+    void AddRow(const uint32_t* row_samples, size_t row_sample_count, size_t row_record_count);
+    void AddRow(const MinHashSketch& row_sketch, size_t row_record_count);
+    void Intersect();
+
+    // Estimated number of records that match the probe
+    size_t RecordCount() const {
+        return record_count;
+    }
+    // Largest record count among the probed cells
+    size_t MaxRecordCount() const {
+        return n_max;
+    }
+    size_t SampleCount() const {
+        return samples.size();
+    }
+    size_t MaxSampleCount() const {
+        return max_sample_count;
+    }
+    const std::vector<uint64_t>& Samples() const {
+        return samples;
+    }
+    // Copies the probe result into a standalone cell
+    std::shared_ptr<OmniSketchCell> ToCell() const;
+    // Room for the columns of a probed hash in each of the depth rows
+    size_t* ColIdxs(size_t depth) {
+        col_idxs.resize(depth);
+        return col_idxs.data();
+    }
+
+private:
+    size_t max_sample_count = 0;
+    size_t row_count = 0;
+    std::vector<const uint64_t*> row_offsets;
+    std::vector<const uint64_t*> row_ends;
+    std::vector<const uint32_t*> narrow_row_offsets;
+    std::vector<const uint32_t*> narrow_row_ends;
+    std::vector<uint32_t> narrow_samples;
+    // Holds the samples of rows that are not backed by contiguous memory
+    std::vector<std::vector<uint64_t>> row_buffers;
+    std::vector<uint64_t> samples;
+    std::vector<size_t> col_idxs;
+
+    size_t n_max = 0;
+    size_t n_max_sample_count = 0;
+    size_t n_min = 0;
+    size_t record_count = 0;
+};
+
+// The results of probing many hashes at once (see OmniSketch::ProbeHashes()): the estimated and the largest record
+// count of every probe, and its samples, which all probes keep in one shared buffer. Like a ProbeContext, a batch
+// keeps its buffers between probes.
+class ProbeBatch {
+public:
+    ProbeBatch() = default;
+
+    void Clear();
+    // Appends the result of the probe that context holds
+    void Append(const ProbeContext& probe_context);
+
+    size_t Size() const {
+        return record_counts.size();
+    }
+    size_t RecordCount(size_t probe_idx) const {
+        return record_counts[probe_idx];
+    }
+    size_t MaxRecordCount(size_t probe_idx) const {
+        return max_record_counts[probe_idx];
+    }
+    size_t SampleCount(size_t probe_idx) const {
+        return sample_offsets[probe_idx + 1] - sample_offsets[probe_idx];
+    }
+    // The sorted samples of a probe are [SamplesBegin(), SamplesEnd())
+    const uint64_t* SamplesBegin(size_t probe_idx) const {
+        return samples.data() + sample_offsets[probe_idx];
+    }
+    const uint64_t* SamplesEnd(size_t probe_idx) const {
+        return samples.data() + sample_offsets[probe_idx + 1];
+    }
+
+    // Scratch space for the single probes of the batch
+    ProbeContext& Context() {
+        return context;
+    }
+    // Room for the columns of count probed hashes in each of the depth rows, depth per hash
+    size_t* ColIdxs(size_t count, size_t depth) {
+        col_idxs.resize(count * depth);
+        return col_idxs.data();
+    }
+
+private:
+    ProbeContext context;
+    std::vector<size_t> col_idxs;
+    std::vector<size_t> record_counts;
+    std::vector<size_t> max_record_counts;
+    // The samples of probe probe_idx are [sample_offsets[probe_idx], sample_offsets[probe_idx + 1]) of samples
+    std::vector<size_t> sample_offsets = {0};
+    std::vector<uint64_t> samples;
+};
+
+}  // namespace omnisketch
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cell_arena.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace omnisketch {
+namespace sketch_file {
+
+// Binary sketch files consist of a fixed-size header, the names and string bounds, and 8-byte aligned arrays. With
+// raw samples, the arrays have the layout of a CellArena: record counts (width * depth), sample offsets
+// (width * depth + 1), and the sample slab. With delta-encoded samples, they are record counts, sample counts, block
+// offsets and word offsets per cell, followed by the MinHashSketchCompressed blocks and words of all cells. Raw 32-bit
+// samples (see SampleWidth) are stored as their upper halves, delta-encoded ones as truncated 64-bit hashes. All
+// integers are stored in native byte order, and files are rejected if the magic, version or byte order do not match.
+// Version 1 files (raw 64-bit samples only) can still be read.
+constexpr uint64_t MAGIC = 0x4b534d4f4e4d4f53;  // "SOMNOMSK"
+constexpr uint32_t VERSION = 2;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr const char* FILE_EXTENSION = ".omni";
+
+enum class SketchKind : uint32_t { RID_SAMPLE = 0, STANDARD = 1, PRE_JOINED = 2 };
+enum class DataType : uint32_t { NONE = 0, UINT = 1, INT = 2, DOUBLE = 3, VARCHAR = 4 };
+enum class SampleEncoding : uint32_t { RAW = 0, DELTA = 1 };
+
+// Everything about a sketch besides its cells. A rid sample is stored as a sketch with a single cell.
+struct SketchInfo {
+    SketchKind kind = SketchKind::STANDARD;
+    DataType data_type = DataType::NONE;
+    SampleEncoding sample_encoding = SampleEncoding::RAW;
+    SampleWidth sample_width = SampleWidth::BITS_64;
+    std::string table_name;
+    std::string column_name;
+    std::string referencing_table_name;
+    size_t width = 1;
+    size_t depth = 1;
+    size_t min_hash_sketch_size = 0;
+    size_t record_count = 0;
+    size_t null_count = 0;
+    // Numeric bounds are stored bitwise in min_bits/max_bits, string bounds in min_string/max_string
+    uint64_t min_bits = 0;
+    uint64_t max_bits = 0;
+    std::string min_string;
+    std::string max_string;
+};
+
+struct MappedSketch {
+    SketchInfo info;
+    // Raw samples: points into the file mapping, which stays alive as long as the arena. Has 32-bit samples if the file
+    // has.
+    std::shared_ptr<CellArena> cells;
+    // Delta-encoded samples: one cell per row and column (row-major) with a MinHashSketchCompressed that points into
+    // the file mapping
+    std::vector<std::shared_ptr<OmniSketchCell>> compressed_cells;
+};
+
+// Writes the samples in the encoding given by info. The sample width is the one of the arena, which has to be laid out
+// row by row. An existing file is replaced atomically, so sketches that are still mapped from it can be written back.
+void Write(const std::string& path, const SketchInfo& info, const CellArena& cells);
+// Maps the file read-only and wraps its cells without copying them
+MappedSketch Map(const std::string& path);
+// Reads only the header and the strings of the file
+SketchInfo ReadInfo(const std::string& path);
+bool HasFileExtension(const std::string& path);
+
+}  // namespace sketch_file
+}  // namespace omnisketch
@@ -3,6 +3,8 @@
 #include "min_hash_sketch/min_hash_sketch_vector.hpp"
 #include "omni_sketch.hpp"
 
+#include <limits>
+
 namespace omnisketch {
 
 template <typename T>
@@ -11,9 +13,11 @@ public:
     TypedPointOmniSketch(size_t width_p, size_t depth_p, size_t max_sample_count_p,
                          std::shared_ptr<HashFunction<T>> hash_function_p,
                          std::shared_ptr<SetMembershipAlgorithm> set_membership_algo_p,
-                         std::shared_ptr<CellIdxMapper> hash_processor_p)
+                         std::shared_ptr<CellIdxMapper> hash_processor_p,
+                         const std::shared_ptr<MinHashSketch::SketchFactory>& factory =
+                             std::make_shared<MinHashSketchSet::SketchFactory>())
         : PointOmniSketch(width_p, depth_p, max_sample_count_p, std::move(set_membership_algo_p),
-                          std::move(hash_processor_p)),
+                          std::move(hash_processor_p), factory),
           hf(std::move(hash_function_p)) {
     }
 
@@ -28,6 +32,48 @@ public:
         PointOmniSketch::AddRecordHashed(hf->Hash(value), hf->HashRid(record_id));
     }
 
+    void AddRecords(const T* values, const uint64_t* record_ids, size_t count) {
+        record_id_hash_buffer.resize(count);
+        hf->HashRids(record_ids, count, record_id_hash_buffer.data());
+        AddRecordsWithRidHashes(values, record_id_hash_buffer.data(), count);
+    }
+
+    // Like AddRecords(), for record ids that are already hashed by HashRid() (e.g., once for all columns of a table)
+    void AddRecordsWithRidHashes(const T* values, const uint64_t* record_id_hashes, size_t count) {
+        for (size_t record_idx = 0; record_idx < count; record_idx++) {
+            min = std::min(min, values[record_idx]);
+            max = std::max(max, values[record_idx]);
+        }
+        value_hash_buffer.resize(count);
+        hf->HashValues(values, count, value_hash_buffer.data());
+        PointOmniSketch::AddRecordsHashed(value_hash_buffer.data(), record_id_hashes, count);
+    }
+
+    // Computes the cells of the value for AddMappedRecords() and widens the bounds to include it, e.g., once per
+    // distinct value of a column
+    void MapValue(const T& value, uint32_t* cell_idxs) {
+        min = std::min(min, value);
+        max = std::max(max, value);
+        PointOmniSketch::ComputeCellIdxs(hf->Hash(value), cell_idxs);
+    }
+
+    // Adds records whose values were mapped with MapValue() before
+    void AddMappedRecords(const uint32_t* cell_idxs, const uint64_t* record_ids, size_t count) {
+        record_id_hash_buffer.resize(count);
+        hf->HashRids(record_ids, count, record_id_hash_buffer.data());
+        PointOmniSketch::AddRecordsToCells(cell_idxs, record_id_hash_buffer.data(), count);
+    }
+
+    // The bounds of GetMin() and GetMax() are kept, so they may be wider than the remaining values
+    void RemoveRecord(const T& value, uint64_t record_id) {
+        PointOmniSketch::RemoveRecordHashed(hf->Hash(value), hf->HashRid(record_id));
+    }
+
+    void UpdateRecord(const T& old_value, const T& new_value, uint64_t record_id) {
+        RemoveRecord(old_value, record_id);
+        AddRecord(new_value, record_id);
+    }
+
     std::shared_ptr<OmniSketchCell> Probe(const T& value) const {
         std::vector<std::shared_ptr<OmniSketchCell>> matches(depth);
         return PointOmniSketch::ProbeHash(hf->Hash(value), matches);
@@ -54,14 +100,16 @@ public:
         return PointOmniSketch::ProbeHashedSet(std::make_shared<MinHashSketchVector>(hashes));
     }
 
-    double EstimateAverageMatchesPerProbe() const override {
-        size_t filled_cells_front_row = 0;
-        for (auto& cell : cells.front()) {
-            if (cell->RecordCount() > 0) {
-                filled_cells_front_row++;
-            }
+    void Combine(const std::shared_ptr<OmniSketch>& other) override {
+        PointOmniSketch::Combine(other);
+        if (auto typed_other = std::dynamic_pointer_cast<TypedPointOmniSketch<T>>(other)) {
+            min = std::min(min, typed_other->min);
+            max = std::max(max, typed_other->max);
         }
-        return (double)record_count / (double)filled_cells_front_row;
+    }
+
+    double EstimateAverageMatchesPerProbe() const override {
+        return (double)record_count / (double)FilledCellCount(0);
     }
 
     T GetMin() const {
@@ -88,6 +136,8 @@ protected:
     std::shared_ptr<HashFunction<T>> hf;
     T min = std::numeric_limits<T>::max();
     T max = std::numeric_limits<T>::min();
+    std::vector<uint64_t> value_hash_buffer;
+    std::vector<uint64_t> record_id_hash_buffer;
 };
 
 template <>
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "min_hash_sketch/min_hash_sketch_span.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector.hpp"
+#include "omni_sketch.hpp"
+#include "standard_omni_sketch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace omnisketch {
+
+// An OmniSketch whose width, depth, and sample count are fixed at compile time. All cells live in one std::array, the
+// row loop is unrolled, and the row hashes are reduced to the width by a constant (a mask, if WIDTH is a power of
+// two). A value lands in the same cells as in a TypedPointOmniSketch of the same shape with a
+// BarrettModSplitHashMapper, so both kinds of sketches can be combined and mixed in a CombinedPredicateEstimator. The
+// Registry (and so the PlanGenerator) only holds PointOmniSketches. The cells take about
+// WIDTH * DEPTH * SAMPLE_COUNT * 8 bytes, so sketches belong on the heap (std::make_shared), not on the stack.
+template <typename T, size_t WIDTH, size_t DEPTH, size_t SAMPLE_COUNT>
+class StaticOmniSketch : public OmniSketch,
+                         public std::enable_shared_from_this<StaticOmniSketch<T, WIDTH, DEPTH, SAMPLE_COUNT>> {
+    static_assert(WIDTH > 0 && WIDTH <= UINT32_MAX, "The width has to be within the range of the row hashes.");
+    static_assert(DEPTH > 0 && SAMPLE_COUNT > 0, "A sketch needs at least one row and one sample per cell.");
+
+public:
+    static constexpr size_t CELL_COUNT = WIDTH * DEPTH;
+
+    explicit StaticOmniSketch(
+        std::shared_ptr<HashFunction<T>> hash_function_p = std::make_shared<MurmurHashFunction<T>>(),
+        std::shared_ptr<SetMembershipAlgorithm> set_membership_algo_p = std::make_shared<ProbeAllSum>())
+        : hf(std::move(hash_function_p)), set_membership_algo(std::move(set_membership_algo_p)) {
+    }
+
+    // The cell of the hash in every row, as row_idx * WIDTH + col_idx
+    static std::array<size_t, DEPTH> ComputeCellIdxs(uint64_t hash) {
+        return ComputeCellIdxs(hash, std::make_index_sequence<DEPTH>());
+    }
+
+    void AddRecord(const T& value, uint64_t record_id) {
+        min = std::min(min, value);
+        max = std::max(max, value);
+        AddRecordHashed(hf->Hash(value), hf->HashRid(record_id));
+    }
+
+    void AddRecords(const T* values, const uint64_t* record_ids, size_t count) {
+        for (size_t record_idx = 0; record_idx < count; record_idx++) {
+            AddRecord(values[record_idx], record_ids[record_idx]);
+        }
+    }
+
+    // The bounds of GetMin() and GetMax() are kept, so they may be wider than the remaining values
+    void RemoveRecord(const T& value, uint64_t record_id) {
+        RemoveRecordHashed(hf->Hash(value), hf->HashRid(record_id));
+    }
+
+    void UpdateRecord(const T& old_value, const T& new_value, uint64_t record_id) {
+        RemoveRecord(old_value, record_id);
+        AddRecord(new_value, record_id);
+    }
+
+    std::shared_ptr<OmniSketchCell> Probe(const T& value) const {
+        std::vector<std::shared_ptr<OmniSketchCell>> matches(DEPTH);
+        return ProbeHash(hf->Hash(value), matches);
+    }
+
+    void Probe(const T& value, ProbeContext& context, size_t max_samples = 0) const {
+        ProbeHash(hf->Hash(value), context, max_samples);
+    }
+
+    T GetMin() const {
+        return min;
+    }
+
+    T GetMax() const {
+        return max;
+    }
+
+    size_t RecordCount() const override {
+        return record_count;
+    }
+
+    std::shared_ptr<OmniSketchCell> ProbeHash(uint64_t hash, std::vector<std::shared_ptr<OmniSketchCell>>& matches,
+                                              size_t max_samples = 0) const override {
+        assert(matches.size() == DEPTH);
+        const auto cell_idxs = ComputeCellIdxs(hash);
+        for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+            matches[row_idx] = CellAt(cell_idxs[row_idx]);
+        }
+        return OmniSketchCell::Intersect(matches, max_samples);
+    }
+
+    void ProbeHash(uint64_t hash, ProbeContext& context, size_t max_samples = 0) const override {
+        context.Reset(max_samples == 0 ? SAMPLE_COUNT : max_samples);
+        const auto cell_idxs = ComputeCellIdxs(hash);
+        for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+            __builtin_prefetch(&cells[cell_idxs[row_idx]]);
+        }
+        for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+            const Cell& cell = cells[cell_idxs[row_idx]];
+            context.AddRow(cell.samples.data(), cell.sample_count, cell.record_count);
+        }
+        context.Intersect();
+    }
+
+    void ProbeHashes(const uint64_t* hashes, size_t count, ProbeBatch& batch, size_t max_samples = 0) const override {
+        batch.Clear();
+        // Keeps the cell indexes (rather than the columns) of the hashes
+        size_t* cell_idxs = batch.ColIdxs(count, DEPTH);
+        for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+            const auto hash_cell_idxs = ComputeCellIdxs(hashes[hash_idx]);
+            for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+                cell_idxs[hash_idx * DEPTH + row_idx] = hash_cell_idxs[row_idx];
+                // A cell starts with its counts, followed by its first samples, so one prefetch covers both
+                __builtin_prefetch(&cells[hash_cell_idxs[row_idx]]);
+            }
+        }
+
+        auto& context = batch.Context();
+        for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+            context.Reset(max_samples == 0 ? SAMPLE_COUNT : max_samples);
+            for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+                const Cell& cell = cells[cell_idxs[hash_idx * DEPTH + row_idx]];
+                context.AddRow(cell.samples.data(), cell.sample_count, cell.record_count);
+            }
+            context.Intersect();
+            batch.Append(context);
+        }
+    }
+
+    std::shared_ptr<OmniSketchCell> ProbeHashedSet(const std::shared_ptr<MinHashSketch>& values) const override {
+        std::vector<uint64_t> hashes;
+        hashes.reserve(values->Size());
+        for (auto value_it = values->Iterator(); !value_it->IsAtEnd(); value_it->Next()) {
+            hashes.push_back(value_it->Current());
+        }
+        return ProbeHashSet(hashes);
+    }
+
+    std::shared_ptr<OmniSketchCell> ProbeHashedSet(const std::shared_ptr<OmniSketchCell>& values) const override {
+        return ProbeHashedSet(values->GetMinHashSketch());
+    }
+
+    double EstimateAverageMatchesPerProbe() const override {
+        size_t filled_cell_count = 0;
+        for (size_t col_idx = 0; col_idx < WIDTH; col_idx++) {
+            filled_cell_count += cells[col_idx].record_count > 0;
+        }
+        return EstimateAverageMatches(record_count, filled_cell_count, min, max);
+    }
+
+    void AddValueRecord(const Value& value, uint64_t record_id) override {
+        AddRecordHashed(value.GetHash(), hash_functions::Hash(record_id));
+    }
+
+    void AddRecordHashed(uint64_t value_hash, uint64_t record_id_hash) override {
+        const auto cell_idxs = ComputeCellIdxs(value_hash);
+        for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+            AddToCell(cells[cell_idxs[row_idx]], record_id_hash);
+        }
+        record_count++;
+    }
+
+    void AddRecordsHashed(const uint64_t* value_hashes, const uint64_t* record_id_hashes, size_t count) override {
+        for (size_t record_idx = 0; record_idx < count; record_idx++) {
+            AddRecordHashed(value_hashes[record_idx], record_id_hashes[record_idx]);
+        }
+    }
+
+    void AddNullValues(size_t count) override {
+        record_count += count;
+        null_count += count;
+    }
+
+    void RemoveValueRecord(const Value& value, uint64_t record_id) override {
+        RemoveRecordHashed(value.GetHash(), hash_functions::Hash(record_id));
+    }
+
+    // Removals leave cells underfilled like in PointOmniSketch::RemoveValueRecord()
+    void RemoveRecordHashed(uint64_t value_hash, uint64_t record_id_hash) override {
+        assert(record_count > null_count);
+        const auto cell_idxs = ComputeCellIdxs(value_hash);
+        for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+            RemoveFromCell(cells[cell_idxs[row_idx]], record_id_hash);
+        }
+        record_count--;
+    }
+
+    void RemoveNullValues(size_t count) override {
+        assert(null_count >= count);
+        record_count -= count;
+        null_count -= count;
+    }
+
+    size_t CountNulls() const override {
+        return null_count;
+    }
+
+    std::shared_ptr<OmniSketchCell> ProbeValue(const Value& value) const override {
+        std::vector<std::shared_ptr<OmniSketchCell>> matches(DEPTH);
+        return ProbeHash(value.GetHash(), matches);
+    }
+
+    std::shared_ptr<OmniSketchCell> ProbeValueSet(const ValueSet& values) const override {
+        return ProbeHashSet(values.GetHashes());
+    }
+
+    // The cells are always stored flat
+    void Flatten() override {
+    }
+
+    bool IsFlattened() const override {
+        return true;
+    }
+
+    size_t EstimateByteSize() const override {
+        return sizeof(cells);
+    }
+
+    size_t Depth() const override {
+        return DEPTH;
+    }
+
+    size_t Width() const override {
+        return WIDTH;
+    }
+
+    size_t MinHashSketchSize() const override {
+        return SAMPLE_COUNT;
+    }
+
+    std::shared_ptr<OmniSketchCell> GetRids() const override {
+        std::vector<std::shared_ptr<OmniSketchCell>> front_row;
+        front_row.reserve(WIDTH);
+        for (size_t col_idx = 0; col_idx < WIDTH; col_idx++) {
+            front_row.push_back(CellAt(col_idx));
+        }
+        return OmniSketchCell::Combine(front_row);
+    }
+
+    // Combines sketches of the same shape, either static or dynamic ones
+    void Combine(const std::shared_ptr<OmniSketch>& other) override {
+        if (other->Width() != WIDTH || other->Depth() != DEPTH || other->MinHashSketchSize() != SAMPLE_COUNT) {
+            throw std::logic_error("Only sketches of the same shape can be combined.");
+        }
+        std::vector<uint64_t> other_samples;
+        if (auto static_other = std::dynamic_pointer_cast<StaticOmniSketch>(other)) {
+            for (size_t cell_idx = 0; cell_idx < CELL_COUNT; cell_idx++) {
+                const Cell& other_cell = static_other->cells[cell_idx];
+                CombineCell(cells[cell_idx], other_cell.samples.data(), other_cell.sample_count,
+                            other_cell.record_count, other_cell.sample_threshold);
+            }
+            min = std::min(min, static_other->min);
+            max = std::max(max, static_other->max);
+        } else {
+            for (size_t cell_idx = 0; cell_idx < CELL_COUNT; cell_idx++) {
+                const auto other_cell = other->GetCell(cell_idx / WIDTH, cell_idx % WIDTH);
+                other_samples.clear();
+                for (auto it = other_cell.GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
+                    other_samples.push_back(it->Current());
+                }
+                std::sort(other_samples.begin(), other_samples.end());
+                CombineCell(cells[cell_idx], other_samples.data(), other_samples.size(), other_cell.RecordCount(),
+                            other->SampleThreshold(cell_idx / WIDTH, cell_idx % WIDTH));
+            }
+            if (auto typed_other = std::dynamic_pointer_cast<TypedPointOmniSketch<T>>(other)) {
+                min = std::min(min, typed_other->GetMin());
+                max = std::max(max, typed_other->GetMax());
+            }
+        }
+        record_count += other->RecordCount();
+        null_count += other->CountNulls();
+    }
+
+    OmniSketchCell GetCell(size_t row_idx, size_t col_idx) const override {
+        const Cell& cell = cells[row_idx * WIDTH + col_idx];
+        auto sketch = std::make_shared<MinHashSketchVector>(SAMPLE_COUNT);
+        sketch->Data().assign(cell.samples.begin(), cell.samples.begin() + cell.sample_count);
+        return OmniSketchCell(std::move(sketch), cell.record_count);
+    }
+
+    uint64_t SampleThreshold(size_t row_idx, size_t col_idx) const override {
+        return cells[row_idx * WIDTH + col_idx].sample_threshold;
+    }
+
+    OmniSketchType Type() const override {
+        return OmniSketchType::STANDARD;
+    }
+
+private:
+    struct Cell {
+        size_t record_count = 0;
+        size_t sample_count = 0;
+        // Largest record id hash that the cell may still sample after it lost samples to removals
+        uint64_t sample_threshold = UINT64_MAX;
+        // The sample_count smallest record id hashes of the cell, sorted
+        std::array<uint64_t, SAMPLE_COUNT> samples;
+    };
+
+    template <size_t... RowIdxs>
+    static std::array<size_t, DEPTH> ComputeCellIdxs(uint64_t hash, std::index_sequence<RowIdxs...>) {
+        return {{RowIdxs * WIDTH + ReduceToWidth(BarrettModSplitHashMapper::RowHash(hash, RowIdxs))...}};
+    }
+
+    static size_t ReduceToWidth(uint32_t row_hash) {
+        return (WIDTH & (WIDTH - 1)) == 0 ? row_hash & (WIDTH - 1) : row_hash % WIDTH;
+    }
+
+    // The same estimates as TypedPointOmniSketch::EstimateAverageMatchesPerProbe()
+    template <typename U>
+    static double EstimateAverageMatches(size_t record_count, size_t filled_cell_count, const U&, const U&) {
+        return (double)record_count / (double)filled_cell_count;
+    }
+    static double EstimateAverageMatches(size_t record_count, size_t, size_t min_value, size_t max_value) {
+        return (double)record_count / (double)(max_value - min_value);
+    }
+
+    std::shared_ptr<OmniSketchCell> CellAt(size_t cell_idx) const {
+        const Cell& cell = cells[cell_idx];
+        auto sketch = std::make_shared<MinHashSketchSpan>(cell.samples.data(), cell.sample_count, SAMPLE_COUNT,
+                                                          this->shared_from_this());
+        return std::make_shared<OmniSketchCell>(std::move(sketch), cell.record_count);
+    }
+
+    std::shared_ptr<OmniSketchCell> ProbeHashSet(const std::vector<uint64_t>& hashes) const {
+        std::vector<std::vector<std::shared_ptr<OmniSketchCell>>> matches(
+            hashes.size(), std::vector<std::shared_ptr<OmniSketchCell>>(DEPTH));
+        for (size_t value_idx = 0; value_idx < hashes.size(); value_idx++) {
+            const auto cell_idxs = ComputeCellIdxs(hashes[value_idx]);
+            for (size_t row_idx = 0; row_idx < DEPTH; row_idx++) {
+                matches[value_idx][row_idx] = CellAt(cell_idxs[row_idx]);
+            }
+        }
+        return set_membership_algo->Execute(SAMPLE_COUNT, matches);
+    }
+
+    // Keeps the SAMPLE_COUNT smallest distinct hashes, like MinHashSketchSet::AddRecord()
+    static void InsertSample(Cell& cell, uint64_t hash) {
+        if (cell.sample_count == SAMPLE_COUNT && hash >= cell.samples[SAMPLE_COUNT - 1]) {
+            return;
+        }
+        const auto end = cell.samples.begin() + cell.sample_count;
+        const auto position = std::lower_bound(cell.samples.begin(), end, hash);
+        if (position != end && *position == hash) {
+            return;
+        }
+        if (cell.sample_count < SAMPLE_COUNT) {
+            std::copy_backward(position, end, end + 1);
+            cell.sample_count++;
+        } else {
+            std::copy_backward(position, end - 1, end);
+        }
+        *position = hash;
+    }
+
+    static void AddToCell(Cell& cell, uint64_t record_id_hash) {
+        cell.record_count++;
+        if (record_id_hash > cell.sample_threshold) {
+            return;
+        }
+        InsertSample(cell, record_id_hash);
+        // A full cell holds the smallest record id hashes again
+        if (cell.sample_count == SAMPLE_COUNT) {
+            cell.sample_threshold = UINT64_MAX;
+        }
+    }
+
+    static void RemoveFromCell(Cell& cell, uint64_t record_id_hash) {
+        assert(cell.record_count > 0);
+        cell.record_count--;
+        const auto end = cell.samples.begin() + cell.sample_count;
+        const auto position = std::lower_bound(cell.samples.begin(), end, record_id_hash);
+        if (position == end || *position != record_id_hash) {
+            return;
+        }
+        // Records above the largest sample of a full cell were dropped, so they cannot replace the erased sample
+        if (cell.sample_count == SAMPLE_COUNT) {
+            cell.sample_threshold = std::min(cell.sample_threshold, cell.samples[SAMPLE_COUNT - 1]);
+        }
+        std::copy(position + 1, end, position);
+        cell.sample_count--;
+    }
+
+    // Merges the sorted samples of another cell, keeping the SAMPLE_COUNT smallest ones below both sample thresholds
+    static void CombineCell(Cell& cell, const uint64_t* other_samples, size_t other_sample_count,
+                            size_t other_record_count, uint64_t other_sample_threshold) {
+        const uint64_t threshold = std::min(cell.sample_threshold, other_sample_threshold);
+        std::array<uint64_t, SAMPLE_COUNT> merged;
+        size_t merged_count = 0;
+        size_t idx = 0;
+        size_t other_idx = 0;
+        while (merged_count < SAMPLE_COUNT && (idx < cell.sample_count || other_idx < other_sample_count)) {
+            uint64_t next;
+            if (other_idx == other_sample_count ||
+                (idx < cell.sample_count && cell.samples[idx] <= other_samples[other_idx])) {
+                next = cell.samples[idx++];
+            } else {
+                next = other_samples[other_idx++];
+            }
+            if (next > threshold) {
+                break;
+            }
+            if (merged_count == 0 || merged[merged_count - 1] != next) {
+                merged[merged_count++] = next;
+            }
+        }
+        std::copy(merged.begin(), merged.begin() + merged_count, cell.samples.begin());
+        cell.sample_count = merged_count;
+        cell.record_count += other_record_count;
+        cell.sample_threshold = merged_count == SAMPLE_COUNT ? UINT64_MAX : threshold;
+    }
+
+    std::shared_ptr<HashFunction<T>> hf;
+    std::shared_ptr<SetMembershipAlgorithm> set_membership_algo;
+    size_t record_count = 0;
+    size_t null_count = 0;
+    T min = std::numeric_limits<T>::max();
+    T max = std::numeric_limits<T>::min();
+    std::array<Cell, CELL_COUNT> cells;
+};
+
+template <typename T, size_t WIDTH, size_t DEPTH, size_t SAMPLE_COUNT>
+constexpr size_t StaticOmniSketch<T, WIDTH, DEPTH, SAMPLE_COUNT>::CELL_COUNT;
+
+// The shapes of the production configurations are compiled once, in static_omni_sketch.cpp
+extern template class StaticOmniSketch<int32_t, 256, 3, 512>;
+extern template class StaticOmniSketch<size_t, 256, 3, 512>;
+extern template class StaticOmniSketch<double, 256, 3, 512>;
+extern template class StaticOmniSketch<std::string, 256, 3, 512>;
+extern template class StaticOmniSketch<int32_t, 16, 3, 32>;
+extern template class StaticOmniSketch<size_t, 16, 3, 32>;
+extern template class StaticOmniSketch<double, 16, 3, 32>;
+extern template class StaticOmniSketch<std::string, 16, 3, 32>;
+
+}  // namespace omnisketch
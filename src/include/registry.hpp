@@ -1,13 +1,18 @@
 #pragma once
 
-#include <dirent.h>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <variant>
 
 #include "json/json.hpp"
+#include "min_hash_sketch/min_hash_sketch_buffered.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
 #include "omni_sketch/pre_joined_omni_sketch.hpp"
+#include "omni_sketch/sketch_file.hpp"
 #include "omni_sketch/standard_omni_sketch.hpp"
+#include "sketch_directory.hpp"
+#include "util/thread_pool.hpp"
 
 namespace omnisketch {
 
@@ -17,12 +22,27 @@ struct OmniSketchConfig {
         hash_processor = std::make_shared<BarrettModSplitHashMapper>(width);
     }
 
+    // 32-bit samples halve the size of the cells, but distinct records may collide (see SampleWidth). Samples that
+    // are probed into other sketches as join keys (e.g., primary keys) lose their lower half, so tables that are
+    // joined on their row ids have to keep 64-bit samples (see CombinedPredicateEstimator::CheckJoinKeys).
+    void SetSampleWidth(SampleWidth sample_width_p) {
+        sample_width = sample_width_p;
+        if (sample_width == SampleWidth::BITS_32) {
+            sketch_factory = std::make_shared<MinHashSketchVector32::SketchFactory>();
+        } else {
+            sketch_factory = std::make_shared<MinHashSketchBuffered::SketchFactory>();
+        }
+    }
+
     size_t width = 256;
     size_t depth = 3;
     size_t sample_count = 64;
+    SampleWidth sample_width = SampleWidth::BITS_64;
     std::shared_ptr<SetMembershipAlgorithm> set_membership_algo = std::make_shared<ProbeAllSum>();
     std::shared_ptr<CellIdxMapper> hash_processor = std::make_shared<BarrettModSplitHashMapper>(width);
     std::shared_ptr<OmniSketchType> referencing_type;
+    std::shared_ptr<MinHashSketch::SketchFactory> sketch_factory =
+        std::make_shared<MinHashSketchBuffered::SketchFactory>();
 };
 
 struct OmniSketchEntry {
@@ -32,12 +52,130 @@ struct OmniSketchEntry {
 
 using TableEntry = std::unordered_map<std::string, OmniSketchEntry>;
 
+// The registered sketches at one point in time. A published snapshot is never modified (updates publish a modified
+// copy instead), so any number of threads can read it without synchronization. Sketches that are not registered
+// directly are looked up in the lazily loaded sketch directory, if there is one.
+struct RegistrySnapshot {
+    std::shared_ptr<PointOmniSketch> FindOmniSketch(const std::string& table_name,
+                                                    const std::string& column_name) const {
+        const auto table_entry = sketches.find(table_name);
+        if (table_entry != sketches.end()) {
+            const auto column_entry = table_entry->second.find(column_name);
+            if (column_entry != table_entry->second.end() && column_entry->second.main_sketch) {
+                return column_entry->second.main_sketch;
+            }
+        }
+        return directory ? directory->FindOmniSketch(table_name, column_name) : nullptr;
+    }
+
+    // Does not load anything from the sketch directory
+    bool HasOmniSketch(const std::string& table_name, const std::string& column_name) const {
+        const auto table_entry = sketches.find(table_name);
+        if (table_entry != sketches.end()) {
+            const auto column_entry = table_entry->second.find(column_name);
+            if (column_entry != table_entry->second.end() && column_entry->second.main_sketch) {
+                return true;
+            }
+        }
+        return directory && directory->HasOmniSketch(table_name, column_name);
+    }
+
+    // The header of the column's sketch file if the sketch is only in the sketch directory (see
+    // SketchDirectory::FindFileInfo()). Does not load anything.
+    const sketch_file::SketchInfo* FindFileInfo(const std::string& table_name, const std::string& column_name) const {
+        const auto table_entry = sketches.find(table_name);
+        if (table_entry != sketches.end()) {
+            const auto column_entry = table_entry->second.find(column_name);
+            if (column_entry != table_entry->second.end() && column_entry->second.main_sketch) {
+                return nullptr;
+            }
+        }
+        return directory ? directory->FindFileInfo(table_name, column_name) : nullptr;
+    }
+
+    // The name of an arbitrary column of the table, or an empty string if the table is unknown
+    std::string AnyColumnName(const std::string& table_name) const {
+        const auto table_entry = sketches.find(table_name);
+        if (table_entry != sketches.end() && !table_entry->second.empty()) {
+            return table_entry->second.begin()->first;
+        }
+        return directory ? directory->FirstColumnName(table_name) : std::string();
+    }
+
+    std::shared_ptr<PointOmniSketch> FindReferencingOmniSketch(const std::string& table_name,
+                                                               const std::string& column_name,
+                                                               const std::string& referencing_table_name) const {
+        const auto table_entry = sketches.find(table_name);
+        if (table_entry != sketches.end()) {
+            const auto column_entry = table_entry->second.find(column_name);
+            if (column_entry != table_entry->second.end()) {
+                const auto& referencing_sketches = column_entry->second.referencing_sketches;
+                const auto referencing_sketch = referencing_sketches.find(referencing_table_name);
+                if (referencing_sketch != referencing_sketches.end()) {
+                    return referencing_sketch->second;
+                }
+            }
+        }
+        return directory ? directory->FindReferencingOmniSketch(table_name, column_name, referencing_table_name)
+                         : nullptr;
+    }
+
+    std::shared_ptr<OmniSketchCell> FindRidSample(const std::string& table_name) const {
+        const auto rid_sketch = rid_sketches.find(table_name);
+        if (rid_sketch != rid_sketches.end()) {
+            return rid_sketch->second;
+        }
+        return directory ? directory->FindRidSample(table_name) : nullptr;
+    }
+
+    // Adds all sketches of other, replacing sketches with the same names
+    void Merge(const RegistrySnapshot& other) {
+        for (const auto& table : other.sketches) {
+            auto& table_entry = sketches[table.first];
+            for (const auto& column : table.second) {
+                auto& column_entry = table_entry[column.first];
+                if (column.second.main_sketch) {
+                    column_entry.main_sketch = column.second.main_sketch;
+                }
+                for (const auto& referencing_sketch : column.second.referencing_sketches) {
+                    column_entry.referencing_sketches[referencing_sketch.first] = referencing_sketch.second;
+                }
+            }
+        }
+        for (const auto& rid_sketch : other.rid_sketches) {
+            rid_sketches[rid_sketch.first] = rid_sketch.second;
+        }
+    }
+
+    std::unordered_map<std::string, TableEntry> sketches;
+    std::unordered_map<std::string, std::shared_ptr<OmniSketchCell>> rid_sketches;
+    std::shared_ptr<SketchDirectory> directory;
+};
+
+// Process-wide registry of all sketches. Reads go to the most recently published snapshot, which is replaced
+// atomically on every update, so sketches can be (re)built while other threads estimate.
 class Registry {
 public:
     Registry(Registry const&) = delete;
     void operator=(Registry const&) = delete;
     static Registry& Get();
 
+    // Pins the current snapshot for the calling thread, so that all lookups of, e.g., one estimate see the same
+    // sketches even if they are replaced in the meantime. Nested pins keep the outermost snapshot.
+    class SnapshotPin {
+    public:
+        SnapshotPin();
+        ~SnapshotPin();
+        SnapshotPin(const SnapshotPin&) = delete;
+        SnapshotPin& operator=(const SnapshotPin&) = delete;
+
+    private:
+        bool pinned;
+    };
+
+    // The snapshot pinned by the calling thread, or the current one
+    std::shared_ptr<const RegistrySnapshot> Snapshot() const;
+
     template <typename T>
     std::shared_ptr<TypedPointOmniSketch<T>> CreateOmniSketch(const std::string& table_name,
                                                               const std::string& column_name,
@@ -45,18 +183,21 @@ public:
         assert(!HasOmniSketch(table_name, column_name));
         std::shared_ptr<PointOmniSketch> sketch = std::make_shared<TypedPointOmniSketch<T>>(
             config.width, config.depth, config.sample_count, std::make_shared<MurmurHashFunction<T>>(),
-            config.set_membership_algo, config.hash_processor);
-        sketches[table_name][column_name] = OmniSketchEntry{sketch, {}};
+            config.set_membership_algo, config.hash_processor, config.sketch_factory);
+        Update([&](RegistrySnapshot& snapshot) {
+            snapshot.sketches[table_name][column_name] = OmniSketchEntry{sketch, {}};
+        });
         return std::dynamic_pointer_cast<TypedPointOmniSketch<T>>(sketch);
     }
 
     std::shared_ptr<OmniSketchCell> CreateRidSketch(const std::string& table_name, size_t size) {
-        rid_sketches[table_name] = std::make_shared<OmniSketchCell>(size);
-        return rid_sketches[table_name];
+        auto rid_sketch = std::make_shared<OmniSketchCell>(size);
+        Update([&](RegistrySnapshot& snapshot) { snapshot.rid_sketches[table_name] = rid_sketch; });
+        return rid_sketch;
     }
 
-    std::shared_ptr<OmniSketchCell> GetRidSample(const std::string& table_name) {
-        return rid_sketches[table_name];
+    std::shared_ptr<OmniSketchCell> GetRidSample(const std::string& table_name) const {
+        return Snapshot()->FindRidSample(table_name);
     }
 
     template <typename T, typename U>
@@ -65,97 +206,111 @@ public:
                                                  const std::string& referencing_column_name,
                                                  const OmniSketchConfig& config = OmniSketchConfig{}) {
         assert(HasOmniSketch(table_name, column_name));
-        auto& entry = sketches[table_name][column_name];
-
         std::shared_ptr<PointOmniSketch> sketch =
             std::make_shared<T>(GetOmniSketch(referencing_table_name, referencing_column_name), config.width,
                                 config.depth, config.sample_count, std::make_shared<MurmurHashFunction<U>>(),
-                                config.set_membership_algo, config.hash_processor);
-        entry.referencing_sketches[referencing_table_name] = sketch;
-
+                                config.set_membership_algo, config.hash_processor, config.sketch_factory);
+        Update([&](RegistrySnapshot& snapshot) {
+            snapshot.sketches[table_name][column_name].referencing_sketches[referencing_table_name] = sketch;
+        });
         return std::dynamic_pointer_cast<T>(sketch);
     }
 
+    // Atomically replaces the sketches of the given columns and the rid sample of a table, e.g., after a rebuild.
+    // Other columns of the table are kept.
+    void ReplaceTable(const std::string& table_name, const TableEntry& columns,
+                      const std::shared_ptr<OmniSketchCell>& rid_sketch) {
+        Update([&](RegistrySnapshot& snapshot) {
+            auto& table_entry = snapshot.sketches[table_name];
+            for (const auto& column : columns) {
+                table_entry[column.first] = column.second;
+            }
+            snapshot.rid_sketches[table_name] = rid_sketch;
+        });
+    }
+
     template <typename T>
     std::shared_ptr<TypedPointOmniSketch<T>> GetOmniSketchTyped(const std::string& table_name,
-                                                                const std::string& column_name) {
+                                                                const std::string& column_name) const {
         return std::dynamic_pointer_cast<TypedPointOmniSketch<T>>(GetOmniSketch(table_name, column_name));
     }
 
-    std::shared_ptr<PointOmniSketch> GetOmniSketch(const std::string& table_name, const std::string& column_name) {
-        assert(HasOmniSketch(table_name, column_name));
-        return sketches[table_name][column_name].main_sketch;
+    std::shared_ptr<PointOmniSketch> GetOmniSketch(const std::string& table_name,
+                                                   const std::string& column_name) const {
+        auto sketch = Snapshot()->FindOmniSketch(table_name, column_name);
+        assert(sketch);
+        return sketch;
     }
 
     template <typename T>
     std::shared_ptr<T> FindReferencingOmniSketchTyped(const std::string& table_name, const std::string& column_name,
-                                                      const std::string& referencing_table_name) {
+                                                      const std::string& referencing_table_name) const {
         return std::dynamic_pointer_cast<T>(FindReferencingOmniSketch(table_name, column_name, referencing_table_name));
     }
 
     std::shared_ptr<PointOmniSketch> FindReferencingOmniSketch(const std::string& table_name,
                                                                const std::string& column_name,
-                                                               const std::string& referencing_table_name) {
+                                                               const std::string& referencing_table_name) const {
         assert(HasOmniSketch(table_name, column_name));
-
-        auto entry = sketches[table_name][column_name];
-        if (entry.referencing_sketches.find(referencing_table_name) != entry.referencing_sketches.end()) {
-            return entry.referencing_sketches[referencing_table_name];
-        }
-        return nullptr;
+        return Snapshot()->FindReferencingOmniSketch(table_name, column_name, referencing_table_name);
     }
 
-    bool HasOmniSketch(const std::string& table_name, const std::string& column_name) {
-        auto table_entry = sketches.find(table_name);
-        return table_entry != sketches.end() && table_entry->second.find(column_name) != table_entry->second.end();
+    bool HasOmniSketch(const std::string& table_name, const std::string& column_name) const {
+        return Snapshot()->HasOmniSketch(table_name, column_name);
     }
 
-    std::shared_ptr<OmniSketchCell> ProduceRidSample(const std::string& table_name) {
-        assert(sketches.find(table_name) != sketches.end());
-        return sketches[table_name].begin()->second.main_sketch->GetRids();
+    std::shared_ptr<OmniSketchCell> ProduceRidSample(const std::string& table_name) const {
+        const auto snapshot = Snapshot();
+        const std::string column_name = snapshot->AnyColumnName(table_name);
+        assert(!column_name.empty());
+        return snapshot->FindOmniSketch(table_name, column_name)->GetRids();
     }
 
     std::shared_ptr<OmniSketchCell> TryProduceReferencingRidSample(const std::string& table_name,
-                                                                   const std::string& referencing_table_name) {
-        auto entry = sketches.find(table_name);
-        assert(entry != sketches.end());
-        if (!entry->second.empty()) {
-            const auto& referencing_sketches = entry->second.begin()->second.referencing_sketches;
-            auto referencing_sketch = referencing_sketches.find(referencing_table_name);
-            if (referencing_sketch != referencing_sketches.end()) {
-                return referencing_sketch->second->GetRids();
-            }
-        }
-        return nullptr;
+                                                                   const std::string& referencing_table_name) const {
+        const auto snapshot = Snapshot();
+        const std::string column_name = snapshot->AnyColumnName(table_name);
+        assert(!column_name.empty());
+        auto referencing_sketch = snapshot->FindReferencingOmniSketch(table_name, column_name, referencing_table_name);
+        return referencing_sketch ? referencing_sketch->GetRids() : nullptr;
     }
 
     size_t GetBaseTableCard(const std::string& table_name) const {
-        const auto table_entry_it = sketches.find(table_name);
-        assert(table_entry_it != sketches.end());
-        assert(!table_entry_it->second.empty());
-        return table_entry_it->second.begin()->second.main_sketch->RecordCount();
+        const auto snapshot = Snapshot();
+        const std::string column_name = snapshot->AnyColumnName(table_name);
+        assert(!column_name.empty());
+        return snapshot->FindOmniSketch(table_name, column_name)->RecordCount();
     }
 
     size_t GetMinHashSketchSize(const std::string& table_name) const {
-        const auto table_entry_it = sketches.find(table_name);
-        assert(table_entry_it != sketches.end());
-        assert(!table_entry_it->second.empty());
-        return table_entry_it->second.begin()->second.main_sketch->MinHashSketchSize();
+        const auto snapshot = Snapshot();
+        const std::string column_name = snapshot->AnyColumnName(table_name);
+        assert(!column_name.empty());
+        // Taken from the file header of sketches that are not loaded yet
+        const auto* file_info = snapshot->FindFileInfo(table_name, column_name);
+        return file_info ? file_info->min_hash_sketch_size
+                         : snapshot->FindOmniSketch(table_name, column_name)->MinHashSketchSize();
     }
 
     size_t EstimateByteSize() const {
+        const auto snapshot = Snapshot();
         size_t result = 0;
-        for (auto& table : sketches) {
+        for (auto& table : snapshot->sketches) {
             for (auto& column : table.second) {
-                result += column.second.main_sketch->EstimateByteSize();
+                if (column.second.main_sketch) {
+                    result += column.second.main_sketch->EstimateByteSize();
+                }
                 for (auto& ref_sketch : column.second.referencing_sketches) {
                     result += ref_sketch.second->EstimateByteSize();
                 }
             }
         }
-        for (auto& rid_sketch : rid_sketches) {
+        for (auto& rid_sketch : snapshot->rid_sketches) {
             result += rid_sketch.second->EstimateByteSize();
         }
+        if (snapshot->directory) {
+            result += snapshot->directory->EstimateByteSize();
+        }
         return result;
     }
 
@@ -166,7 +321,7 @@ public:
 
         if (column_name.empty()) {
             nlohmann::json mhs_obj = nlohmann::json::array();
-            auto cell = registry.rid_sketches[table_name];
+            auto cell = registry.GetRidSample(table_name);
             for (auto it = cell->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
                 mhs_obj.push_back(it->Current());
             }
@@ -190,6 +345,7 @@ public:
             sketch = registry.FindReferencingOmniSketch(table_name, column_name, referencing_table_name);
             json_obj["type"] = "prejoined";
         }
+        CheckSerializable(*sketch);
 
         json_obj["table_name"] = table_name;
         json_obj["column_name"] = column_name;
@@ -197,12 +353,16 @@ public:
         json_obj["depth"] = sketch->Depth();
         json_obj["min_hash_sketch_size"] = sketch->MinHashSketchSize();
         json_obj["record_count"] = sketch->RecordCount();
+        // The hashes of 32-bit samples are written truncated
+        if (sketch->GetSampleWidth() == SampleWidth::BITS_32) {
+            json_obj["sample_width"] = 32;
+        }
 
         nlohmann::json rows;
         for (size_t i = 0; i < sketch->Depth(); i++) {
             nlohmann::json row_obj;
             for (size_t j = 0; j < sketch->Width(); j++) {
-                auto& cell = sketch->GetCell(i, j);
+                const auto cell = sketch->GetCell(i, j);
                 nlohmann::json cell_obj;
                 cell_obj["record_count"] = cell.RecordCount();
                 cell_obj["max_sample_count"] = cell.MaxSampleCount();
@@ -267,7 +427,35 @@ public:
         file.close();
     }
 
+    // Writes the same sketch as Serialize in the binary sketch file format, which can be loaded without parsing.
+    // Delta-encoded samples are smaller, and stay compressed once loaded.
+    static void SerializeBinary(const std::string& table_name, const std::string& column_name,
+                                const std::string& referencing_table_name, const std::string& path,
+                                sketch_file::SampleEncoding sample_encoding = sketch_file::SampleEncoding::RAW);
+
+    // Loads a JSON or (if the path ends in ".omni") binary sketch file
     void Deserialize(const std::string& path) {
+        Update([&](RegistrySnapshot& snapshot) { DeserializeInto(path, snapshot); });
+    }
+
+    // Replaces all registered sketches with the ones in the given directory. The files are decoded in parallel.
+    void SetSketchDirectory(const std::string& path, ThreadPool& thread_pool = ThreadPool::Global());
+
+    // Like SetSketchDirectory, but only indexes the file names and loads each sketch on its first access. Once the
+    // loaded sketches exceed the memory budget (if not 0), the least recently used ones are evicted.
+    void SetLazySketchDirectory(const std::string& path, size_t memory_budget = 0) {
+        auto snapshot = std::make_shared<RegistrySnapshot>();
+        snapshot->directory = std::make_shared<SketchDirectory>(path, memory_budget);
+        Publish(std::move(snapshot));
+    }
+
+    // Loads a single JSON or binary sketch file into the given snapshot
+    static void DeserializeInto(const std::string& path, RegistrySnapshot& snapshot) {
+        if (sketch_file::HasFileExtension(path)) {
+            DeserializeBinaryInto(path, snapshot);
+            return;
+        }
+        auto& sketches = snapshot.sketches;
         nlohmann::json json_obj;
         std::ifstream file;
         file.open(path);
@@ -277,7 +465,8 @@ public:
         if (json_obj["type"] == "rid_sample") {
             std::vector<uint64_t> hashes = json_obj["hashes"];
             auto mhs = std::make_shared<MinHashSketchVector>(hashes, json_obj["max_sample_count"]);
-            rid_sketches[json_obj["table_name"]] = std::make_shared<OmniSketchCell>(mhs, json_obj["record_count"]);
+            snapshot.rid_sketches[json_obj["table_name"]] =
+                std::make_shared<OmniSketchCell>(mhs, json_obj["record_count"]);
             return;
         }
 
@@ -366,60 +555,74 @@ public:
         }
 
         sketch->SetRecordCount(json_obj["record_count"]);
+        const bool has_narrow_samples = json_obj.contains("sample_width") && json_obj["sample_width"] == 32;
+        // Decode the cells straight into the arrays of a flattened sketch
+        const size_t cell_count = sketch->Width() * sketch->Depth();
+        std::vector<uint64_t> record_counts;
+        std::vector<uint64_t> offsets;
+        std::vector<uint64_t> samples;
+        std::vector<uint32_t> narrow_samples;
+        record_counts.reserve(cell_count);
+        offsets.reserve(cell_count + 1);
+        if (has_narrow_samples) {
+            narrow_samples.reserve(cell_count * sketch->MinHashSketchSize());
+        } else {
+            samples.reserve(cell_count * sketch->MinHashSketchSize());
+        }
+        offsets.push_back(0);
         for (size_t i = 0; i < sketch->Depth(); i++) {
-            auto& row = json_obj["rows"][i];
+            const auto& row = json_obj["rows"][i];
             for (size_t j = 0; j < sketch->Width(); j++) {
-                auto& cell_json = row[j];
-                std::vector<uint64_t> hashes = cell_json["hashes"];
-                auto mhs = std::make_shared<MinHashSketchVector>(hashes, cell_json["max_sample_count"]);
-                sketch->SetCell(i, j, std::make_shared<OmniSketchCell>(mhs, cell_json["record_count"]));
-            }
-        }
-    }
-
-    void SetSketchDirectory(const std::string& path) {
-        std::vector<std::string> json_files;
-        DIR* dir = opendir(path.c_str());
-
-        if (dir == nullptr) {
-            std::cerr << "Could not open directory: " << path << std::endl;
-            return;
-        }
-
-        sketches.clear();
-
-        struct dirent* entry;
-        while ((entry = readdir(dir)) != nullptr) {
-            if (entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN) {
-                std::string filename(entry->d_name);
-                if (HasJsonExtension(filename)) {
-                    std::string fullPath = path;
-                    if (fullPath.back() != '/') {
-                        fullPath += '/';
+                const auto& cell_json = row[j];
+                record_counts.push_back(cell_json["record_count"].get<uint64_t>());
+                for (const auto& hash : cell_json["hashes"]) {
+                    if (has_narrow_samples) {
+                        narrow_samples.push_back(MinHashSketchVector32::ToSample(hash.get<uint64_t>()));
+                    } else {
+                        samples.push_back(hash.get<uint64_t>());
                     }
-                    fullPath += filename;
-                    json_files.push_back(fullPath);
                 }
+                offsets.push_back(has_narrow_samples ? narrow_samples.size() : samples.size());
             }
         }
-
-        for (auto& json_file : json_files) {
-            Deserialize(json_file);
+        if (has_narrow_samples) {
+            sketch->SetArena(CellArena::FromArrays(sketch->Width(), sketch->Depth(), sketch->MinHashSketchSize(),
+                                                   std::move(record_counts), std::move(offsets),
+                                                   std::move(narrow_samples)));
+        } else {
+            sketch->SetArena(CellArena::FromArrays(sketch->Width(), sketch->Depth(), sketch->MinHashSketchSize(),
+                                                   std::move(record_counts), std::move(offsets),
+                                                   std::move(samples)));
         }
     }
 
 private:
     Registry();
-    std::unordered_map<std::string, TableEntry> sketches;
-    std::unordered_map<std::string, std::shared_ptr<OmniSketchCell>> rid_sketches;
 
-    bool HasJsonExtension(const std::string& filename) {
-        const std::string extension = ".json";
-        if (filename.length() >= extension.length()) {
-            return (0 == filename.compare(filename.length() - extension.length(), extension.length(), extension));
-        }
-        return false;
+    // Applies update to a copy of the current snapshot and publishes the copy. Updates are serialized, readers are
+    // never blocked.
+    template <class UpdateFunc>
+    void Update(const UpdateFunc& update) {
+        std::lock_guard<std::mutex> guard(update_mutex);
+        auto snapshot = std::make_shared<RegistrySnapshot>(*std::atomic_load(&current_snapshot));
+        update(*snapshot);
+        std::atomic_store(&current_snapshot, std::shared_ptr<const RegistrySnapshot>(std::move(snapshot)));
+    }
+
+    void Publish(std::shared_ptr<const RegistrySnapshot> snapshot) {
+        std::lock_guard<std::mutex> guard(update_mutex);
+        std::atomic_store(&current_snapshot, std::move(snapshot));
     }
+
+    // Maps the file, the cells of the loaded sketch point straight into the mapping
+    static void DeserializeBinaryInto(const std::string& path, RegistrySnapshot& snapshot);
+    // Sketch files do not store the cell mapper, loaded sketches map hashes with BarrettModSplitHashMapper. Throws for
+    // sketches that map them to other columns, before anything is written.
+    static void CheckSerializable(const PointOmniSketch& sketch);
+
+    std::mutex update_mutex;
+    std::shared_ptr<const RegistrySnapshot> current_snapshot;
+    static thread_local std::shared_ptr<const RegistrySnapshot> pinned_snapshot;
 };
 
 }  // namespace omnisketch
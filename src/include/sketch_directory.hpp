@@ -0,0 +1,89 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "omni_sketch/omni_sketch.hpp"
+#include "omni_sketch/sketch_file.hpp"
+
+namespace omnisketch {
+
+// Loads the sketches of a directory on demand. On construction, only the file names and the headers of binary sketch
+// files are indexed. The names have to follow the naming of build_sketches: table__column,
+// table__column__referencing_table, and table__RIDS (with a .json or .omni extension). A sketch is loaded on its first
+// access and stays cached until it is evicted. If a memory budget is set, the least recently used sketches are evicted
+// once the loaded sketches exceed it. Binary sketches are accounted for with their file size, so room is made for them
+// before they are loaded. Evicted sketches stay valid for everyone who still holds them, and are loaded again on their
+// next access. Since that reloads the file, changes made in memory to an evicted sketch (e.g., added or removed
+// records) are lost, so sketches that are modified after loading should be used without a memory budget. Thread-safe.
+class SketchDirectory {
+public:
+    // A memory budget of 0 keeps all loaded sketches
+    explicit SketchDirectory(const std::string& path, size_t memory_budget_p = 0);
+
+    bool HasOmniSketch(const std::string& table_name, const std::string& column_name) const;
+    bool HasTable(const std::string& table_name) const;
+    std::shared_ptr<PointOmniSketch> FindOmniSketch(const std::string& table_name, const std::string& column_name);
+    std::shared_ptr<PointOmniSketch> FindReferencingOmniSketch(const std::string& table_name,
+                                                               const std::string& column_name,
+                                                               const std::string& referencing_table_name);
+    std::shared_ptr<OmniSketchCell> FindRidSample(const std::string& table_name);
+    // The first column of the table (in name order), or an empty string if the table has no sketches
+    std::string FirstColumnName(const std::string& table_name) const;
+    // The header of the binary sketch file of the column, without loading the sketch. Null for JSON files and unknown
+    // columns. Describes the sketch as it was written, so changes to the loaded sketch are not reflected.
+    const sketch_file::SketchInfo* FindFileInfo(const std::string& table_name, const std::string& column_name) const;
+
+    size_t LoadedSketchCount() const;
+    // The estimated size of all currently loaded sketches
+    size_t EstimateByteSize() const;
+    // The size of all indexed binary sketch files, which is about the size of their sketches once they are loaded
+    size_t IndexedByteSize() const;
+
+    // The full paths of all JSON and binary sketch files in the given directory
+    static std::vector<std::string> ListSketchFiles(const std::string& path);
+
+private:
+    struct ColumnFiles {
+        std::string main_path;
+        std::map<std::string, std::string> referencing_paths;
+    };
+
+    struct IndexedFile {
+        sketch_file::SketchInfo info;
+        size_t byte_size = 0;
+    };
+
+    struct LoadedSketch {
+        std::shared_ptr<PointOmniSketch> sketch;
+        std::shared_ptr<OmniSketchCell> rid_sample;
+        size_t byte_size = 0;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    LoadedSketch Load(const std::string& path);
+    // Deserializes the sketch of the file, without touching the cache
+    static LoadedSketch Read(const std::string& path);
+    // Evicts least recently used sketches until reserved_byte_size more bytes fit into the budget
+    void EvictColdSketches(size_t reserved_byte_size = 0);
+
+    size_t memory_budget;
+    // table name -> column name -> files
+    std::map<std::string, std::map<std::string, ColumnFiles>> files;
+    std::unordered_map<std::string, std::string> rid_paths;
+    // Binary sketch files by path
+    std::unordered_map<std::string, IndexedFile> indexed_files;
+
+    mutable std::mutex cache_mutex;
+    std::unordered_map<std::string, LoadedSketch> loaded_sketches;
+    // Paths of the loaded sketches, most recently used first
+    std::list<std::string> lru;
+    size_t loaded_byte_size = 0;
+};
+
+}  // namespace omnisketch
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace omnisketch {
+
+// A field of a CSV line. Points into the mapped file or into the unquoted lines of the CSVReader that read it.
+struct CSVField {
+    bool Empty() const {
+        return size == 0;
+    }
+    std::string ToString() const {
+        return std::string(data, size);
+    }
+
+    const char* data;
+    size_t size;
+};
+
+// Reads a CSV file through a read-only memory mapping. A line ends at a newline that is not escaped by a backslash (an
+// escaped newline and its backslash stay part of the field), and its fields are split like CSVImporter::Split()
+// does, i.e., quotes group separators into a field. Separators, newlines, backslashes and quotes are searched 32 bytes
+// at a time (with AVX2, if the CPU supports it), and the fields of lines without quotes are not copied.
+class CSVReader {
+public:
+    explicit CSVReader(const std::string& path);
+
+    size_t FileSize() const;
+    // Returns the offset of the first logical line that starts at or after offset
+    size_t FindLineStart(size_t offset) const;
+    // Reads the fields of the logical line at position, if position is before end, and moves position to the next line.
+    // An empty line has no fields.
+    bool ReadLine(size_t& position, size_t end, std::vector<CSVField>& fields);
+    // Invalidates the fields of the quoted lines read so far
+    void ClearUnquotedLines();
+
+    // Converts like CSVImporter::ConvertString(), with a fast path for plain decimal numbers
+    template <typename T>
+    static T Parse(const CSVField& field);
+
+private:
+    void SplitQuoted(const char* begin, const char* end, std::vector<CSVField>& fields);
+
+    // Keeps the mapping alive, shared by the copies of the reader
+    std::shared_ptr<const void> mapping;
+    const char* data;
+    size_t size;
+    // Quoted lines without their quotes. A deque does not move its strings, so the fields stay valid.
+    std::deque<std::string> unquoted_lines;
+};
+
+template <>
+std::string CSVReader::Parse<std::string>(const CSVField& field);
+template <>
+int32_t CSVReader::Parse<int32_t>(const CSVField& field);
+template <>
+size_t CSVReader::Parse<size_t>(const CSVField& field);
+template <>
+double CSVReader::Parse<double>(const CSVField& field);
+
+}  // namespace omnisketch
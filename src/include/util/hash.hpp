@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -31,10 +34,41 @@ inline std::pair<uint32_t, uint32_t> SplitHash(const uint64_t hash) {
     return std::make_pair(h1, h2);
 }
 
+// MurmurHash64A (https://github.com/aappleby/smhasher/blob/master/src/MurmurHash2.cpp). With the default seed, it
+// returns the same hashes as std::hash<std::string> in libstdc++, which string sketches used before, so their cell
+// assignments stay the same on every standard library.
+inline uint64_t HashBytes(const char* data, size_t size, uint64_t seed = 0xc70f6907UL) {
+    constexpr uint64_t MULTIPLIER = 0xc6a4a7935bd1e995ULL;
+    constexpr int SHIFT = 47;
+    uint64_t hash = seed ^ (size * MULTIPLIER);
+    const char* end = data + (size & ~size_t(7));
+    for (; data != end; data += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        word *= MULTIPLIER;
+        word ^= word >> SHIFT;
+        word *= MULTIPLIER;
+        hash ^= word;
+        hash *= MULTIPLIER;
+    }
+    if ((size & 7) != 0) {
+        // The remaining bytes in little-endian order
+        uint64_t tail = 0;
+        for (size_t byte_idx = size & 7; byte_idx > 0; byte_idx--) {
+            tail = (tail << 8) | static_cast<unsigned char>(data[byte_idx - 1]);
+        }
+        hash ^= tail;
+        hash *= MULTIPLIER;
+    }
+    hash ^= hash >> SHIFT;
+    hash *= MULTIPLIER;
+    hash ^= hash >> SHIFT;
+    return hash;
+}
+
 template <>
 inline uint64_t Hash(const std::string& value) {
-    static const std::hash<std::string> string_hasher;
-    return string_hasher(value);
+    return HashBytes(value.data(), value.size());
 }
 
 }  // namespace hash_functions
@@ -46,6 +80,16 @@ public:
     virtual ~HashFunction() = default;
     virtual uint64_t Hash(const T& value) const = 0;
     virtual uint64_t HashRid(uint64_t rid) const = 0;
+    virtual void HashValues(const T* values, size_t count, uint64_t* hashes) const {
+        for (size_t value_idx = 0; value_idx < count; value_idx++) {
+            hashes[value_idx] = Hash(values[value_idx]);
+        }
+    }
+    virtual void HashRids(const uint64_t* rids, size_t count, uint64_t* hashes) const {
+        for (size_t rid_idx = 0; rid_idx < count; rid_idx++) {
+            hashes[rid_idx] = HashRid(rids[rid_idx]);
+        }
+    }
 };
 
 template <typename T>
@@ -58,6 +102,18 @@ public:
     uint64_t HashRid(uint64_t rid) const override {
         return hash_functions::MurmurHash64(rid);
     }
+
+    void HashValues(const T* values, size_t count, uint64_t* hashes) const override {
+        for (size_t value_idx = 0; value_idx < count; value_idx++) {
+            hashes[value_idx] = hash_functions::Hash(values[value_idx]);
+        }
+    }
+
+    void HashRids(const uint64_t* rids, size_t count, uint64_t* hashes) const override {
+        for (size_t rid_idx = 0; rid_idx < count; rid_idx++) {
+            hashes[rid_idx] = hash_functions::MurmurHash64(rids[rid_idx]);
+        }
+    }
 };
 
 template <typename T>
@@ -71,21 +127,74 @@ public:
     }
 };
 
+// Computes x % divisor exactly for 32-bit x, with a multiplication and shifts instead of a division (Granlund and
+// Montgomery, "Division by Invariant Integers using Multiplication"). Powers of two are masked.
+class FastModulo32 {
+public:
+    explicit FastModulo32(size_t divisor_p);
+
+    uint32_t Mod(uint32_t x) const {
+        if (multiplier == 0) {
+            return x & mask;
+        }
+        const auto t = static_cast<uint32_t>((static_cast<uint64_t>(x) * multiplier) >> 32);
+        const uint32_t quotient = (t + ((x - t) >> 1)) >> shift;
+        return x - quotient * divisor;
+    }
+
+    uint32_t Divisor() const {
+        return divisor;
+    }
+    // 0 if the modulo is a mask
+    uint32_t Multiplier() const {
+        return multiplier;
+    }
+    uint32_t Shift() const {
+        return shift;
+    }
+    uint32_t Mask() const {
+        return mask;
+    }
+
+private:
+    uint32_t divisor = 0;
+    uint32_t multiplier = 0;
+    uint32_t shift = 0;
+    uint32_t mask = UINT32_MAX;
+};
+
+// Maps value hashes to their column in each row of a sketch. The column is a pure function of the hash and the row,
+// and mappers are immutable after construction, so one mapper can be shared by many sketches and used by concurrent
+// (const) probes without synchronization.
 class CellIdxMapper {
 public:
     virtual ~CellIdxMapper() = default;
-    explicit CellIdxMapper(size_t width_p) : width(width_p), h1(0), h2(0) {
+    explicit CellIdxMapper(size_t width_p) : width(width_p) {
+    }
+    virtual size_t ComputeCellIdx(uint64_t hash, size_t row_idx) const = 0;
+    // Writes the column of the hash in each of the depth rows to col_idxs
+    virtual void ComputeCellIdxs(uint64_t hash, size_t depth, size_t* col_idxs) const {
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            col_idxs[row_idx] = ComputeCellIdx(hash, row_idx);
+        }
+    }
+    // Maps count hashes at once, writing the depth columns of hash i to col_idxs[i * depth, (i + 1) * depth)
+    virtual void ComputeCellIdxs(const uint64_t* hashes, size_t count, size_t depth, size_t* col_idxs) const {
+        for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+            ComputeCellIdxs(hashes[hash_idx], depth, col_idxs + hash_idx * depth);
+        }
     }
-    virtual void SetHash(uint64_t hash) = 0;
-    virtual size_t ComputeCellIdx(size_t row_idx) = 0;
     size_t Width() const {
         return width;
     }
+    // The rows of a hash map into the same block of BlockWidth() adjacent columns (all columns by default), see
+    // BlockedSplitHashMapper
+    virtual size_t BlockWidth() const {
+        return width;
+    }
 
 protected:
-    size_t width;
-    uint32_t h1;
-    uint32_t h2;
+    const size_t width;
 };
 
 class BasicSplitHashMapper : public CellIdxMapper {
@@ -93,29 +202,42 @@ public:
     explicit BasicSplitHashMapper(size_t width_p) : CellIdxMapper(width_p) {
     }
 
-    void SetHash(uint64_t hash) override {
-        h1 = hash;
-        h2 = hash >> 32;
-    }
-
-    size_t ComputeCellIdx(size_t row_idx) override {
+    size_t ComputeCellIdx(uint64_t hash, size_t row_idx) const override {
+        const auto h1 = static_cast<uint32_t>(hash);
+        const auto h2 = static_cast<uint32_t>(hash >> 32);
         return (h1 + row_idx * h2) % width;
     }
 };
 
 class BarrettModSplitHashMapper : public CellIdxMapper {
 public:
-    explicit BarrettModSplitHashMapper(size_t width_p) : CellIdxMapper(width_p) {
+    explicit BarrettModSplitHashMapper(size_t width_p) : CellIdxMapper(width_p), width_modulo(width_p) {
     }
 
-    void SetHash(uint64_t hash) override {
-        h1 = hash;
-        h2 = hash >> 32;
+    size_t ComputeCellIdx(uint64_t hash, size_t row_idx) const override {
+        return MapToColumn(hash, row_idx);
     }
 
-    size_t ComputeCellIdx(size_t row_idx) override {
-        uint32_t combined = h1 + (uint32_t)std::pow(row_idx + 7, 2) * h2;
-        return BarrettReduction(combined) % width;
+    void ComputeCellIdxs(uint64_t hash, size_t depth, size_t* col_idxs) const override {
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            col_idxs[row_idx] = MapToColumn(hash, row_idx);
+        }
+    }
+
+    // Maps eight hashes per instruction with AVX2, if the CPU supports it
+    void ComputeCellIdxs(const uint64_t* hashes, size_t count, size_t depth, size_t* col_idxs) const override;
+
+    // The square of row_idx + 7, as a 32-bit integer
+    static uint32_t RowMultiplier(size_t row_idx) {
+        return static_cast<uint32_t>((row_idx + 7) * (row_idx + 7));
+    }
+
+    // The value of the hash in the row before it is reduced to the width, for sketches whose width is fixed at compile
+    // time (see StaticOmniSketch)
+    static uint32_t RowHash(uint64_t hash, size_t row_idx) {
+        const auto hash_h1 = static_cast<uint32_t>(hash);
+        const auto hash_h2 = static_cast<uint32_t>(hash >> 32);
+        return BarrettReduction(hash_h1 + RowMultiplier(row_idx) * hash_h2);
     }
 
 protected:
@@ -131,20 +253,61 @@ protected:
 
         return remainder;
     }
+
+    size_t MapToColumn(uint64_t hash, size_t row_idx) const {
+        return width_modulo.Mod(RowHash(hash, row_idx));
+    }
+
+    const FastModulo32 width_modulo;
 };
 
-class IdentitySplitMapper : public CellIdxMapper {
+// Maps all rows of a hash into one block of block_width adjacent columns. The hash picks the block, and its row hash
+// (see BarrettModSplitHashMapper::RowHash()) picks the column within the block. A sketch with this mapper lays out its
+// flattened cells block by block (see CellArena), so that the cells of a hash in all rows lie next to each other and a
+// probe touches one region of memory instead of depth distant ones. The width has to be a multiple of the block width,
+// which has to be a power of two. Rows only differ within a block, so hashes that share a block collide in several
+// rows more often than with BarrettModSplitHashMapper, which makes the estimates somewhat less accurate.
+class BlockedSplitHashMapper : public CellIdxMapper {
 public:
-    explicit IdentitySplitMapper(size_t width_p) : CellIdxMapper(width_p) {
+    static constexpr size_t DEFAULT_BLOCK_WIDTH = 8;
+
+    explicit BlockedSplitHashMapper(size_t width_p, size_t block_width_p = DEFAULT_BLOCK_WIDTH);
+
+    size_t ComputeCellIdx(uint64_t hash, size_t row_idx) const override {
+        return BlockBegin(hash) + (BarrettModSplitHashMapper::RowHash(hash, row_idx) & (block_width - 1));
+    }
+
+    void ComputeCellIdxs(uint64_t hash, size_t depth, size_t* col_idxs) const override {
+        const size_t block_begin = BlockBegin(hash);
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            col_idxs[row_idx] = block_begin + (BarrettModSplitHashMapper::RowHash(hash, row_idx) & (block_width - 1));
+        }
+    }
+
+    size_t BlockWidth() const override {
+        return block_width;
     }
 
-    void SetHash(uint64_t value) override {
-        uint64_t hash = hash_functions::Hash(value);
-        h1 = hash;
-        h2 = hash >> 32;
+private:
+    // Scales the upper half of the remixed hash to the block count, since the row hashes are based on the plain hash
+    size_t BlockBegin(uint64_t hash) const {
+        const uint64_t mixed = (hash * 0x9e3779b97f4a7c15U) >> 32;
+        return static_cast<size_t>((mixed * block_count) >> 32) * block_width;
+    }
+
+    const size_t block_width;
+    const uint64_t block_count;
+};
+
+class IdentitySplitMapper : public CellIdxMapper {
+public:
+    explicit IdentitySplitMapper(size_t width_p) : CellIdxMapper(width_p) {
     }
 
-    size_t ComputeCellIdx(size_t row_idx) override {
+    size_t ComputeCellIdx(uint64_t value, size_t row_idx) const override {
+        const uint64_t hash = hash_functions::Hash(value);
+        const auto h1 = static_cast<uint32_t>(hash);
+        const auto h2 = static_cast<uint32_t>(hash >> 32);
         return (h1 + row_idx * h2) % width;
     }
 };
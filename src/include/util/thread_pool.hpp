@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace omnisketch {
+
+// Fixed set of worker threads that execute index-parallel loops. The calling thread takes part in its own loops, so
+// a pool without workers runs everything serially and nested loops cannot deadlock.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t worker_count);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t WorkerCount() const {
+        return workers.size();
+    }
+
+    // Runs task(0), ..., task(task_count - 1) and returns once all of them have finished. Rethrows the first exception
+    // that a task threw.
+    void ParallelFor(size_t task_count, const std::function<void(size_t)>& task);
+
+    // Shared pool with a worker for every hardware thread besides the calling one
+    static ThreadPool& Global();
+
+private:
+    struct Job;
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::deque<std::shared_ptr<Job>> jobs;
+    bool stopping = false;
+};
+
+}  // namespace omnisketch
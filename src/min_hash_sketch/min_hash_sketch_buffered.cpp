@@ -0,0 +1,124 @@
+#include "min_hash_sketch/min_hash_sketch_buffered.hpp"
+
+#include "min_hash_sketch/min_hash_sketch_vector.hpp"
+
+namespace omnisketch {
+
+MinHashSketchBuffered::MinHashSketchBuffered(size_t max_count_p) : max_count(max_count_p) {
+    data.reserve(max_count);
+    buffer.reserve(max_count);
+    if (max_count == 0) {
+        threshold = 0;
+    }
+}
+
+void MinHashSketchBuffered::Compact() const {
+    if (buffer.empty()) {
+        return;
+    }
+    std::sort(buffer.begin(), buffer.end());
+
+    merge_buffer.resize(data.size() + buffer.size());
+    auto merge_end = std::merge(data.cbegin(), data.cend(), buffer.cbegin(), buffer.cend(), merge_buffer.begin());
+    merge_end = std::unique(merge_buffer.begin(), merge_end);
+    merge_buffer.resize(std::min(static_cast<size_t>(merge_end - merge_buffer.begin()), max_count));
+    data.swap(merge_buffer);
+    buffer.clear();
+
+    if (data.size() == max_count && !data.empty()) {
+        threshold = data.back();
+    }
+}
+
+size_t MinHashSketchBuffered::Size() const {
+    Compact();
+    return data.size();
+}
+
+size_t MinHashSketchBuffered::MaxCount() const {
+    return max_count;
+}
+
+void MinHashSketchBuffered::Combine(const MinHashSketch& other) {
+    for (auto it = other.Iterator(); !it->IsAtEnd(); it->Next()) {
+        const uint64_t hash = it->Current();
+        if (hash >= threshold && data.size() == max_count) {
+            // The other sketch is sorted, so none of its remaining hashes can be accepted either
+            return;
+        }
+        AddRecord(hash);
+    }
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchBuffered::Resize(size_t size) const {
+    Compact();
+    auto result = std::make_shared<MinHashSketchBuffered>(size);
+    result->buffer.assign(data.cbegin(), data.cbegin() + std::min(size, data.size()));
+    result->Compact();
+    return result;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchBuffered::Flatten() const {
+    Compact();
+    return std::make_shared<MinHashSketchVector>(data, max_count);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchBuffered::Intersect(
+    const std::vector<std::shared_ptr<MinHashSketch>>& sketches, size_t max_sample_count) {
+    return MinHashSketchVector::ComputeIntersection(sketches, nullptr, max_sample_count);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchBuffered::Combine(
+    const std::vector<std::shared_ptr<MinHashSketch>>& others) const {
+    auto result = Copy();
+    for (const auto& other : others) {
+        result->Combine(*other);
+    }
+    return result;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchBuffered::Copy() const {
+    Compact();
+    auto result = std::make_shared<MinHashSketchBuffered>(max_count);
+    result->data = data;
+    result->threshold = threshold;
+    return result;
+}
+
+size_t MinHashSketchBuffered::EstimateByteSize() const {
+    const size_t max_count_size = sizeof(size_t);
+    const size_t vector_overhead = 3 * sizeof(std::vector<uint64_t>);
+    const size_t per_item_size = sizeof(uint64_t);
+    return max_count_size + vector_overhead + Size() * per_item_size;
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchBuffered::Iterator() const {
+    Compact();
+    return std::make_unique<SketchIterator>(data.data(), data.size());
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchBuffered::Iterator(size_t max_sample_count) const {
+    Compact();
+    return std::make_unique<SketchIterator>(data.data(), std::min(data.size(), max_sample_count));
+}
+
+MinHashSketchBuffered::SketchIterator MinHashSketchBuffered::TypedIterator(size_t max_sample_count) const {
+    Compact();
+    return SketchIterator(data.data(), std::min(data.size(), max_sample_count));
+}
+
+const std::vector<uint64_t>& MinHashSketchBuffered::Data() const {
+    Compact();
+    return data;
+}
+
+void MinHashSketchBuffered::EraseRecord(uint64_t hash) {
+    Compact();
+    auto it = std::lower_bound(data.begin(), data.end(), hash);
+    if (it != data.end() && *it == hash) {
+        data.erase(it);
+        threshold = std::numeric_limits<uint64_t>::max();
+    }
+}
+
+}  // namespace omnisketch
@@ -0,0 +1,259 @@
+#include "min_hash_sketch/min_hash_sketch_compressed.hpp"
+
+#include "min_hash_sketch/min_hash_sketch_vector.hpp"
+
+namespace omnisketch {
+
+constexpr size_t MinHashSketchCompressed::BLOCK_SIZE;
+
+static_assert(sizeof(MinHashSketchCompressed::Block) == 3 * sizeof(uint64_t), "blocks are stored as-is in files");
+
+MinHashSketchCompressed::SketchIterator::SketchIterator(const Block* blocks_p, const uint64_t* words_p, size_t size_p,
+                                                        size_t value_count_p)
+    : blocks(blocks_p), words(words_p), size(size_p), offset(0), value_count(value_count_p) {
+    if (value_count > 0) {
+        DecodeBlock(0);
+    }
+}
+
+void MinHashSketchCompressed::SketchIterator::DecodeBlock(size_t block_idx) {
+    const Block& block = blocks[block_idx];
+    const size_t count = std::min(BLOCK_SIZE, size - block_idx * BLOCK_SIZE);
+    const uint64_t* block_words = words + block.word_offset;
+    const uint32_t bit_width = block.bit_width;
+    const uint64_t mask = bit_width == 64 ? ~uint64_t(0) : (uint64_t(1) << bit_width) - 1;
+
+    decoded[0] = block.first;
+    size_t bit_position = 0;
+    for (size_t hash_idx = 1; hash_idx < count; hash_idx++) {
+        const size_t word_idx = bit_position / 64;
+        const size_t bit_offset = bit_position % 64;
+        uint64_t delta = block_words[word_idx] >> bit_offset;
+        if (bit_offset + bit_width > 64) {
+            delta |= block_words[word_idx + 1] << (64 - bit_offset);
+        }
+        decoded[hash_idx] = decoded[hash_idx - 1] + (delta & mask);
+        bit_position += bit_width;
+    }
+}
+
+void MinHashSketchCompressed::SketchIterator::SeekGE(uint64_t hash) {
+    if (IsAtEnd() || Current() >= hash) {
+        return;
+    }
+    size_t block_idx = offset / BLOCK_SIZE;
+    if (blocks[block_idx].last < hash) {
+        const size_t block_count = BlockCount(value_count);
+        do {
+            block_idx++;
+        } while (block_idx < block_count && blocks[block_idx].last < hash);
+        if (block_idx == block_count) {
+            offset = value_count;
+            return;
+        }
+        offset = block_idx * BLOCK_SIZE;
+        DecodeBlock(block_idx);
+    }
+
+    const size_t block_begin = block_idx * BLOCK_SIZE;
+    const size_t block_end = std::min(block_begin + BLOCK_SIZE, value_count);
+    const uint64_t* position =
+        std::lower_bound(decoded + (offset - block_begin), decoded + (block_end - block_begin), hash);
+    offset = block_begin + static_cast<size_t>(position - decoded);
+    if (offset == block_end && offset < value_count) {
+        DecodeBlock(block_idx + 1);
+    }
+}
+
+MinHashSketchCompressed::MinHashSketchCompressed(const uint64_t* hashes, size_t size_p, size_t max_count_p)
+    : size(size_p), max_count(max_count_p) {
+    Encode(hashes, size, owned_blocks, owned_words);
+    blocks = owned_blocks.data();
+    words = owned_words.data();
+}
+
+MinHashSketchCompressed::MinHashSketchCompressed(const Block* blocks_p, const uint64_t* words_p, size_t size_p,
+                                                 size_t max_count_p, std::shared_ptr<const void> owner_p)
+    : blocks(blocks_p), words(words_p), size(size_p), max_count(max_count_p), owner(std::move(owner_p)) {
+}
+
+std::shared_ptr<MinHashSketchCompressed> MinHashSketchCompressed::Compress(const MinHashSketch& sketch) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(sketch.Size());
+    for (auto it = sketch.Iterator(); !it->IsAtEnd(); it->Next()) {
+        hashes.push_back(it->Current());
+    }
+    return std::make_shared<MinHashSketchCompressed>(hashes.data(), hashes.size(), sketch.MaxCount());
+}
+
+void MinHashSketchCompressed::Encode(const uint64_t* hashes, size_t count, std::vector<Block>& blocks,
+                                     std::vector<uint64_t>& words) {
+    const size_t words_begin = words.size();
+    blocks.reserve(blocks.size() + BlockCount(count));
+    for (size_t block_begin = 0; block_begin < count; block_begin += BLOCK_SIZE) {
+        const size_t block_end = std::min(block_begin + BLOCK_SIZE, count);
+        uint64_t max_delta = 0;
+        for (size_t hash_idx = block_begin + 1; hash_idx < block_end; hash_idx++) {
+            assert(hashes[hash_idx] > hashes[hash_idx - 1]);
+            max_delta = std::max(max_delta, hashes[hash_idx] - hashes[hash_idx - 1]);
+        }
+        const uint32_t bit_width = max_delta == 0 ? 0 : 64 - static_cast<uint32_t>(__builtin_clzll(max_delta));
+        blocks.push_back(Block{hashes[block_begin], hashes[block_end - 1],
+                               static_cast<uint32_t>(words.size() - words_begin), bit_width});
+
+        const size_t first_word = words.size();
+        words.resize(first_word + ((block_end - block_begin - 1) * bit_width + 63) / 64, 0);
+        size_t bit_position = 0;
+        for (size_t hash_idx = block_begin + 1; hash_idx < block_end; hash_idx++) {
+            const uint64_t delta = hashes[hash_idx] - hashes[hash_idx - 1];
+            const size_t word_idx = first_word + bit_position / 64;
+            const size_t bit_offset = bit_position % 64;
+            words[word_idx] |= delta << bit_offset;
+            if (bit_offset + bit_width > 64) {
+                words[word_idx + 1] |= delta >> (64 - bit_offset);
+            }
+            bit_position += bit_width;
+        }
+    }
+}
+
+void MinHashSketchCompressed::IntersectCompressed(const std::vector<const MinHashSketchCompressed*>& sketches,
+                                                  size_t max_sample_count, std::vector<uint64_t>& result) {
+    assert(!sketches.empty());
+    std::vector<SketchIterator> offsets;
+    offsets.reserve(sketches.size());
+    for (const auto* sketch : sketches) {
+        offsets.push_back(sketch->TypedIterator(max_sample_count));
+        if (offsets.back().IsAtEnd()) {
+            return;
+        }
+    }
+
+    // Leapfrog: every iterator in turn seeks to the largest hash seen so far, until all of them agree on it
+    uint64_t target = offsets[0].Current();
+    size_t agreeing_count = 1;
+    for (size_t sketch_idx = 1 % offsets.size();; sketch_idx = (sketch_idx + 1) % offsets.size()) {
+        auto& it = offsets[sketch_idx];
+        it.SeekGE(target);
+        if (it.IsAtEnd()) {
+            return;
+        }
+        if (it.Current() == target && ++agreeing_count < offsets.size()) {
+            continue;
+        }
+        if (it.Current() == target) {
+            result.push_back(target);
+            it.Next();
+            if (it.IsAtEnd()) {
+                return;
+            }
+        }
+        target = it.Current();
+        agreeing_count = 1;
+    }
+}
+
+void MinHashSketchCompressed::AddRecord(uint64_t) {
+    throw std::logic_error("MinHashSketchCompressed is read-only.");
+}
+
+void MinHashSketchCompressed::EraseRecord(uint64_t) {
+    throw std::logic_error("MinHashSketchCompressed is read-only.");
+}
+
+size_t MinHashSketchCompressed::Size() const {
+    return size;
+}
+
+size_t MinHashSketchCompressed::MaxCount() const {
+    return max_count;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchCompressed::Resize(size_t size_p) const {
+    std::vector<uint64_t> result;
+    result.reserve(std::min(size, size_p));
+    for (auto it = TypedIterator(size_p); !it.IsAtEnd(); it.Next()) {
+        result.push_back(it.Current());
+    }
+    return std::make_shared<MinHashSketchVector>(std::move(result), size_p);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchCompressed::Flatten() const {
+    return Resize(max_count);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchCompressed::Intersect(
+    const std::vector<std::shared_ptr<MinHashSketch>>& sketches, size_t max_sample_count) {
+    std::vector<const MinHashSketchCompressed*> compressed_sketches;
+    compressed_sketches.reserve(sketches.size());
+    for (const auto& sketch : sketches) {
+        auto compressed_sketch = dynamic_cast<const MinHashSketchCompressed*>(sketch.get());
+        if (!compressed_sketch) {
+            return MinHashSketchVector::ComputeIntersection(sketches, nullptr, max_sample_count);
+        }
+        compressed_sketches.push_back(compressed_sketch);
+    }
+
+    if (max_sample_count == 0) {
+        max_sample_count = UINT64_MAX;
+        for (const auto& sketch : sketches) {
+            max_sample_count = std::min(max_sample_count, sketch->MaxCount());
+        }
+    }
+    auto result = std::make_shared<MinHashSketchVector>(max_sample_count);
+    IntersectCompressed(compressed_sketches, max_sample_count, result->Data());
+    return result;
+}
+
+void MinHashSketchCompressed::Combine(const MinHashSketch&) {
+    throw std::logic_error("MinHashSketchCompressed is read-only.");
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchCompressed::Combine(
+    const std::vector<std::shared_ptr<MinHashSketch>>& others) const {
+    auto result = Flatten();
+    for (const auto& other : others) {
+        result->Combine(*other);
+    }
+    return result;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchCompressed::Copy() const {
+    return Flatten();
+}
+
+size_t MinHashSketchCompressed::EstimateByteSize() const {
+    return sizeof(MinHashSketchCompressed) + BlockCount(size) * sizeof(Block) + WordCount() * sizeof(uint64_t);
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchCompressed::Iterator() const {
+    return std::make_unique<SketchIterator>(blocks, words, size, size);
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchCompressed::Iterator(size_t max_sample_count) const {
+    return std::make_unique<SketchIterator>(blocks, words, size, std::min(size, max_sample_count));
+}
+
+MinHashSketchCompressed::SketchIterator MinHashSketchCompressed::TypedIterator(size_t max_sample_count) const {
+    return SketchIterator(blocks, words, size, std::min(size, max_sample_count));
+}
+
+const MinHashSketchCompressed::Block* MinHashSketchCompressed::Blocks() const {
+    return blocks;
+}
+
+const uint64_t* MinHashSketchCompressed::Words() const {
+    return words;
+}
+
+size_t MinHashSketchCompressed::WordCount() const {
+    const size_t block_count = BlockCount(size);
+    if (block_count == 0) {
+        return 0;
+    }
+    const Block& last_block = blocks[block_count - 1];
+    const size_t last_block_size = size - (block_count - 1) * BLOCK_SIZE;
+    return last_block.word_offset + ((last_block_size - 1) * last_block.bit_width + 63) / 64;
+}
+
+}  // namespace omnisketch
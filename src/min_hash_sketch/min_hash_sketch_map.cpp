@@ -2,6 +2,10 @@
 
 #include "min_hash_sketch/min_hash_sketch_vector.hpp"
 
+#include <functional>
+#include <queue>
+#include <tuple>
+
 namespace omnisketch {
 
 void MinHashSketchMap::AddRecord(uint64_t hash, uint64_t value) {
@@ -98,6 +102,10 @@ std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchMap::Iterator(size_t
     return std::make_unique<MinHashSketchMap::SketchIterator>(data.cbegin(), std::min(data.size(), max_sample_count));
 }
 
+MinHashSketchMap::SketchIterator MinHashSketchMap::TypedIterator(size_t max_sample_count) const {
+    return SketchIterator(data.cbegin(), std::min(data.size(), max_sample_count));
+}
+
 std::map<uint64_t, uint64_t>& MinHashSketchMap::Data() {
     return data;
 }
@@ -110,6 +118,41 @@ void MinHashSketchMap::EraseRecord(uint64_t hash) {
     data.erase(hash);
 }
 
+std::shared_ptr<MinHashSketchMap> MinHashSketchMap::FromSortedRuns(
+    const std::vector<std::vector<std::pair<uint64_t, uint64_t>>>& runs, size_t max_count) {
+    auto result = std::make_shared<MinHashSketchMap>(max_count);
+    auto& result_data = result->data;
+
+    // Heap of (hash, run index, offset in run), so equal hashes are popped in run order
+    using Cursor = std::tuple<uint64_t, size_t, size_t>;
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+    for (size_t run_idx = 0; run_idx < runs.size(); run_idx++) {
+        if (!runs[run_idx].empty()) {
+            heap.emplace(runs[run_idx].front().first, run_idx, 0);
+        }
+    }
+
+    while (!heap.empty()) {
+        const auto cursor = heap.top();
+        heap.pop();
+        const auto& run = runs[std::get<1>(cursor)];
+        const size_t offset = std::get<2>(cursor);
+        if (result_data.size() == max_count) {
+            // No remaining hash is smaller than the largest one in the map
+            break;
+        }
+        if (!result_data.empty() && std::prev(result_data.end())->first == run[offset].first) {
+            std::prev(result_data.end())->second = run[offset].second;
+        } else {
+            result_data.emplace_hint(result_data.end(), run[offset]);
+        }
+        if (offset + 1 < run.size()) {
+            heap.emplace(run[offset + 1].first, std::get<1>(cursor), offset + 1);
+        }
+    }
+    return result;
+}
+
 std::shared_ptr<MinHashSketchMap> MinHashSketchMap::IntersectMap(std::vector<std::shared_ptr<MinHashSketch>>& sketches,
                                                                  size_t n_max, size_t max_sample_size) {
     std::vector<std::unique_ptr<MinHashSketch::SketchIterator>> offsets;
@@ -128,6 +128,10 @@ std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchSet::Iterator(size_t
     return std::make_unique<SketchIterator>(data.begin(), std::min(data.size(), max_sample_count));
 }
 
+MinHashSketchSet::SketchIterator MinHashSketchSet::TypedIterator(size_t max_sample_count) const {
+    return SketchIterator(data.begin(), std::min(data.size(), max_sample_count));
+}
+
 std::set<uint64_t>& MinHashSketchSet::Data() {
     return data;
 }
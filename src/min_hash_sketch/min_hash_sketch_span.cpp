@@ -0,0 +1,81 @@
+#include "min_hash_sketch/min_hash_sketch_span.hpp"
+
+#include "min_hash_sketch/min_hash_sketch_vector.hpp"
+
+namespace omnisketch {
+
+void MinHashSketchSpan::AddRecord(uint64_t) {
+    throw std::logic_error("MinHashSketchSpan is read-only.");
+}
+
+void MinHashSketchSpan::EraseRecord(uint64_t) {
+    throw std::logic_error("MinHashSketchSpan is read-only.");
+}
+
+size_t MinHashSketchSpan::Size() const {
+    return size;
+}
+
+size_t MinHashSketchSpan::MaxCount() const {
+    return max_count;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchSpan::Resize(size_t size_p) const {
+    std::vector<uint64_t> result(data, data + std::min(size, size_p));
+    return std::make_shared<MinHashSketchVector>(std::move(result), size_p);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchSpan::Flatten() const {
+    return std::make_shared<MinHashSketchVector>(std::vector<uint64_t>(data, data + size), max_count);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchSpan::Intersect(const std::vector<std::shared_ptr<MinHashSketch>>& sketches,
+                                                            size_t max_sample_count) {
+    return MinHashSketchVector::ComputeIntersection(sketches, nullptr, max_sample_count);
+}
+
+void MinHashSketchSpan::Combine(const MinHashSketch&) {
+    throw std::logic_error("MinHashSketchSpan is read-only.");
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchSpan::Combine(
+    const std::vector<std::shared_ptr<MinHashSketch>>& others) const {
+    auto result = Flatten();
+    for (const auto& other : others) {
+        result->Combine(*other);
+    }
+    return result;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchSpan::Copy() const {
+    return Flatten();
+}
+
+size_t MinHashSketchSpan::EstimateByteSize() const {
+    // The hashes are accounted for by the owner
+    return sizeof(MinHashSketchSpan);
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchSpan::Iterator() const {
+    return std::make_unique<SketchIterator>(data, size);
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchSpan::Iterator(size_t max_sample_count) const {
+    return std::make_unique<SketchIterator>(data, std::min(size, max_sample_count));
+}
+
+MinHashSketchSpan::SketchIterator MinHashSketchSpan::TypedIterator(size_t max_sample_count) const {
+    return SketchIterator(data, std::min(size, max_sample_count));
+}
+
+const uint64_t* MinHashSketchSpan::Data() const {
+    return data;
+}
+
+void MinHashSketchSpan::IntersectSorted(const std::vector<const uint64_t*>& offsets,
+                                        const std::vector<const uint64_t*>& ends, std::vector<uint64_t>& result,
+                                        IntersectionStrategy strategy) {
+    sorted_intersection::IntersectMany(offsets, ends, result, strategy);
+}
+
+}  // namespace omnisketch
@@ -1,5 +1,12 @@
 #include "min_hash_sketch/min_hash_sketch_vector.hpp"
 
+#include "min_hash_sketch/min_hash_sketch_buffered.hpp"
+#include "min_hash_sketch/min_hash_sketch_intersection.hpp"
+#include "min_hash_sketch/min_hash_sketch_map.hpp"
+#include "min_hash_sketch/min_hash_sketch_set.hpp"
+#include "min_hash_sketch/min_hash_sketch_span.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
+
 namespace omnisketch {
 
 void MinHashSketchVector::AddRecord(uint64_t hash) {
@@ -108,6 +115,10 @@ std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchVector::Iterator(siz
     return std::make_unique<SketchIterator>(data.begin(), validity.get(), std::min(max_sample_count, data.size()));
 }
 
+MinHashSketchVector::SketchIterator MinHashSketchVector::TypedIterator(size_t max_sample_count) const {
+    return SketchIterator(data.begin(), validity.get(), std::min(max_sample_count, data.size()));
+}
+
 std::vector<uint64_t>& MinHashSketchVector::Data() {
     return data;
 }
@@ -116,9 +127,23 @@ const std::vector<uint64_t>& MinHashSketchVector::Data() const {
     return data;
 }
 
+const ValidityMask* MinHashSketchVector::Validity() const {
+    return validity.get();
+}
+
 void MinHashSketchVector::EraseRecord(uint64_t hash) {
-    assert(validity);
-    validity->SetInvalid(std::lower_bound(data.begin(), data.end(), hash) - data.begin());
+    const auto position = std::lower_bound(data.begin(), data.end(), hash);
+    if (position == data.end() || *position != hash) {
+        return;
+    }
+    if (validity) {
+        // Invalidating a sample twice would count it twice
+        if (validity->IsValid(position - data.begin())) {
+            validity->SetInvalid(position - data.begin());
+        }
+    } else {
+        data.erase(position);
+    }
 }
 void MinHashSketchVector::ShrinkToFit() {
     if (!validity) {
@@ -146,10 +171,130 @@ inline void set_invalid(ValidityMask* mask, size_t i) {
 inline void do_nothing(ValidityMask*, size_t) {
 }
 
+namespace {
+
+// Spans, vectors and buffered sketches are plain sorted arrays, which we intersect with the (SIMD) sorted_intersection
+// kernels. Only the first input may have erased entries; they are filtered out afterwards.
+bool IntersectContiguous(const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask,
+                         size_t max_sample_size, IntersectionStrategy strategy, std::vector<uint64_t>& result) {
+    std::vector<const uint64_t*> offsets;
+    std::vector<const uint64_t*> ends;
+    offsets.reserve(sketches.size());
+    ends.reserve(sketches.size());
+    const ValidityMask* first_validity = nullptr;
+    for (const auto& sketch : sketches) {
+        if (auto span = dynamic_cast<const MinHashSketchSpan*>(sketch.get())) {
+            offsets.push_back(span->Data());
+            ends.push_back(span->Data() + std::min(span->Size(), max_sample_size));
+            continue;
+        }
+        if (auto buffered = dynamic_cast<const MinHashSketchBuffered*>(sketch.get())) {
+            const auto& data = buffered->Data();
+            offsets.push_back(data.data());
+            ends.push_back(data.data() + std::min(data.size(), max_sample_size));
+            continue;
+        }
+        auto vector = dynamic_cast<const MinHashSketchVector*>(sketch.get());
+        if (!vector) {
+            return false;
+        }
+        if (vector->Size() != vector->Data().size()) {
+            if (!offsets.empty()) {
+                return false;
+            }
+            first_validity = vector->Validity();
+        }
+        offsets.push_back(vector->Data().data());
+        ends.push_back(vector->Data().data() + std::min(vector->Data().size(), max_sample_size));
+    }
+
+    const size_t result_offset = result.size();
+    sorted_intersection::IntersectMany(offsets, ends, result, strategy);
+    if (!first_validity && !mask) {
+        return true;
+    }
+
+    // Map the matches back to their positions in the first input
+    size_t match_count = 0;
+    const uint64_t* position = offsets[0];
+    for (size_t result_idx = result_offset; result_idx < result.size(); result_idx++) {
+        const uint64_t hash = result[result_idx];
+        position = std::lower_bound(position, ends[0], hash);
+        const auto position_idx = static_cast<size_t>(position - offsets[0]);
+        if (first_validity && !first_validity->IsValid(position_idx)) {
+            continue;
+        }
+        if (mask) {
+            mask->SetInvalid(position_idx);
+        }
+        result[result_offset + match_count++] = hash;
+    }
+    result.resize(result_offset + match_count);
+    return true;
+}
+
+template <class Sketch>
+bool IntersectHomogeneous(const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask,
+                          size_t max_sample_size, std::vector<uint64_t>& result) {
+    std::vector<typename Sketch::SketchIterator> offsets;
+    offsets.reserve(sketches.size());
+    for (const auto& sketch : sketches) {
+        auto typed_sketch = dynamic_cast<const Sketch*>(sketch.get());
+        if (!typed_sketch) {
+            return false;
+        }
+        offsets.push_back(typed_sketch->TypedIterator(max_sample_size));
+    }
+    IntersectIterators(offsets, mask, result);
+    return true;
+}
+
+template <class LeftSketch, class RightSketch>
+bool IntersectPair(const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask,
+                   size_t max_sample_size, std::vector<uint64_t>& result) {
+    auto left_sketch = dynamic_cast<const LeftSketch*>(sketches[0].get());
+    auto right_sketch = dynamic_cast<const RightSketch*>(sketches[1].get());
+    if (!left_sketch || !right_sketch) {
+        return false;
+    }
+    auto left = left_sketch->TypedIterator(max_sample_size);
+    auto right = right_sketch->TypedIterator(max_sample_size);
+    IntersectIteratorPair(left, right, mask, result);
+    return true;
+}
+
+// Picks a statically dispatched kernel for the concrete sketch types. Returns false if there is none.
+bool IntersectTyped(const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask,
+                    size_t max_sample_size, IntersectionStrategy strategy, std::vector<uint64_t>& result) {
+    if (IntersectContiguous(sketches, mask, max_sample_size, strategy, result) ||
+        IntersectHomogeneous<MinHashSketchVector>(sketches, mask, max_sample_size, result) ||
+        IntersectHomogeneous<MinHashSketchSet>(sketches, mask, max_sample_size, result) ||
+        IntersectHomogeneous<MinHashSketchMap>(sketches, mask, max_sample_size, result)) {
+        return true;
+    }
+    if (sketches.size() != 2) {
+        return false;
+    }
+    return IntersectPair<MinHashSketchVector, MinHashSketchMap>(sketches, mask, max_sample_size, result) ||
+           IntersectPair<MinHashSketchMap, MinHashSketchVector>(sketches, mask, max_sample_size, result) ||
+           IntersectPair<MinHashSketchSet, MinHashSketchVector>(sketches, mask, max_sample_size, result) ||
+           IntersectPair<MinHashSketchVector, MinHashSketchSet>(sketches, mask, max_sample_size, result);
+}
+
+}  // namespace
+
 std::shared_ptr<MinHashSketch> MinHashSketchVector::ComputeIntersection(
-    const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask, size_t max_sample_size) {
+    const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask, size_t max_sample_size,
+    IntersectionStrategy strategy) {
     assert(!sketches.empty() && "Sketch vector to intersect must not be empty.");
 
+    // Samples of different widths only compare after truncating all of them
+    for (const auto& sketch : sketches) {
+        if (dynamic_cast<const MinHashSketchVector32*>(sketch.get())) {
+            return MinHashSketchVector32::ComputeIntersection(sketches, mask, max_sample_size, strategy);
+        }
+    }
+
     ValiditySetter setter = mask ? set_invalid : do_nothing;
 
     if (max_sample_size == 0) {
@@ -159,6 +304,15 @@ std::shared_ptr<MinHashSketch> MinHashSketchVector::ComputeIntersection(
         }
     }
 
+    auto result =
+        std::make_shared<MinHashSketchVector>(max_sample_size, std::make_unique<ValidityMask>(max_sample_size));
+    auto& result_data = result->Data();
+
+    if (IntersectTyped(sketches, mask, max_sample_size, strategy, result_data)) {
+        return result;
+    }
+
+    // Fall back to virtual iterators for all other combinations
     std::vector<std::unique_ptr<MinHashSketch::SketchIterator>> offsets;
     offsets.reserve(sketches.size());
 
@@ -166,10 +320,6 @@ std::shared_ptr<MinHashSketch> MinHashSketchVector::ComputeIntersection(
         offsets.push_back(sketch->Iterator(max_sample_size));
     }
 
-    auto result =
-        std::make_shared<MinHashSketchVector>(max_sample_size, std::make_unique<ValidityMask>(max_sample_size));
-    auto& result_data = result->Data();
-
     while (!offsets[0]->IsAtEnd()) {
         uint64_t current_hash = offsets[0]->Current();
 
@@ -0,0 +1,154 @@
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
+
+namespace omnisketch {
+
+void MinHashSketchVector32::AddRecord(uint64_t hash) {
+    const uint32_t sample = ToSample(hash);
+    if (data.size() == max_count && (max_count == 0 || sample >= data.back())) {
+        return;
+    }
+    const auto position = std::lower_bound(data.begin(), data.end(), sample);
+    if (position != data.end() && *position == sample) {
+        return;
+    }
+    data.insert(position, sample);
+    if (data.size() > max_count) {
+        data.pop_back();
+    }
+}
+
+void MinHashSketchVector32::EraseRecord(uint64_t hash) {
+    const uint32_t sample = ToSample(hash);
+    const auto position = std::lower_bound(data.begin(), data.end(), sample);
+    if (position != data.end() && *position == sample) {
+        data.erase(position);
+    }
+}
+
+size_t MinHashSketchVector32::Size() const {
+    return data.size();
+}
+
+size_t MinHashSketchVector32::MaxCount() const {
+    return max_count;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchVector32::Resize(size_t size) const {
+    std::vector<uint32_t> result(data.cbegin(), data.cbegin() + std::min(size, data.size()));
+    return std::make_shared<MinHashSketchVector32>(std::move(result), size);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchVector32::Flatten() const {
+    return std::make_shared<MinHashSketchVector32>(data, max_count);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchVector32::Intersect(
+    const std::vector<std::shared_ptr<MinHashSketch>>& sketches, size_t max_sample_count) {
+    return ComputeIntersection(sketches, nullptr, max_sample_count);
+}
+
+void MinHashSketchVector32::Combine(const MinHashSketch& other) {
+    std::vector<uint32_t> other_samples;
+    other_samples.reserve(other.Size());
+    for (auto it = other.Iterator(); !it->IsAtEnd(); it->Next()) {
+        const uint32_t sample = ToSample(it->Current());
+        if (other_samples.empty() || other_samples.back() != sample) {
+            other_samples.push_back(sample);
+        }
+    }
+
+    std::vector<uint32_t> result(data.size() + other_samples.size());
+    const auto result_end =
+        std::set_union(data.cbegin(), data.cend(), other_samples.cbegin(), other_samples.cend(), result.begin());
+    result.resize(std::min(static_cast<size_t>(result_end - result.begin()), max_count));
+    data = std::move(result);
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchVector32::Combine(
+    const std::vector<std::shared_ptr<MinHashSketch>>& others) const {
+    auto result = std::make_shared<MinHashSketchVector32>(data, max_count);
+    for (const auto& other : others) {
+        result->Combine(*other);
+    }
+    return result;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchVector32::Copy() const {
+    return Flatten();
+}
+
+size_t MinHashSketchVector32::EstimateByteSize() const {
+    return sizeof(size_t) + sizeof(std::vector<uint32_t>) + data.size() * sizeof(uint32_t);
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchVector32::Iterator() const {
+    return std::make_unique<SketchIterator>(data.data(), data.size());
+}
+
+std::unique_ptr<MinHashSketch::SketchIterator> MinHashSketchVector32::Iterator(size_t max_sample_count) const {
+    return std::make_unique<SketchIterator>(data.data(), std::min(data.size(), max_sample_count));
+}
+
+MinHashSketchVector32::SketchIterator MinHashSketchVector32::TypedIterator(size_t max_sample_count) const {
+    return SketchIterator(data.data(), std::min(data.size(), max_sample_count));
+}
+
+const std::vector<uint32_t>& MinHashSketchVector32::Data() const {
+    return data;
+}
+
+std::shared_ptr<MinHashSketch> MinHashSketchVector32::ComputeIntersection(
+    const std::vector<std::shared_ptr<MinHashSketch>>& sketches, ValidityMask* mask, size_t max_sample_size,
+    IntersectionStrategy strategy) {
+    assert(!sketches.empty() && "Sketch vector to intersect must not be empty.");
+
+    if (max_sample_size == 0) {
+        max_sample_size = UINT64_MAX;
+        for (const auto& sketch : sketches) {
+            max_sample_size = std::min(max_sample_size, sketch->MaxCount());
+        }
+    }
+
+    // 32-bit inputs are intersected in place, all others are truncated into buffers first
+    std::vector<std::vector<uint32_t>> buffers(sketches.size());
+    std::vector<const uint32_t*> offsets;
+    std::vector<const uint32_t*> ends;
+    offsets.reserve(sketches.size());
+    ends.reserve(sketches.size());
+    // Positions of the buffered samples of the first input in its sketch
+    std::vector<size_t> first_positions;
+    for (size_t sketch_idx = 0; sketch_idx < sketches.size(); sketch_idx++) {
+        if (auto narrow = dynamic_cast<const MinHashSketchVector32*>(sketches[sketch_idx].get())) {
+            offsets.push_back(narrow->data.data());
+            ends.push_back(narrow->data.data() + std::min(narrow->data.size(), max_sample_size));
+            continue;
+        }
+        auto& buffer = buffers[sketch_idx];
+        for (auto it = sketches[sketch_idx]->Iterator(max_sample_size); !it->IsAtEnd(); it->Next()) {
+            // Distinct hashes may share their upper half
+            const uint32_t sample = ToSample(it->Current());
+            if (buffer.empty() || buffer.back() != sample) {
+                buffer.push_back(sample);
+                if (sketch_idx == 0 && mask) {
+                    first_positions.push_back(it->CurrentIdx());
+                }
+            }
+        }
+        offsets.push_back(buffer.data());
+        ends.push_back(buffer.data() + buffer.size());
+    }
+
+    std::vector<uint32_t> result;
+    sorted_intersection::IntersectMany(offsets, ends, result, strategy);
+    if (mask) {
+        const uint32_t* position = offsets[0];
+        for (const uint32_t sample : result) {
+            position = std::lower_bound(position, ends[0], sample);
+            const auto position_idx = static_cast<size_t>(position - offsets[0]);
+            mask->SetInvalid(first_positions.empty() ? position_idx : first_positions[position_idx]);
+        }
+    }
+    return std::make_shared<MinHashSketchVector32>(std::move(result), max_sample_size);
+}
+
+}  // namespace omnisketch
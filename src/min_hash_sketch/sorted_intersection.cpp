@@ -0,0 +1,368 @@
+#include "min_hash_sketch/sorted_intersection.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define OMNISKETCH_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace omnisketch {
+namespace sorted_intersection {
+
+namespace {
+
+template <class T>
+size_t IntersectScalarImpl(const T* a, size_t a_size, const T* b, size_t b_size, T* out) {
+    // Branch-free merge: the comparisons only decide how far the cursors move
+    size_t a_idx = 0;
+    size_t b_idx = 0;
+    size_t out_idx = 0;
+    while (a_idx < a_size && b_idx < b_size) {
+        const T a_hash = a[a_idx];
+        const T b_hash = b[b_idx];
+        out[out_idx] = a_hash;
+        out_idx += a_hash == b_hash;
+        a_idx += a_hash <= b_hash;
+        b_idx += b_hash <= a_hash;
+    }
+    return out_idx;
+}
+
+}  // namespace
+
+size_t IntersectScalar(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out) {
+    return IntersectScalarImpl(a, a_size, b, b_size, out);
+}
+
+size_t IntersectScalar(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out) {
+    return IntersectScalarImpl(a, a_size, b, b_size, out);
+}
+
+#ifdef OMNISKETCH_X86_SIMD
+
+// Both kernels compare a block of a against all rotations of a block of b, and then advance the block(s) with the
+// smaller maximum. The remaining tails are merged with the scalar kernel.
+
+__attribute__((target("avx2"))) size_t IntersectAVX2(const uint64_t* a, size_t a_size, const uint64_t* b,
+                                                      size_t b_size, uint64_t* out) {
+    constexpr size_t LANES = 4;
+    size_t a_idx = 0;
+    size_t b_idx = 0;
+    size_t out_idx = 0;
+    while (a_idx + LANES <= a_size && b_idx + LANES <= b_size) {
+        const __m256i a_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + a_idx));
+        const __m256i b_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + b_idx));
+
+        __m256i matches = _mm256_cmpeq_epi64(a_block, b_block);
+        matches = _mm256_or_si256(matches,
+                                  _mm256_cmpeq_epi64(a_block, _mm256_permute4x64_epi64(b_block, _MM_SHUFFLE(0, 3, 2, 1))));
+        matches = _mm256_or_si256(matches,
+                                  _mm256_cmpeq_epi64(a_block, _mm256_permute4x64_epi64(b_block, _MM_SHUFFLE(1, 0, 3, 2))));
+        matches = _mm256_or_si256(matches,
+                                  _mm256_cmpeq_epi64(a_block, _mm256_permute4x64_epi64(b_block, _MM_SHUFFLE(2, 1, 0, 3))));
+
+        // Read the block maxima first, out may alias a
+        const uint64_t a_max = a[a_idx + LANES - 1];
+        const uint64_t b_max = b[b_idx + LANES - 1];
+        unsigned int match_mask = static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(matches)));
+        while (match_mask != 0) {
+            out[out_idx++] = a[a_idx + __builtin_ctz(match_mask)];
+            match_mask &= match_mask - 1;
+        }
+
+        a_idx += a_max <= b_max ? LANES : 0;
+        b_idx += b_max <= a_max ? LANES : 0;
+    }
+
+    return out_idx + IntersectScalar(a + a_idx, a_size - a_idx, b + b_idx, b_size - b_idx, out + out_idx);
+}
+
+// Rotates the lanes of a block. Uses the masked variant since the plain one trips GCC's maybe-uninitialized warning.
+template <int LANE_COUNT>
+__attribute__((target("avx512f"))) inline __m512i RotateLanes(__m512i block) {
+    return _mm512_maskz_alignr_epi64(0xFF, block, block, LANE_COUNT);
+}
+
+__attribute__((target("avx512f"))) size_t IntersectAVX512(const uint64_t* a, size_t a_size, const uint64_t* b,
+                                                           size_t b_size, uint64_t* out) {
+    constexpr size_t LANES = 8;
+    size_t a_idx = 0;
+    size_t b_idx = 0;
+    size_t out_idx = 0;
+    while (a_idx + LANES <= a_size && b_idx + LANES <= b_size) {
+        const __m512i a_block = _mm512_loadu_si512(a + a_idx);
+        const __m512i b_block = _mm512_loadu_si512(b + b_idx);
+
+        __mmask8 matches = _mm512_cmpeq_epi64_mask(a_block, b_block);
+        matches |= _mm512_cmpeq_epi64_mask(a_block, RotateLanes<1>(b_block));
+        matches |= _mm512_cmpeq_epi64_mask(a_block, RotateLanes<2>(b_block));
+        matches |= _mm512_cmpeq_epi64_mask(a_block, RotateLanes<3>(b_block));
+        matches |= _mm512_cmpeq_epi64_mask(a_block, RotateLanes<4>(b_block));
+        matches |= _mm512_cmpeq_epi64_mask(a_block, RotateLanes<5>(b_block));
+        matches |= _mm512_cmpeq_epi64_mask(a_block, RotateLanes<6>(b_block));
+        matches |= _mm512_cmpeq_epi64_mask(a_block, RotateLanes<7>(b_block));
+
+        const uint64_t a_max = a[a_idx + LANES - 1];
+        const uint64_t b_max = b[b_idx + LANES - 1];
+        _mm512_mask_compressstoreu_epi64(out + out_idx, matches, a_block);
+        out_idx += static_cast<size_t>(__builtin_popcount(matches));
+
+        a_idx += a_max <= b_max ? LANES : 0;
+        b_idx += b_max <= a_max ? LANES : 0;
+    }
+
+    return out_idx + IntersectScalar(a + a_idx, a_size - a_idx, b + b_idx, b_size - b_idx, out + out_idx);
+}
+
+// The 32-bit kernels rotate b with a lane permutation instead, since there are too many rotations to spell out. As
+// above, AVX-512 uses the masked variant.
+
+__attribute__((target("avx2"))) size_t IntersectAVX2(const uint32_t* a, size_t a_size, const uint32_t* b,
+                                                      size_t b_size, uint32_t* out) {
+    constexpr size_t LANES = 8;
+    const __m256i rotation = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    size_t a_idx = 0;
+    size_t b_idx = 0;
+    size_t out_idx = 0;
+    while (a_idx + LANES <= a_size && b_idx + LANES <= b_size) {
+        const __m256i a_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + a_idx));
+        __m256i b_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + b_idx));
+
+        __m256i matches = _mm256_cmpeq_epi32(a_block, b_block);
+        for (size_t rotation_idx = 1; rotation_idx < LANES; rotation_idx++) {
+            b_block = _mm256_permutevar8x32_epi32(b_block, rotation);
+            matches = _mm256_or_si256(matches, _mm256_cmpeq_epi32(a_block, b_block));
+        }
+
+        const uint32_t a_max = a[a_idx + LANES - 1];
+        const uint32_t b_max = b[b_idx + LANES - 1];
+        unsigned int match_mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(matches)));
+        while (match_mask != 0) {
+            out[out_idx++] = a[a_idx + __builtin_ctz(match_mask)];
+            match_mask &= match_mask - 1;
+        }
+
+        a_idx += a_max <= b_max ? LANES : 0;
+        b_idx += b_max <= a_max ? LANES : 0;
+    }
+
+    return out_idx + IntersectScalar(a + a_idx, a_size - a_idx, b + b_idx, b_size - b_idx, out + out_idx);
+}
+
+__attribute__((target("avx512f"))) size_t IntersectAVX512(const uint32_t* a, size_t a_size, const uint32_t* b,
+                                                           size_t b_size, uint32_t* out) {
+    constexpr size_t LANES = 16;
+    const __m512i rotation = _mm512_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0);
+    size_t a_idx = 0;
+    size_t b_idx = 0;
+    size_t out_idx = 0;
+    while (a_idx + LANES <= a_size && b_idx + LANES <= b_size) {
+        const __m512i a_block = _mm512_loadu_si512(a + a_idx);
+        __m512i b_block = _mm512_loadu_si512(b + b_idx);
+
+        __mmask16 matches = _mm512_cmpeq_epi32_mask(a_block, b_block);
+        for (size_t rotation_idx = 1; rotation_idx < LANES; rotation_idx++) {
+            b_block = _mm512_maskz_permutexvar_epi32(0xFFFF, rotation, b_block);
+            matches |= _mm512_cmpeq_epi32_mask(a_block, b_block);
+        }
+
+        const uint32_t a_max = a[a_idx + LANES - 1];
+        const uint32_t b_max = b[b_idx + LANES - 1];
+        _mm512_mask_compressstoreu_epi32(out + out_idx, matches, a_block);
+        out_idx += static_cast<size_t>(__builtin_popcount(matches));
+
+        a_idx += a_max <= b_max ? LANES : 0;
+        b_idx += b_max <= a_max ? LANES : 0;
+    }
+
+    return out_idx + IntersectScalar(a + a_idx, a_size - a_idx, b + b_idx, b_size - b_idx, out + out_idx);
+}
+
+bool SupportsAVX2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+bool SupportsAVX512() {
+    return __builtin_cpu_supports("avx512f");
+}
+
+#else
+
+size_t IntersectAVX2(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out) {
+    return IntersectScalar(a, a_size, b, b_size, out);
+}
+
+size_t IntersectAVX512(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out) {
+    return IntersectScalar(a, a_size, b, b_size, out);
+}
+
+size_t IntersectAVX2(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out) {
+    return IntersectScalar(a, a_size, b, b_size, out);
+}
+
+size_t IntersectAVX512(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out) {
+    return IntersectScalar(a, a_size, b, b_size, out);
+}
+
+bool SupportsAVX2() {
+    return false;
+}
+
+bool SupportsAVX512() {
+    return false;
+}
+
+#endif
+
+template <class T>
+using IntersectFunction = size_t (*)(const T*, size_t, const T*, size_t, T*);
+
+template <class T>
+static IntersectFunction<T> SelectIntersectFunction() {
+    if (SupportsAVX512()) {
+        return IntersectAVX512;
+    }
+    if (SupportsAVX2()) {
+        return IntersectAVX2;
+    }
+    return IntersectScalar;
+}
+
+size_t IntersectLinear(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out) {
+    static const IntersectFunction<uint64_t> intersect = SelectIntersectFunction<uint64_t>();
+    return intersect(a, a_size, b, b_size, out);
+}
+
+size_t IntersectLinear(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out) {
+    static const IntersectFunction<uint32_t> intersect = SelectIntersectFunction<uint32_t>();
+    return intersect(a, a_size, b, b_size, out);
+}
+
+namespace {
+
+template <class T>
+size_t IntersectGallopingImpl(const T* a, size_t a_size, const T* b, size_t b_size, T* out) {
+    // If out aliases a and a is the larger input, every match is written at or before its position in a, which the
+    // search has already passed
+    const bool a_is_smaller = a_size <= b_size;
+    const T* small = a_is_smaller ? a : b;
+    const T* large = a_is_smaller ? b : a;
+    const size_t small_size = a_is_smaller ? a_size : b_size;
+    const size_t large_size = a_is_smaller ? b_size : a_size;
+
+    size_t large_idx = 0;
+    size_t out_idx = 0;
+    for (size_t small_idx = 0; small_idx < small_size && large_idx < large_size; small_idx++) {
+        const T hash = small[small_idx];
+        size_t bound = 1;
+        while (large_idx + bound < large_size && large[large_idx + bound] < hash) {
+            bound <<= 1;
+        }
+        large_idx = static_cast<size_t>(std::lower_bound(large + large_idx + (bound >> 1),
+                                                         large + std::min(large_idx + bound + 1, large_size), hash) -
+                                        large);
+        if (large_idx < large_size && large[large_idx] == hash) {
+            out[out_idx++] = hash;
+            large_idx++;
+        }
+    }
+    return out_idx;
+}
+
+template <class T>
+size_t IntersectImpl(const T* a, size_t a_size, const T* b, size_t b_size, T* out, IntersectionStrategy strategy) {
+    switch (strategy) {
+    case IntersectionStrategy::LINEAR_MERGE:
+        return IntersectLinear(a, a_size, b, b_size, out);
+    case IntersectionStrategy::GALLOPING:
+        return IntersectGallopingImpl(a, a_size, b, b_size, out);
+    case IntersectionStrategy::ADAPTIVE:
+        break;
+    }
+    const size_t small_size = std::min(a_size, b_size);
+    const size_t large_size = std::max(a_size, b_size);
+    if (small_size * GALLOPING_SIZE_RATIO <= large_size) {
+        return IntersectGallopingImpl(a, a_size, b, b_size, out);
+    }
+    return IntersectLinear(a, a_size, b, b_size, out);
+}
+
+template <class T>
+void IntersectManyImpl(const std::vector<const T*>& offsets, const std::vector<const T*>& ends, std::vector<T>& result,
+                       IntersectionStrategy strategy) {
+    assert(!offsets.empty() && offsets.size() == ends.size());
+    const size_t range_count = offsets.size();
+    const size_t result_offset = result.size();
+
+    if (range_count == 1) {
+        result.insert(result.end(), offsets[0], ends[0]);
+        return;
+    }
+
+    // Find the two smallest ranges
+    size_t smallest = 0;
+    size_t second_smallest = 1;
+    if (ends[1] - offsets[1] < ends[0] - offsets[0]) {
+        std::swap(smallest, second_smallest);
+    }
+    for (size_t range_idx = 2; range_idx < range_count; range_idx++) {
+        const auto range_size = ends[range_idx] - offsets[range_idx];
+        if (range_size < ends[smallest] - offsets[smallest]) {
+            second_smallest = smallest;
+            smallest = range_idx;
+        } else if (range_size < ends[second_smallest] - offsets[second_smallest]) {
+            second_smallest = range_idx;
+        }
+    }
+
+    const auto smallest_size = static_cast<size_t>(ends[smallest] - offsets[smallest]);
+    result.resize(result_offset + smallest_size);
+    T* out = result.data() + result_offset;
+    size_t match_count = IntersectImpl(offsets[smallest], smallest_size, offsets[second_smallest],
+                                       static_cast<size_t>(ends[second_smallest] - offsets[second_smallest]), out,
+                                       strategy);
+
+    for (size_t range_idx = 0; range_idx < range_count && match_count > 0; range_idx++) {
+        if (range_idx == smallest || range_idx == second_smallest) {
+            continue;
+        }
+        match_count = IntersectImpl(out, match_count, offsets[range_idx],
+                                    static_cast<size_t>(ends[range_idx] - offsets[range_idx]), out, strategy);
+    }
+    result.resize(result_offset + match_count);
+}
+
+}  // namespace
+
+size_t IntersectGalloping(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out) {
+    return IntersectGallopingImpl(a, a_size, b, b_size, out);
+}
+
+size_t IntersectGalloping(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out) {
+    return IntersectGallopingImpl(a, a_size, b, b_size, out);
+}
+
+size_t Intersect(const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out,
+                 IntersectionStrategy strategy) {
+    return IntersectImpl(a, a_size, b, b_size, out, strategy);
+}
+
+size_t Intersect(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size, uint32_t* out,
+                 IntersectionStrategy strategy) {
+    return IntersectImpl(a, a_size, b, b_size, out, strategy);
+}
+
+void IntersectMany(const std::vector<const uint64_t*>& offsets, const std::vector<const uint64_t*>& ends,
+                   std::vector<uint64_t>& result, IntersectionStrategy strategy) {
+    IntersectManyImpl(offsets, ends, result, strategy);
+}
+
+void IntersectMany(const std::vector<const uint32_t*>& offsets, const std::vector<const uint32_t*>& ends,
+                   std::vector<uint32_t>& result, IntersectionStrategy strategy) {
+    IntersectManyImpl(offsets, ends, result, strategy);
+}
+
+}  // namespace sorted_intersection
+}  // namespace omnisketch
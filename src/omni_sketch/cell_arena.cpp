@@ -0,0 +1,166 @@
+#include "omni_sketch/cell_arena.hpp"
+
+#include "min_hash_sketch/min_hash_sketch_span.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
+
+#include <stdexcept>
+
+namespace omnisketch {
+
+CellArena::CellArena(size_t width_p, size_t depth_p, size_t max_sample_count_p)
+    : width(width_p), depth(depth_p), max_sample_count(max_sample_count_p), block_width(width_p) {
+    owned_record_counts.resize(width * depth, 0);
+    owned_offsets.resize(width * depth + 1, 0);
+    record_counts = owned_record_counts.data();
+    offsets = owned_offsets.data();
+    samples = owned_samples.data();
+}
+
+std::shared_ptr<CellArena> CellArena::FromCells(const std::vector<std::vector<std::shared_ptr<OmniSketchCell>>>& cells,
+                                                size_t max_sample_count, size_t block_width) {
+    assert(!cells.empty());
+    const size_t width = cells.front().size();
+    auto arena = std::make_shared<CellArena>(width, cells.size(), max_sample_count);
+    if (block_width != 0 && block_width != width) {
+        if ((block_width & (block_width - 1)) != 0 || width % block_width != 0) {
+            throw std::logic_error("The block width has to be a power of two that divides the width.");
+        }
+        arena->block_width = block_width;
+    }
+
+    // The cells in the order of the layout
+    std::vector<const OmniSketchCell*> ordered_cells;
+    ordered_cells.reserve(arena->CellCount());
+    for (size_t block_begin = 0; block_begin < width; block_begin += arena->block_width) {
+        for (const auto& row : cells) {
+            for (size_t col_idx = block_begin; col_idx < block_begin + arena->block_width; col_idx++) {
+                ordered_cells.push_back(row[col_idx].get());
+            }
+        }
+    }
+
+    size_t total_sample_count = 0;
+    bool has_narrow_samples = true;
+    for (const auto* cell : ordered_cells) {
+        total_sample_count += cell->SampleCount();
+        has_narrow_samples &= dynamic_cast<const MinHashSketchVector32*>(cell->GetMinHashSketch().get()) != nullptr;
+    }
+
+    size_t cell_idx = 0;
+    if (has_narrow_samples) {
+        arena->sample_width = SampleWidth::BITS_32;
+        arena->owned_narrow_samples.reserve(total_sample_count);
+        for (const auto* cell : ordered_cells) {
+            arena->owned_record_counts[cell_idx] = cell->RecordCount();
+            const auto& cell_samples = static_cast<const MinHashSketchVector32&>(*cell->GetMinHashSketch()).Data();
+            arena->owned_narrow_samples.insert(arena->owned_narrow_samples.end(), cell_samples.cbegin(),
+                                               cell_samples.cend());
+            arena->owned_offsets[++cell_idx] = arena->owned_narrow_samples.size();
+        }
+        arena->narrow_samples = arena->owned_narrow_samples.data();
+        return arena;
+    }
+
+    arena->owned_samples.reserve(total_sample_count);
+    for (const auto* cell : ordered_cells) {
+        arena->owned_record_counts[cell_idx] = cell->RecordCount();
+        for (auto it = cell->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
+            arena->owned_samples.push_back(it->Current());
+        }
+        arena->owned_offsets[++cell_idx] = arena->owned_samples.size();
+    }
+    arena->samples = arena->owned_samples.data();
+
+    return arena;
+}
+
+std::shared_ptr<CellArena> CellArena::FromArrays(size_t width, size_t depth, size_t max_sample_count,
+                                                 std::vector<uint64_t> record_counts, std::vector<uint64_t> offsets,
+                                                 std::vector<uint64_t> samples) {
+    assert(record_counts.size() == width * depth && offsets.size() == width * depth + 1);
+    assert(offsets.back() == samples.size());
+    auto arena = std::make_shared<CellArena>(0, 0, max_sample_count);
+    arena->width = width;
+    arena->depth = depth;
+    arena->block_width = width;
+    arena->owned_record_counts = std::move(record_counts);
+    arena->owned_offsets = std::move(offsets);
+    arena->owned_samples = std::move(samples);
+    arena->record_counts = arena->owned_record_counts.data();
+    arena->offsets = arena->owned_offsets.data();
+    arena->samples = arena->owned_samples.data();
+    return arena;
+}
+
+std::shared_ptr<CellArena> CellArena::FromArrays(size_t width, size_t depth, size_t max_sample_count,
+                                                 std::vector<uint64_t> record_counts, std::vector<uint64_t> offsets,
+                                                 std::vector<uint32_t> samples) {
+    assert(record_counts.size() == width * depth && offsets.size() == width * depth + 1);
+    assert(offsets.back() == samples.size());
+    auto arena = std::make_shared<CellArena>(0, 0, max_sample_count);
+    arena->width = width;
+    arena->depth = depth;
+    arena->block_width = width;
+    arena->sample_width = SampleWidth::BITS_32;
+    arena->owned_record_counts = std::move(record_counts);
+    arena->owned_offsets = std::move(offsets);
+    arena->owned_narrow_samples = std::move(samples);
+    arena->record_counts = arena->owned_record_counts.data();
+    arena->offsets = arena->owned_offsets.data();
+    arena->samples = nullptr;
+    arena->narrow_samples = arena->owned_narrow_samples.data();
+    return arena;
+}
+
+std::shared_ptr<CellArena> CellArena::FromMemory(size_t width, size_t depth, size_t max_sample_count,
+                                                 const uint64_t* record_counts, const uint64_t* offsets,
+                                                 const uint64_t* samples, std::shared_ptr<const void> owner) {
+    auto arena = std::make_shared<CellArena>(0, 0, max_sample_count);
+    arena->width = width;
+    arena->depth = depth;
+    arena->block_width = width;
+    arena->record_counts = record_counts;
+    arena->offsets = offsets;
+    arena->samples = samples;
+    arena->owner = std::move(owner);
+    return arena;
+}
+
+std::shared_ptr<CellArena> CellArena::FromMemory(size_t width, size_t depth, size_t max_sample_count,
+                                                 const uint64_t* record_counts, const uint64_t* offsets,
+                                                 const uint32_t* samples, std::shared_ptr<const void> owner) {
+    auto arena = FromMemory(width, depth, max_sample_count, record_counts, offsets,
+                            static_cast<const uint64_t*>(nullptr), std::move(owner));
+    arena->sample_width = SampleWidth::BITS_32;
+    arena->narrow_samples = samples;
+    return arena;
+}
+
+std::shared_ptr<OmniSketchCell> CellArena::GetCell(size_t cell_idx) const {
+    if (sample_width == SampleWidth::BITS_32) {
+        // There is no read-only view of 32-bit samples, the cell gets a copy instead
+        return CopyCell(cell_idx);
+    }
+    auto sketch = std::make_shared<MinHashSketchSpan>(Samples(cell_idx), SampleCount(cell_idx), max_sample_count,
+                                                      shared_from_this());
+    return std::make_shared<OmniSketchCell>(std::move(sketch), RecordCount(cell_idx));
+}
+
+std::shared_ptr<OmniSketchCell> CellArena::CopyCell(size_t cell_idx) const {
+    if (sample_width == SampleWidth::BITS_32) {
+        std::vector<uint32_t> cell_samples(NarrowSamples(cell_idx), NarrowSamples(cell_idx) + SampleCount(cell_idx));
+        auto sketch = std::make_shared<MinHashSketchVector32>(std::move(cell_samples), max_sample_count);
+        return std::make_shared<OmniSketchCell>(std::move(sketch), RecordCount(cell_idx));
+    }
+    std::vector<uint64_t> cell_samples(Samples(cell_idx), Samples(cell_idx) + SampleCount(cell_idx));
+    auto sketch = std::make_shared<MinHashSketchVector>(std::move(cell_samples), max_sample_count);
+    return std::make_shared<OmniSketchCell>(std::move(sketch), RecordCount(cell_idx));
+}
+
+size_t CellArena::EstimateByteSize() const {
+    const size_t sample_size = sample_width == SampleWidth::BITS_32 ? sizeof(uint32_t) : sizeof(uint64_t);
+    return sizeof(CellArena) + (2 * CellCount() + 1) * sizeof(uint64_t) + TotalSampleCount() * sample_size;
+}
+
+}  // namespace omnisketch
@@ -1,8 +1,10 @@
 #include "omni_sketch/omni_sketch.hpp"
 
+#include <stdexcept>
 #include <utility>
 
-#include "min_hash_sketch/min_hash_sketch_map.hpp"
+#include "min_hash_sketch/min_hash_sketch_compressed.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
 #include "omni_sketch/omni_sketch_cell.hpp"
 #include "util/hash.hpp"
 
@@ -52,27 +54,93 @@ std::shared_ptr<OmniSketchCell> PointOmniSketch::ProbeHash(uint64_t hash,
                                                            size_t max_samples) const {
     assert(matches.size() == depth);
     assert(width == hash_processor->Width());
-    hash_processor->SetHash(hash);
+    std::vector<size_t> col_idxs(depth);
+    hash_processor->ComputeCellIdxs(hash, depth, col_idxs.data());
     for (size_t row_idx = 0; row_idx < depth; row_idx++) {
-        const size_t col_idx = hash_processor->ComputeCellIdx(row_idx);
-        matches[row_idx] = cells[row_idx][col_idx];
+        matches[row_idx] = CellAt(row_idx, col_idxs[row_idx]);
     }
 
     return OmniSketchCell::Intersect(matches, max_samples);
 }
 
+void PointOmniSketch::ProbeHash(uint64_t hash, ProbeContext& context, size_t max_samples) const {
+    assert(width == hash_processor->Width());
+    context.Reset(max_samples == 0 ? max_sample_count : max_samples);
+    size_t* col_idxs = context.ColIdxs(depth);
+    hash_processor->ComputeCellIdxs(hash, depth, col_idxs);
+    if (arena) {
+        PrefetchColumns(col_idxs, 1);
+    }
+    ProbeColumns(col_idxs, context);
+}
+
+void PointOmniSketch::ProbeHashes(const uint64_t* hashes, size_t count, ProbeBatch& batch, size_t max_samples) const {
+    assert(width == hash_processor->Width());
+    batch.Clear();
+    size_t* col_idxs = batch.ColIdxs(count, depth);
+    hash_processor->ComputeCellIdxs(hashes, count, depth, col_idxs);
+    if (arena) {
+        PrefetchColumns(col_idxs, count);
+    }
+
+    auto& context = batch.Context();
+    for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+        context.Reset(max_samples == 0 ? max_sample_count : max_samples);
+        ProbeColumns(col_idxs + hash_idx * depth, context);
+        batch.Append(context);
+    }
+}
+
+void PointOmniSketch::PrefetchColumns(const size_t* col_idxs, size_t count) const {
+    // Requests the cells of all hashes before the first intersection waits for one. The sample offsets have to arrive
+    // before the samples can be prefetched, so the samples are prefetched in a second pass.
+    for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            arena->PrefetchCell(arena->CellIdx(row_idx, col_idxs[hash_idx * depth + row_idx]));
+        }
+    }
+    for (size_t hash_idx = 0; hash_idx < count; hash_idx++) {
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            arena->PrefetchSamples(arena->CellIdx(row_idx, col_idxs[hash_idx * depth + row_idx]));
+        }
+    }
+}
+
+void PointOmniSketch::ProbeColumns(const size_t* col_idxs, ProbeContext& context) const {
+    for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+        const size_t col_idx = col_idxs[row_idx];
+        if (arena) {
+            const size_t cell_idx = arena->CellIdx(row_idx, col_idx);
+            if (arena->GetSampleWidth() == SampleWidth::BITS_32) {
+                context.AddRow(arena->NarrowSamples(cell_idx), arena->SampleCount(cell_idx),
+                               arena->RecordCount(cell_idx));
+            } else {
+                context.AddRow(arena->Samples(cell_idx), arena->SampleCount(cell_idx), arena->RecordCount(cell_idx));
+            }
+        } else {
+            const auto& cell = cells[row_idx][col_idx];
+            context.AddRow(*cell->GetMinHashSketch(), cell->RecordCount());
+        }
+    }
+    context.Intersect();
+}
+
 std::shared_ptr<OmniSketchCell> PointOmniSketch::ProbeHashedSet(const std::shared_ptr<MinHashSketch>& values) const {
     std::vector<std::vector<std::shared_ptr<OmniSketchCell>>> matches(
         values->Size(), std::vector<std::shared_ptr<OmniSketchCell>>(depth));
 
+    std::vector<uint64_t> hashes;
+    hashes.reserve(values->Size());
     auto value_it = values->Iterator();
     for (size_t value_idx = 0; value_idx < values->Size(); value_idx++) {
-        const uint64_t hash = value_it->Current();
+        hashes.push_back(value_it->Current());
         value_it->Next();
-        hash_processor->SetHash(hash);
+    }
+    std::vector<size_t> col_idxs(hashes.size() * depth);
+    hash_processor->ComputeCellIdxs(hashes.data(), hashes.size(), depth, col_idxs.data());
+    for (size_t value_idx = 0; value_idx < hashes.size(); value_idx++) {
         for (size_t row_idx = 0; row_idx < depth; row_idx++) {
-            const size_t col_idx = hash_processor->ComputeCellIdx(row_idx);
-            matches[value_idx][row_idx] = cells[row_idx][col_idx];
+            matches[value_idx][row_idx] = CellAt(row_idx, col_idxs[value_idx * depth + row_idx]);
         }
     }
 
@@ -88,11 +156,11 @@ std::shared_ptr<OmniSketchCell> PointOmniSketch::ProbeValueSet(const ValueSet& v
     std::vector<std::vector<std::shared_ptr<OmniSketchCell>>> matches(
         hashes.size(), std::vector<std::shared_ptr<OmniSketchCell>>(depth));
 
+    std::vector<size_t> col_idxs(hashes.size() * depth);
+    hash_processor->ComputeCellIdxs(hashes.data(), hashes.size(), depth, col_idxs.data());
     for (size_t value_idx = 0; value_idx < hashes.size(); value_idx++) {
-        hash_processor->SetHash(hashes[value_idx]);
         for (size_t row_idx = 0; row_idx < depth; row_idx++) {
-            const size_t col_idx = hash_processor->ComputeCellIdx(row_idx);
-            matches[value_idx][row_idx] = cells[row_idx][col_idx];
+            matches[value_idx][row_idx] = CellAt(row_idx, col_idxs[value_idx * depth + row_idx]);
         }
     }
 
@@ -100,14 +168,97 @@ std::shared_ptr<OmniSketchCell> PointOmniSketch::ProbeValueSet(const ValueSet& v
 }
 
 void PointOmniSketch::Flatten() {
+    if (arena) {
+        return;
+    }
+    arena = CellArena::FromCells(cells, max_sample_count, hash_processor->BlockWidth());
+    cells.clear();
+    cells.shrink_to_fit();
+    has_compressed_cells = false;
+}
+
+void PointOmniSketch::Unflatten() {
+    if (!arena) {
+        return;
+    }
+    cells.resize(depth);
+    for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+        cells[row_idx].reserve(width);
+        for (size_t col_idx = 0; col_idx < width; col_idx++) {
+            cells[row_idx].emplace_back(arena->CopyCell(arena->CellIdx(row_idx, col_idx)));
+        }
+    }
+    arena.reset();
+}
+
+bool PointOmniSketch::IsFlattened() const {
+    return arena != nullptr;
+}
+
+std::shared_ptr<OmniSketchCell> PointOmniSketch::CellAt(size_t row_idx, size_t col_idx) const {
+    if (arena) {
+        return arena->GetCell(arena->CellIdx(row_idx, col_idx));
+    }
+    return cells[row_idx][col_idx];
+}
+
+OmniSketchCell& PointOmniSketch::MutableCell(size_t row_idx, size_t col_idx) {
+    Unflatten();
+    if (has_compressed_cells) {
+        DecompressCells();
+    }
+    return *cells[row_idx][col_idx];
+}
+
+void PointOmniSketch::DecompressCells() {
     for (auto& row : cells) {
         for (auto& cell : row) {
-            cell = cell->Flatten();
+            // New cells, since others may still hold the read-only ones
+            if (dynamic_cast<const MinHashSketchCompressed*>(cell->GetMinHashSketch().get())) {
+                cell = std::make_shared<OmniSketchCell>(cell->GetMinHashSketch()->Flatten(), cell->RecordCount());
+            }
+        }
+    }
+    has_compressed_cells = false;
+}
+
+void PointOmniSketch::AddToCell(size_t row_idx, size_t col_idx, uint64_t record_id_hash) {
+    auto& cell = MutableCell(row_idx, col_idx);
+    if (sample_thresholds.empty()) {
+        cell.AddRecord(record_id_hash);
+        return;
+    }
+    const auto threshold = sample_thresholds.find(row_idx * width + col_idx);
+    if (threshold == sample_thresholds.end()) {
+        cell.AddRecord(record_id_hash);
+    } else if (record_id_hash > threshold->second) {
+        cell.SetRecordCount(cell.RecordCount() + 1);
+    } else {
+        cell.AddRecord(record_id_hash);
+        // A full sketch holds the smallest record id hashes again
+        if (cell.SampleCount() == cell.MaxSampleCount()) {
+            sample_thresholds.erase(threshold);
+        }
+    }
+}
+
+size_t PointOmniSketch::FilledCellCount(size_t row_idx) const {
+    size_t filled_cells = 0;
+    for (size_t col_idx = 0; col_idx < width; col_idx++) {
+        const size_t cell_record_count =
+            arena ? arena->RecordCount(arena->CellIdx(row_idx, col_idx)) : cells[row_idx][col_idx]->RecordCount();
+        if (cell_record_count > 0) {
+            filled_cells++;
         }
     }
+    return filled_cells;
 }
 
 size_t PointOmniSketch::EstimateByteSize() const {
+    if (arena) {
+        return arena->EstimateByteSize();
+    }
+
     size_t cell_size = 0;
     for (const auto& row : cells) {
         cell_size += sizeof(row);
@@ -132,14 +283,13 @@ size_t PointOmniSketch::MinHashSketchSize() const {
 }
 
 std::shared_ptr<OmniSketchCell> PointOmniSketch::GetRids() const {
-    auto result_map = std::make_shared<MinHashSketchMap>(max_sample_count);
-    for (auto& cell : cells.front()) {
-        for (auto it = cell->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
-            result_map->AddRecord(it->Current(), cell->RecordCount());
-        }
+    std::vector<std::shared_ptr<OmniSketchCell>> front_row;
+    front_row.reserve(width);
+    for (size_t col_idx = 0; col_idx < width; col_idx++) {
+        front_row.push_back(CellAt(0, col_idx));
     }
 
-    return OmniSketchCell::Combine(cells.front());
+    return OmniSketchCell::Combine(front_row);
 }
 
 void PointOmniSketch::Combine(const std::shared_ptr<OmniSketch>& other) {
@@ -149,31 +299,174 @@ void PointOmniSketch::Combine(const std::shared_ptr<OmniSketch>& other) {
 
     for (size_t row_idx = 0; row_idx < depth; row_idx++) {
         for (size_t col_idx = 0; col_idx < width; col_idx++) {
-            cells[row_idx][col_idx]->Combine(other->GetCell(row_idx, col_idx));
+            // Static sketches keep their thresholds in their cells, so they are read through the interface
+            const uint64_t other_threshold = other->SampleThreshold(row_idx, col_idx);
+            if (other_threshold != UINT64_MAX) {
+                auto inserted = sample_thresholds.emplace(row_idx * width + col_idx, other_threshold);
+                inserted.first->second = std::min(inserted.first->second, other_threshold);
+            }
+            MutableCell(row_idx, col_idx).Combine(other->GetCell(row_idx, col_idx));
+        }
+    }
+    // Samples above the threshold of an underfilled input cell are not among the smallest of the combined cell
+    for (auto threshold = sample_thresholds.begin(); threshold != sample_thresholds.end();) {
+        auto& cell = MutableCell(threshold->first / width, threshold->first % width);
+        cell.EraseSamplesAbove(threshold->second);
+        // A full sketch holds the smallest record id hashes again
+        if (cell.SampleCount() == cell.MaxSampleCount()) {
+            threshold = sample_thresholds.erase(threshold);
+        } else {
+            ++threshold;
         }
     }
 
     record_count += other->RecordCount();
+    null_count += other->CountNulls();
 }
 
-const OmniSketchCell& PointOmniSketch::GetCell(size_t row_idx, size_t col_idx) const {
-    return *cells[row_idx][col_idx];
+OmniSketchCell PointOmniSketch::GetCell(size_t row_idx, size_t col_idx) const {
+    return *CellAt(row_idx, col_idx);
+}
+
+uint64_t PointOmniSketch::SampleThreshold(size_t row_idx, size_t col_idx) const {
+    const auto threshold = sample_thresholds.find(row_idx * width + col_idx);
+    return threshold == sample_thresholds.end() ? UINT64_MAX : threshold->second;
 }
 
 void PointOmniSketch::AddRecordHashed(uint64_t value_hash, uint64_t record_id_hash) {
-    hash_processor->SetHash(value_hash);
+    mapped_col_idxs.resize(depth);
+    hash_processor->ComputeCellIdxs(value_hash, depth, mapped_col_idxs.data());
     for (size_t row_idx = 0; row_idx < depth; row_idx++) {
-        const size_t col_idx = hash_processor->ComputeCellIdx(row_idx);
-        cells[row_idx][col_idx]->AddRecord(record_id_hash);
+        AddToCell(row_idx, mapped_col_idxs[row_idx], record_id_hash);
     }
     record_count++;
 }
 
+void PointOmniSketch::AddRecordsHashed(const uint64_t* value_hashes, const uint64_t* record_id_hashes,
+                                       size_t count) {
+    if (count < width || !sample_thresholds.empty()) {
+        // Grouping does not pay off for batches that touch only a few cells per row, and underfilled cells check
+        // every record id hash against their sample threshold
+        for (size_t record_idx = 0; record_idx < count; record_idx++) {
+            AddRecordHashed(value_hashes[record_idx], record_id_hashes[record_idx]);
+        }
+        return;
+    }
+
+    mapped_col_idxs.resize(count * depth);
+    hash_processor->ComputeCellIdxs(value_hashes, count, depth, mapped_col_idxs.data());
+    batch_cell_idxs.resize(count * depth);
+    for (size_t record_idx = 0; record_idx < count; record_idx++) {
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            const size_t idx = record_idx * depth + row_idx;
+            batch_cell_idxs[idx] = static_cast<uint32_t>(row_idx * width + mapped_col_idxs[idx]);
+        }
+    }
+    AddRecordsToCells(batch_cell_idxs.data(), record_id_hashes, count);
+}
+
+void PointOmniSketch::ComputeCellIdxs(uint64_t value_hash, uint32_t* cell_idxs) {
+    mapped_col_idxs.resize(depth);
+    hash_processor->ComputeCellIdxs(value_hash, depth, mapped_col_idxs.data());
+    for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+        cell_idxs[row_idx] = static_cast<uint32_t>(row_idx * width + mapped_col_idxs[row_idx]);
+    }
+}
+
+void PointOmniSketch::AddRecordsToCells(const uint32_t* cell_idxs, const uint64_t* record_id_hashes, size_t count) {
+    if (count < width || !sample_thresholds.empty()) {
+        for (size_t record_idx = 0; record_idx < count; record_idx++) {
+            for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+                const size_t cell_idx = cell_idxs[record_idx * depth + row_idx];
+                AddToCell(cell_idx / width, cell_idx % width, record_id_hashes[record_idx]);
+            }
+        }
+        record_count += count;
+        return;
+    }
+
+    // Counting sort of the (cell, record id hash) updates by cell
+    const size_t cell_count = width * depth;
+    batch_cell_offsets.assign(cell_count + 1, 0);
+    for (size_t update_idx = 0; update_idx < count * depth; update_idx++) {
+        batch_cell_offsets[cell_idxs[update_idx] + 1]++;
+    }
+    for (size_t cell_idx = 0; cell_idx < cell_count; cell_idx++) {
+        batch_cell_offsets[cell_idx + 1] += batch_cell_offsets[cell_idx];
+    }
+
+    batch_hashes.resize(count * depth);
+    for (size_t record_idx = 0; record_idx < count; record_idx++) {
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            auto& offset = batch_cell_offsets[cell_idxs[record_idx * depth + row_idx]];
+            batch_hashes[offset++] = record_id_hashes[record_idx];
+        }
+    }
+
+    // Every offset now points to the end of its cell's updates
+    size_t cell_begin = 0;
+    for (size_t cell_idx = 0; cell_idx < cell_count; cell_idx++) {
+        const size_t cell_end = batch_cell_offsets[cell_idx];
+        if (cell_end > cell_begin) {
+            MutableCell(cell_idx / width, cell_idx % width)
+                .AddRecords(batch_hashes.data() + cell_begin, cell_end - cell_begin);
+        }
+        cell_begin = cell_end;
+    }
+    record_count += count;
+}
+
 void PointOmniSketch::AddNullValues(size_t count) {
     record_count += count;
     null_count += count;
 }
 
+void PointOmniSketch::RemoveValueRecord(const Value& value, uint64_t record_id) {
+    RemoveRecordHashed(value.GetHash(), hash_functions::Hash(record_id));
+}
+
+void PointOmniSketch::RemoveRecordHashed(uint64_t value_hash, uint64_t record_id_hash) {
+    assert(record_count > null_count);
+    mapped_col_idxs.resize(depth);
+    hash_processor->ComputeCellIdxs(value_hash, depth, mapped_col_idxs.data());
+    for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+        const size_t col_idx = mapped_col_idxs[row_idx];
+        const uint64_t threshold = MutableCell(row_idx, col_idx).RemoveRecord(record_id_hash);
+        if (threshold != UINT64_MAX) {
+            auto inserted = sample_thresholds.emplace(row_idx * width + col_idx, threshold);
+            inserted.first->second = std::min(inserted.first->second, threshold);
+        }
+    }
+    record_count--;
+}
+
+void PointOmniSketch::RemoveNullValues(size_t count) {
+    assert(null_count >= count);
+    record_count -= count;
+    null_count -= count;
+}
+
+void PointOmniSketch::UpdateValueRecord(const Value& old_value, const Value& new_value, uint64_t record_id) {
+    RemoveValueRecord(old_value, record_id);
+    AddValueRecord(new_value, record_id);
+}
+
+size_t PointOmniSketch::UnderfilledCellCount() const {
+    return sample_thresholds.size();
+}
+
+double PointOmniSketch::MinSampleFill() const {
+    double min_fill = 1.0;
+    for (const auto& threshold : sample_thresholds) {
+        const auto cell = CellAt(threshold.first / width, threshold.first % width);
+        const size_t expected_sample_count = std::min(max_sample_count, cell->RecordCount());
+        if (expected_sample_count > 0) {
+            min_fill = std::min(min_fill, (double)cell->SampleCount() / (double)expected_sample_count);
+        }
+    }
+    return min_fill;
+}
+
 size_t PointOmniSketch::CountNulls() const {
     return null_count;
 }
@@ -183,7 +476,54 @@ void PointOmniSketch::SetRecordCount(size_t record_count_p) {
 }
 
 void PointOmniSketch::SetCell(size_t row_idx, size_t col_idx, std::shared_ptr<OmniSketchCell> cell) {
+    Unflatten();
+    has_compressed_cells |= dynamic_cast<const MinHashSketchCompressed*>(cell->GetMinHashSketch().get()) != nullptr;
+    RestoreSampleThreshold(row_idx, col_idx, *cell);
     cells[row_idx][col_idx] = std::move(cell);
 }
 
+void PointOmniSketch::SetArena(std::shared_ptr<CellArena> arena_p) {
+    if (arena_p->Width() != width || arena_p->Depth() != depth) {
+        throw std::logic_error("The arena does not match the dimensions of the sketch.");
+    }
+    arena = std::move(arena_p);
+    cells.clear();
+    cells.shrink_to_fit();
+    has_compressed_cells = false;
+    sample_thresholds.clear();
+    for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+        for (size_t col_idx = 0; col_idx < width; col_idx++) {
+            const size_t cell_idx = arena->CellIdx(row_idx, col_idx);
+            if (arena->SampleCount(cell_idx) < std::min(max_sample_count, arena->RecordCount(cell_idx))) {
+                RestoreSampleThreshold(row_idx, col_idx, *arena->GetCell(cell_idx));
+            }
+        }
+    }
+}
+
+void PointOmniSketch::RestoreSampleThreshold(size_t row_idx, size_t col_idx, const OmniSketchCell& cell) {
+    sample_thresholds.erase(row_idx * width + col_idx);
+    if (cell.SampleCount() >= std::min(max_sample_count, cell.RecordCount())) {
+        return;
+    }
+    // The records up to the largest sample are all sampled, others may have been dropped before a removal
+    uint64_t largest_sample = 0;
+    for (auto it = cell.GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
+        largest_sample = std::max(largest_sample, it->Current());
+    }
+    sample_thresholds[row_idx * width + col_idx] = largest_sample;
+}
+
+size_t PointOmniSketch::BlockWidth() const {
+    return hash_processor->BlockWidth();
+}
+
+SampleWidth PointOmniSketch::GetSampleWidth() const {
+    if (arena) {
+        return arena->GetSampleWidth();
+    }
+    const bool is_narrow = dynamic_cast<const MinHashSketchVector32*>(cells[0][0]->GetMinHashSketch().get()) != nullptr;
+    return is_narrow ? SampleWidth::BITS_32 : SampleWidth::BITS_64;
+}
+
 }  // namespace omnisketch
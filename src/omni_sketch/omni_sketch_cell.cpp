@@ -24,6 +24,42 @@ void OmniSketchCell::AddRecord(uint64_t hash) {
     record_count++;
 }
 
+void OmniSketchCell::AddRecords(const uint64_t* hashes, size_t count) {
+    min_hash_sketch->AddRecords(hashes, count);
+    record_count += count;
+}
+
+uint64_t OmniSketchCell::RemoveRecord(uint64_t hash) {
+    assert(record_count > 0);
+    record_count--;
+    // Counts the live samples, since sketches with a validity mask keep erased samples in their storage
+    size_t sample_count = 0;
+    uint64_t largest_sample = 0;
+    for (auto it = min_hash_sketch->Iterator(); !it->IsAtEnd(); it->Next()) {
+        sample_count++;
+        largest_sample = std::max(largest_sample, it->Current());
+    }
+    const size_t size_before = min_hash_sketch->Size();
+    min_hash_sketch->EraseRecord(hash);
+    if (sample_count < min_hash_sketch->MaxCount() || min_hash_sketch->Size() == size_before) {
+        // All records of an underfilled cell are sampled, and records that were not sampled leave the samples intact
+        return UINT64_MAX;
+    }
+    return largest_sample;
+}
+
+void OmniSketchCell::EraseSamplesAbove(uint64_t threshold) {
+    std::vector<uint64_t> erased_samples;
+    for (auto it = min_hash_sketch->Iterator(); !it->IsAtEnd(); it->Next()) {
+        if (it->Current() > threshold) {
+            erased_samples.push_back(it->Current());
+        }
+    }
+    for (const uint64_t sample : erased_samples) {
+        min_hash_sketch->EraseRecord(sample);
+    }
+}
+
 size_t OmniSketchCell::RecordCount() const {
     return record_count;
 }
@@ -71,7 +107,7 @@ size_t OmniSketchCell::EstimateByteSize() const {
 std::shared_ptr<OmniSketchCell> OmniSketchCell::Intersect(const std::vector<std::shared_ptr<OmniSketchCell>>& cells,
                                                           size_t max_samples) {
     assert(!cells.empty());
-    // TODO(perf): re-use vectors or operate on min-hash sketches directly
+    // Allocates the inputs and the result; hot probe loops should use a ProbeContext instead
     std::vector<std::shared_ptr<MinHashSketch>> sketches;
     sketches.reserve(cells.size());
 
@@ -89,13 +125,18 @@ std::shared_ptr<OmniSketchCell> OmniSketchCell::Intersect(const std::vector<std:
     }
 
     auto result = std::make_shared<OmniSketchCell>(sketches.front()->Intersect(sketches, max_samples));
-    const double card_est =
-        std::min((double)n_min, (double)n_max / (double)sample_count * (double)result->SampleCount());
-    result->SetRecordCount((size_t)std::round(card_est));
+    result->SetRecordCount(EstimateIntersectionCard(n_min, n_max, sample_count, result->SampleCount()));
 
     return result;
 }
 
+size_t OmniSketchCell::EstimateIntersectionCard(size_t n_min, size_t n_max, size_t n_max_sample_count,
+                                                size_t result_sample_count) {
+    const double card_est =
+        std::min((double)n_min, (double)n_max / (double)n_max_sample_count * (double)result_sample_count);
+    return (size_t)std::round(card_est);
+}
+
 std::shared_ptr<OmniSketchCell> OmniSketchCell::Combine(const std::vector<std::shared_ptr<OmniSketchCell>>& cells) {
     assert(!cells.empty());
     std::vector<std::shared_ptr<MinHashSketch>> sketches;
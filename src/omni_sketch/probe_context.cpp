@@ -0,0 +1,107 @@
+#include "omni_sketch/probe_context.hpp"
+
+#include "min_hash_sketch/min_hash_sketch_span.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
+
+namespace omnisketch {
+
+void ProbeContext::Reset(size_t max_sample_count_p) {
+    max_sample_count = max_sample_count_p;
+    row_count = 0;
+    row_offsets.clear();
+    row_ends.clear();
+    narrow_row_offsets.clear();
+    narrow_row_ends.clear();
+    samples.clear();
+    n_max = 0;
+    n_max_sample_count = 0;
+    n_min = UINT64_MAX;
+    record_count = 0;
+}
+
+void ProbeContext::AddRow(const uint64_t* row_samples, size_t row_sample_count, size_t row_record_count) {
+    if (row_record_count > n_max) {
+        n_max = row_record_count;
+        n_max_sample_count = row_sample_count;
+    }
+    n_min = std::min(n_min, row_record_count);
+    row_offsets.push_back(row_samples);
+    row_ends.push_back(row_samples + std::min(row_sample_count, max_sample_count));
+    row_count++;
+}
+
+void ProbeContext::AddRow(const uint32_t* row_samples, size_t row_sample_count, size_t row_record_count) {
+    if (row_record_count > n_max) {
+        n_max = row_record_count;
+        n_max_sample_count = row_sample_count;
+    }
+    n_min = std::min(n_min, row_record_count);
+    narrow_row_offsets.push_back(row_samples);
+    narrow_row_ends.push_back(row_samples + std::min(row_sample_count, max_sample_count));
+    row_count++;
+}
+
+void ProbeContext::AddRow(const MinHashSketch& row_sketch, size_t row_record_count) {
+    if (row_buffers.size() <= row_count) {
+        row_buffers.resize(row_count + 1);
+    }
+    auto& buffer = row_buffers[row_count];
+    buffer.clear();
+    for (auto it = row_sketch.Iterator(max_sample_count); !it->IsAtEnd(); it->Next()) {
+        buffer.push_back(it->Current());
+    }
+
+    if (row_record_count > n_max) {
+        n_max = row_record_count;
+        n_max_sample_count = row_sketch.Size();
+    }
+    n_min = std::min(n_min, row_record_count);
+    row_offsets.push_back(buffer.data());
+    row_ends.push_back(buffer.data() + buffer.size());
+    row_count++;
+}
+
+void ProbeContext::Intersect() {
+    assert(row_count > 0);
+    if (narrow_row_offsets.empty()) {
+        MinHashSketchSpan::IntersectSorted(row_offsets, row_ends, samples);
+    } else {
+        assert(row_offsets.empty());
+        narrow_samples.clear();
+        sorted_intersection::IntersectMany(narrow_row_offsets, narrow_row_ends, narrow_samples);
+        samples.reserve(narrow_samples.size());
+        for (const uint32_t sample : narrow_samples) {
+            samples.push_back(static_cast<uint64_t>(sample) << 32);
+        }
+    }
+    record_count = OmniSketchCell::EstimateIntersectionCard(n_min, n_max, n_max_sample_count, samples.size());
+}
+
+std::shared_ptr<OmniSketchCell> ProbeContext::ToCell() const {
+    if (!narrow_row_offsets.empty()) {
+        // Keeps the result 32-bit, so that it is truncated along with everything it is intersected with
+        auto sketch = std::make_shared<MinHashSketchVector32>(narrow_samples, max_sample_count);
+        return std::make_shared<OmniSketchCell>(std::move(sketch), record_count);
+    }
+    auto sketch =
+        std::make_shared<MinHashSketchVector>(max_sample_count, std::make_unique<ValidityMask>(max_sample_count));
+    sketch->Data() = samples;
+    return std::make_shared<OmniSketchCell>(std::move(sketch), record_count);
+}
+
+void ProbeBatch::Clear() {
+    record_counts.clear();
+    max_record_counts.clear();
+    sample_offsets.resize(1);
+    samples.clear();
+}
+
+void ProbeBatch::Append(const ProbeContext& probe_context) {
+    record_counts.push_back(probe_context.RecordCount());
+    max_record_counts.push_back(probe_context.MaxRecordCount());
+    samples.insert(samples.end(), probe_context.Samples().begin(), probe_context.Samples().end());
+    sample_offsets.push_back(samples.size());
+}
+
+}  // namespace omnisketch
@@ -0,0 +1,370 @@
+#include "omni_sketch/sketch_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "min_hash_sketch/min_hash_sketch_compressed.hpp"
+
+namespace omnisketch {
+namespace sketch_file {
+
+namespace {
+
+struct FileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint32_t kind;
+    uint32_t data_type;
+    uint64_t width;
+    uint64_t depth;
+    uint64_t min_hash_sketch_size;
+    uint64_t record_count;
+    uint64_t null_count;
+    uint64_t min_bits;
+    uint64_t max_bits;
+    uint64_t sample_count;
+    // Lengths of the strings that follow the header: table name, column name, referencing table name, min, max
+    uint64_t string_lengths[5];
+    // Since version 2
+    uint32_t sample_encoding;
+    // 0 in files that were written before 32-bit samples existed
+    uint32_t sample_width;
+};
+
+constexpr size_t VERSION_1_HEADER_SIZE = offsetof(FileHeader, sample_encoding);
+
+size_t AlignUp(size_t offset) {
+    return (offset + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+}
+
+// Returns width * depth of the header, or throws if the product (or the arrays sized by it) would overflow
+size_t CellCount(const std::string& path, const FileHeader& header) {
+    constexpr size_t MAX_CELL_COUNT = (std::numeric_limits<size_t>::max() / sizeof(uint64_t) - 2) / 4;
+    if (header.width != 0 && header.depth > MAX_CELL_COUNT / header.width) {
+        throw std::runtime_error(path + " is corrupted.");
+    }
+    return header.width * header.depth;
+}
+
+// Throws unless the cell_count + 1 offsets are monotonic and end at no more than limit
+void CheckOffsets(const std::string& path, const uint64_t* offsets, size_t cell_count, size_t limit) {
+    if (offsets[cell_count] > limit) {
+        throw std::runtime_error(path + " is corrupted.");
+    }
+    for (size_t cell_idx = 0; cell_idx < cell_count; cell_idx++) {
+        if (offsets[cell_idx] > offsets[cell_idx + 1]) {
+            throw std::runtime_error(path + " is corrupted.");
+        }
+    }
+}
+
+// Throws unless the blocks of a cell with sample_count samples have valid bit widths and only decode from the
+// word_count words of the cell
+void CheckBlocks(const std::string& path, const MinHashSketchCompressed::Block* blocks, size_t sample_count,
+                 size_t word_count) {
+    constexpr size_t BLOCK_SIZE = MinHashSketchCompressed::BLOCK_SIZE;
+    for (size_t block_idx = 0; block_idx < MinHashSketchCompressed::BlockCount(sample_count); block_idx++) {
+        const auto& block = blocks[block_idx];
+        const size_t delta_count = std::min(BLOCK_SIZE, sample_count - block_idx * BLOCK_SIZE) - 1;
+        // The hashes of a block are strictly increasing, so its deltas take at least one bit
+        if (block.bit_width > 64 || (delta_count > 0 && block.bit_width == 0) || block.word_offset > word_count ||
+            (delta_count * block.bit_width + 63) / 64 > word_count - block.word_offset) {
+            throw std::runtime_error(path + " is corrupted.");
+        }
+    }
+}
+
+template <class T>
+void WriteArray(std::ofstream& file, const T* data, size_t count) {
+    file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+void WriteDeltaEncodedSamples(std::ofstream& file, const CellArena& cells) {
+    const size_t cell_count = cells.CellCount();
+    std::vector<uint64_t> sample_counts(cell_count);
+    std::vector<uint64_t> block_offsets(cell_count + 1, 0);
+    std::vector<uint64_t> word_offsets(cell_count + 1, 0);
+    std::vector<MinHashSketchCompressed::Block> blocks;
+    std::vector<uint64_t> words;
+    std::vector<uint64_t> widened_samples;
+    for (size_t cell_idx = 0; cell_idx < cell_count; cell_idx++) {
+        sample_counts[cell_idx] = cells.SampleCount(cell_idx);
+        const uint64_t* cell_samples;
+        if (cells.GetSampleWidth() == SampleWidth::BITS_32) {
+            widened_samples.clear();
+            for (size_t sample_idx = 0; sample_idx < cells.SampleCount(cell_idx); sample_idx++) {
+                widened_samples.push_back(static_cast<uint64_t>(cells.NarrowSamples(cell_idx)[sample_idx]) << 32);
+            }
+            cell_samples = widened_samples.data();
+        } else {
+            cell_samples = cells.Samples(cell_idx);
+        }
+        std::vector<uint64_t> cell_words;
+        MinHashSketchCompressed::Encode(cell_samples, cells.SampleCount(cell_idx), blocks, cell_words);
+        words.insert(words.end(), cell_words.begin(), cell_words.end());
+        block_offsets[cell_idx + 1] = blocks.size();
+        word_offsets[cell_idx + 1] = words.size();
+    }
+    WriteArray(file, cells.RecordCounts(), cell_count);
+    WriteArray(file, sample_counts.data(), cell_count);
+    WriteArray(file, block_offsets.data(), cell_count + 1);
+    WriteArray(file, word_offsets.data(), cell_count + 1);
+    WriteArray(file, blocks.data(), blocks.size());
+    WriteArray(file, words.data(), words.size());
+}
+
+std::vector<std::shared_ptr<OmniSketchCell>> MapDeltaEncodedSamples(const std::string& path, const char* arrays,
+                                                                    size_t arrays_size, const FileHeader& header,
+                                                                    const std::shared_ptr<const void>& mapping) {
+    const size_t cell_count = CellCount(path, header);
+    const size_t index_size = (4 * cell_count + 2) * sizeof(uint64_t);
+    if (index_size > arrays_size) {
+        throw std::runtime_error(path + " is truncated.");
+    }
+    const auto* record_counts = reinterpret_cast<const uint64_t*>(arrays);
+    const uint64_t* sample_counts = record_counts + cell_count;
+    const uint64_t* block_offsets = sample_counts + cell_count;
+    const uint64_t* word_offsets = block_offsets + cell_count + 1;
+    const auto* blocks = reinterpret_cast<const MinHashSketchCompressed::Block*>(word_offsets + cell_count + 1);
+    const size_t block_count = block_offsets[cell_count];
+    const size_t word_count = word_offsets[cell_count];
+    if (block_count > (arrays_size - index_size) / sizeof(MinHashSketchCompressed::Block) ||
+        word_count > (arrays_size - index_size - block_count * sizeof(MinHashSketchCompressed::Block)) /
+                         sizeof(uint64_t)) {
+        throw std::runtime_error(path + " is truncated.");
+    }
+    CheckOffsets(path, block_offsets, cell_count, block_count);
+    CheckOffsets(path, word_offsets, cell_count, word_count);
+    const auto* words = reinterpret_cast<const uint64_t*>(blocks + block_count);
+
+    std::vector<std::shared_ptr<OmniSketchCell>> cells;
+    cells.reserve(cell_count);
+    for (size_t cell_idx = 0; cell_idx < cell_count; cell_idx++) {
+        if (sample_counts[cell_idx] > header.min_hash_sketch_size ||
+            MinHashSketchCompressed::BlockCount(sample_counts[cell_idx]) !=
+                block_offsets[cell_idx + 1] - block_offsets[cell_idx]) {
+            throw std::runtime_error(path + " is corrupted.");
+        }
+        CheckBlocks(path, blocks + block_offsets[cell_idx], sample_counts[cell_idx],
+                    word_offsets[cell_idx + 1] - word_offsets[cell_idx]);
+        auto sketch = std::make_shared<MinHashSketchCompressed>(blocks + block_offsets[cell_idx],
+                                                                words + word_offsets[cell_idx], sample_counts[cell_idx],
+                                                                header.min_hash_sketch_size, mapping);
+        cells.push_back(std::make_shared<OmniSketchCell>(std::move(sketch), record_counts[cell_idx]));
+    }
+    return cells;
+}
+
+// Maps the whole file read-only, the mapping is released with the returned pointer
+std::shared_ptr<const void> MapFile(const std::string& path, size_t& file_size) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path + ".");
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat " + path + ".");
+    }
+    file_size = static_cast<size_t>(file_stat.st_size);
+    if (file_size < VERSION_1_HEADER_SIZE) {
+        close(fd);
+        throw std::runtime_error(path + " is not a sketch file.");
+    }
+    void* address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + path + ".");
+    }
+    return std::shared_ptr<const void>(address, [file_size](const void* mapped) {
+        munmap(const_cast<void*>(mapped), file_size);
+    });
+}
+
+// Reads the header and the strings that follow it, and returns the offset of the arrays
+size_t ParseInfo(const std::string& path, const char* bytes, size_t file_size, FileHeader& header, SketchInfo& info) {
+    header = FileHeader{};
+    std::memcpy(&header, bytes, VERSION_1_HEADER_SIZE);
+    if (header.magic != MAGIC || header.byte_order_mark != BYTE_ORDER_MARK) {
+        throw std::runtime_error(path + " is not a sketch file of this platform.");
+    }
+    if (header.version == 0 || header.version > VERSION) {
+        throw std::runtime_error(path + " has unsupported version " + std::to_string(header.version) + ".");
+    }
+    const size_t header_size = header.version == 1 ? VERSION_1_HEADER_SIZE : sizeof(FileHeader);
+    if (file_size < header_size) {
+        throw std::runtime_error(path + " is truncated.");
+    }
+    std::memcpy(&header, bytes, header_size);
+
+    info.kind = static_cast<SketchKind>(header.kind);
+    info.data_type = static_cast<DataType>(header.data_type);
+    info.width = header.width;
+    info.depth = header.depth;
+    info.min_hash_sketch_size = header.min_hash_sketch_size;
+    info.record_count = header.record_count;
+    info.null_count = header.null_count;
+    info.min_bits = header.min_bits;
+    info.max_bits = header.max_bits;
+    info.sample_encoding = static_cast<SampleEncoding>(header.sample_encoding);
+    if (header.sample_width != 0 && header.sample_width != static_cast<uint32_t>(SampleWidth::BITS_32) &&
+        header.sample_width != static_cast<uint32_t>(SampleWidth::BITS_64)) {
+        throw std::runtime_error(path + " has an unknown sample width.");
+    }
+    info.sample_width = header.sample_width == 32 ? SampleWidth::BITS_32 : SampleWidth::BITS_64;
+
+    size_t offset = header_size;
+    std::string* strings[] = {&info.table_name, &info.column_name, &info.referencing_table_name, &info.min_string,
+                              &info.max_string};
+    for (size_t string_idx = 0; string_idx < 5; string_idx++) {
+        const size_t length = header.string_lengths[string_idx];
+        if (length > file_size - offset) {
+            throw std::runtime_error(path + " is truncated.");
+        }
+        strings[string_idx]->assign(bytes + offset, length);
+        offset += length;
+    }
+    offset = AlignUp(offset);
+    if (offset > file_size) {
+        throw std::runtime_error(path + " is truncated.");
+    }
+    return offset;
+}
+
+}  // namespace
+
+void Write(const std::string& path, const SketchInfo& info, const CellArena& cells) {
+    assert(cells.Width() == info.width && cells.Depth() == info.depth);
+    if (cells.BlockWidth() != cells.Width()) {
+        throw std::logic_error("Sketch files store the cells row by row.");
+    }
+    FileHeader header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.byte_order_mark = BYTE_ORDER_MARK;
+    header.kind = static_cast<uint32_t>(info.kind);
+    header.data_type = static_cast<uint32_t>(info.data_type);
+    header.width = info.width;
+    header.depth = info.depth;
+    header.min_hash_sketch_size = info.min_hash_sketch_size;
+    header.record_count = info.record_count;
+    header.null_count = info.null_count;
+    header.min_bits = info.min_bits;
+    header.max_bits = info.max_bits;
+    header.sample_count = cells.TotalSampleCount();
+    header.sample_encoding = static_cast<uint32_t>(info.sample_encoding);
+    header.sample_width = static_cast<uint32_t>(cells.GetSampleWidth());
+    const std::string* strings[] = {&info.table_name, &info.column_name, &info.referencing_table_name,
+                                    &info.min_string, &info.max_string};
+    size_t strings_size = 0;
+    for (size_t string_idx = 0; string_idx < 5; string_idx++) {
+        header.string_lengths[string_idx] = strings[string_idx]->size();
+        strings_size += strings[string_idx]->size();
+    }
+
+    // Written next to the file and renamed over it, so that mappings of the replaced file stay valid, e.g., of a
+    // checkpoint that is appended to and written back to the same directory
+    const std::string temporary_path = path + ".tmp";
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Could not open " + temporary_path + " for writing.");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto* string : strings) {
+        file.write(string->data(), static_cast<std::streamsize>(string->size()));
+    }
+    const size_t padding = AlignUp(sizeof(header) + strings_size) - (sizeof(header) + strings_size);
+    const char zeros[sizeof(uint64_t)] = {};
+    file.write(zeros, static_cast<std::streamsize>(padding));
+
+    if (info.sample_encoding == SampleEncoding::DELTA) {
+        WriteDeltaEncodedSamples(file, cells);
+    } else {
+        WriteArray(file, cells.RecordCounts(), cells.CellCount());
+        WriteArray(file, cells.Offsets(), cells.CellCount() + 1);
+        if (cells.GetSampleWidth() == SampleWidth::BITS_32) {
+            WriteArray(file, cells.AllNarrowSamples(), cells.TotalSampleCount());
+        } else {
+            WriteArray(file, cells.AllSamples(), cells.TotalSampleCount());
+        }
+    }
+    file.close();
+    if (!file) {
+        std::remove(temporary_path.c_str());
+        throw std::runtime_error("Could not write " + temporary_path + ".");
+    }
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        std::remove(temporary_path.c_str());
+        throw std::runtime_error("Could not replace " + path + ".");
+    }
+}
+
+SketchInfo ReadInfo(const std::string& path) {
+    size_t file_size;
+    const auto mapping = MapFile(path, file_size);
+    FileHeader header;
+    SketchInfo info;
+    ParseInfo(path, static_cast<const char*>(mapping.get()), file_size, header, info);
+    return info;
+}
+
+MappedSketch Map(const std::string& path) {
+    size_t file_size;
+    auto mapping = MapFile(path, file_size);
+    const auto* bytes = static_cast<const char*>(mapping.get());
+    FileHeader header;
+    MappedSketch result;
+    auto& info = result.info;
+    const size_t offset = ParseInfo(path, bytes, file_size, header, info);
+
+    if (info.sample_encoding == SampleEncoding::DELTA) {
+        result.compressed_cells = MapDeltaEncodedSamples(path, bytes + offset, file_size - offset, header, mapping);
+        return result;
+    }
+    if (info.sample_encoding != SampleEncoding::RAW) {
+        throw std::runtime_error(path + " has an unknown sample encoding.");
+    }
+    const size_t cell_count = CellCount(path, header);
+    const size_t sample_size = info.sample_width == SampleWidth::BITS_32 ? sizeof(uint32_t) : sizeof(uint64_t);
+    const size_t index_size = (2 * cell_count + 1) * sizeof(uint64_t);
+    if (index_size > file_size - offset ||
+        header.sample_count > (file_size - offset - index_size) / sample_size) {
+        throw std::runtime_error(path + " is truncated.");
+    }
+    const auto* record_counts = reinterpret_cast<const uint64_t*>(bytes + offset);
+    const uint64_t* offsets = record_counts + cell_count;
+    if (offsets[cell_count] != header.sample_count) {
+        throw std::runtime_error(path + " is corrupted.");
+    }
+    CheckOffsets(path, offsets, cell_count, header.sample_count);
+    if (info.sample_width == SampleWidth::BITS_32) {
+        const auto* samples = reinterpret_cast<const uint32_t*>(offsets + cell_count + 1);
+        result.cells = CellArena::FromMemory(header.width, header.depth, header.min_hash_sketch_size, record_counts,
+                                             offsets, samples, std::move(mapping));
+    } else {
+        const uint64_t* samples = offsets + cell_count + 1;
+        result.cells = CellArena::FromMemory(header.width, header.depth, header.min_hash_sketch_size, record_counts,
+                                             offsets, samples, std::move(mapping));
+    }
+    return result;
+}
+
+bool HasFileExtension(const std::string& path) {
+    const std::string extension = FILE_EXTENSION;
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+}  // namespace sketch_file
+}  // namespace omnisketch
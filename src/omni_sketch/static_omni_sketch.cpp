@@ -0,0 +1,14 @@
+#include "omni_sketch/static_omni_sketch.hpp"
+
+namespace omnisketch {
+
+template class StaticOmniSketch<int32_t, 256, 3, 512>;
+template class StaticOmniSketch<size_t, 256, 3, 512>;
+template class StaticOmniSketch<double, 256, 3, 512>;
+template class StaticOmniSketch<std::string, 256, 3, 512>;
+template class StaticOmniSketch<int32_t, 16, 3, 32>;
+template class StaticOmniSketch<size_t, 16, 3, 32>;
+template class StaticOmniSketch<double, 16, 3, 32>;
+template class StaticOmniSketch<std::string, 16, 3, 32>;
+
+}  // namespace omnisketch
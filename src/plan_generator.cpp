@@ -155,6 +155,8 @@ std::unordered_map<std::string, std::shared_ptr<PlanExecItem>> PlanGenerator::Ad
 }
 
 double PlanGenerator::EstimateCardinality() const {
+    // All lookups of this estimate see the same sketches, even if they are replaced concurrently
+    Registry::SnapshotPin snapshot_pin;
     auto& registry = Registry::Get();
 
     auto exec_items = CreateInitialExecutionPlan();
@@ -196,6 +198,7 @@ double PlanGenerator::EstimateCardinality() const {
                 auto& fk_side_item = exec_items[fk_table_name];
 
                 exec_item->estimator->Finalize();
+                exec_item->estimator->CheckJoinKeys(table_name);
                 auto pk_probe_set = exec_item->estimator->ComputeResult(UINT64_MAX);
                 if (pk_probe_set->RecordCount() == 0) {
                     return 0;
@@ -212,6 +215,7 @@ double PlanGenerator::EstimateCardinality() const {
                 std::shared_ptr<PlanExecItem> item_to_probe_into = nullptr;
                 std::shared_ptr<PointOmniSketch> sketch_to_probe_into = nullptr;
                 exec_item->estimator->Finalize();
+                exec_item->estimator->CheckJoinKeys(table_name);
                 auto pk_probe_set = exec_item->estimator->ComputeResult(UINT64_MAX);
                 if (pk_probe_set->RecordCount() == 0) {
                     return 0;
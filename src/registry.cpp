@@ -1,12 +1,238 @@
 #include "registry.hpp"
 
+#include <cstring>
+#include <stdexcept>
+
 namespace omnisketch {
 
-Registry::Registry() = default;
+namespace {
+
+// Numeric bounds are stored bitwise, so that doubles and negative ints round-trip exactly
+template <typename T>
+void StoreBounds(const T& min, const T& max, sketch_file::SketchInfo& info) {
+    static_assert(sizeof(T) <= sizeof(uint64_t), "bounds must fit into 64 bits");
+    std::memcpy(&info.min_bits, &min, sizeof(T));
+    std::memcpy(&info.max_bits, &max, sizeof(T));
+}
+
+void StoreBounds(const std::string& min, const std::string& max, sketch_file::SketchInfo& info) {
+    info.min_string = min;
+    info.max_string = max;
+}
+
+template <typename T>
+void LoadBounds(const sketch_file::SketchInfo& info, T& min, T& max) {
+    std::memcpy(&min, &info.min_bits, sizeof(T));
+    std::memcpy(&max, &info.max_bits, sizeof(T));
+}
+
+void LoadBounds(const sketch_file::SketchInfo& info, std::string& min, std::string& max) {
+    min = info.min_string;
+    max = info.max_string;
+}
+
+template <template <typename> class SketchType, typename T>
+bool TryStoreTypeInfo(const std::shared_ptr<PointOmniSketch>& sketch, sketch_file::DataType data_type,
+                      sketch_file::SketchInfo& info) {
+    const auto typed_sketch = std::dynamic_pointer_cast<SketchType<T>>(sketch);
+    if (!typed_sketch) {
+        return false;
+    }
+    info.data_type = data_type;
+    StoreBounds(typed_sketch->GetMin(), typed_sketch->GetMax(), info);
+    return true;
+}
+
+template <template <typename> class SketchType>
+void StoreTypeInfo(const std::shared_ptr<PointOmniSketch>& sketch, sketch_file::SketchInfo& info) {
+    using sketch_file::DataType;
+    TryStoreTypeInfo<SketchType, size_t>(sketch, DataType::UINT, info) ||
+        TryStoreTypeInfo<SketchType, int32_t>(sketch, DataType::INT, info) ||
+        TryStoreTypeInfo<SketchType, double>(sketch, DataType::DOUBLE, info) ||
+        TryStoreTypeInfo<SketchType, std::string>(sketch, DataType::VARCHAR, info);
+}
+
+template <typename T>
+std::shared_ptr<TypedPointOmniSketch<T>> MakeSketch(TypedPointOmniSketch<T>*, const sketch_file::SketchInfo& info) {
+    return std::make_shared<TypedPointOmniSketch<T>>(info.width, info.depth, info.min_hash_sketch_size);
+}
+
+template <typename T>
+std::shared_ptr<PreJoinedOmniSketch<T>> MakeSketch(PreJoinedOmniSketch<T>*, const sketch_file::SketchInfo& info) {
+    return std::make_shared<PreJoinedOmniSketch<T>>(nullptr, info.width, info.depth, info.min_hash_sketch_size);
+}
+
+template <template <typename> class SketchType, typename T>
+std::shared_ptr<PointOmniSketch> CreateTypedSketch(const sketch_file::SketchInfo& info) {
+    auto sketch = MakeSketch(static_cast<SketchType<T>*>(nullptr), info);
+    T min;
+    T max;
+    LoadBounds(info, min, max);
+    sketch->SetMin(min);
+    sketch->SetMax(max);
+    return sketch;
+}
+
+template <template <typename> class SketchType>
+std::shared_ptr<PointOmniSketch> CreateSketch(const sketch_file::SketchInfo& info) {
+    switch (info.data_type) {
+    case sketch_file::DataType::UINT:
+        return CreateTypedSketch<SketchType, size_t>(info);
+    case sketch_file::DataType::INT:
+        return CreateTypedSketch<SketchType, int32_t>(info);
+    case sketch_file::DataType::DOUBLE:
+        return CreateTypedSketch<SketchType, double>(info);
+    case sketch_file::DataType::VARCHAR:
+        return CreateTypedSketch<SketchType, std::string>(info);
+    case sketch_file::DataType::NONE:
+        break;
+    }
+    throw std::runtime_error("Sketch file has an unknown data type.");
+}
+
+}  // namespace
+
+thread_local std::shared_ptr<const RegistrySnapshot> Registry::pinned_snapshot;
+
+Registry::Registry() : current_snapshot(std::make_shared<RegistrySnapshot>()) {
+}
 
 Registry& Registry::Get() {
     static Registry instance;
     return instance;
 }
 
+std::shared_ptr<const RegistrySnapshot> Registry::Snapshot() const {
+    if (pinned_snapshot) {
+        return pinned_snapshot;
+    }
+    return std::atomic_load(&current_snapshot);
+}
+
+Registry::SnapshotPin::SnapshotPin() : pinned(!pinned_snapshot) {
+    if (pinned) {
+        pinned_snapshot = std::atomic_load(&Registry::Get().current_snapshot);
+    }
+}
+
+Registry::SnapshotPin::~SnapshotPin() {
+    if (pinned) {
+        pinned_snapshot.reset();
+    }
+}
+
+void Registry::SetSketchDirectory(const std::string& path, ThreadPool& thread_pool) {
+    const auto sketch_files = SketchDirectory::ListSketchFiles(path);
+    std::vector<RegistrySnapshot> decoded(sketch_files.size());
+    thread_pool.ParallelFor(sketch_files.size(),
+                            [&](size_t file_idx) { DeserializeInto(sketch_files[file_idx], decoded[file_idx]); });
+
+    auto snapshot = std::make_shared<RegistrySnapshot>();
+    for (const auto& file_snapshot : decoded) {
+        snapshot->Merge(file_snapshot);
+    }
+    Publish(std::move(snapshot));
+}
+
+void Registry::SerializeBinary(const std::string& table_name, const std::string& column_name,
+                               const std::string& referencing_table_name, const std::string& path,
+                               sketch_file::SampleEncoding sample_encoding) {
+    auto& registry = Registry::Get();
+    sketch_file::SketchInfo info;
+    info.table_name = table_name;
+    info.sample_encoding = sample_encoding;
+
+    if (column_name.empty()) {
+        info.kind = sketch_file::SketchKind::RID_SAMPLE;
+        auto cell = registry.GetRidSample(table_name);
+        info.min_hash_sketch_size = cell->MaxSampleCount();
+        info.record_count = cell->RecordCount();
+        sketch_file::Write(path, info, *CellArena::FromCells({{cell}}, cell->MaxSampleCount()));
+        return;
+    }
+
+    std::shared_ptr<PointOmniSketch> sketch;
+    if (referencing_table_name.empty()) {
+        sketch = registry.GetOmniSketch(table_name, column_name);
+        info.kind = sketch_file::SketchKind::STANDARD;
+        StoreTypeInfo<TypedPointOmniSketch>(sketch, info);
+    } else {
+        sketch = registry.FindReferencingOmniSketch(table_name, column_name, referencing_table_name);
+        info.kind = sketch_file::SketchKind::PRE_JOINED;
+        info.referencing_table_name = referencing_table_name;
+        StoreTypeInfo<PreJoinedOmniSketch>(sketch, info);
+    }
+    CheckSerializable(*sketch);
+    info.column_name = column_name;
+    info.width = sketch->Width();
+    info.depth = sketch->Depth();
+    info.min_hash_sketch_size = sketch->MinHashSketchSize();
+    info.record_count = sketch->RecordCount();
+    info.null_count = sketch->CountNulls();
+
+    std::vector<std::vector<std::shared_ptr<OmniSketchCell>>> cells(sketch->Depth());
+    for (size_t row_idx = 0; row_idx < sketch->Depth(); row_idx++) {
+        cells[row_idx].reserve(sketch->Width());
+        for (size_t col_idx = 0; col_idx < sketch->Width(); col_idx++) {
+            cells[row_idx].push_back(std::make_shared<OmniSketchCell>(sketch->GetCell(row_idx, col_idx)));
+        }
+    }
+    sketch_file::Write(path, info, *CellArena::FromCells(cells, sketch->MinHashSketchSize()));
+}
+
+void Registry::CheckSerializable(const PointOmniSketch& sketch) {
+    if (sketch.BlockWidth() != sketch.Width()) {
+        throw std::logic_error("Sketches with a BlockedSplitHashMapper cannot be serialized, since their cells would "
+                               "be loaded with another mapper.");
+    }
+}
+
+void Registry::DeserializeBinaryInto(const std::string& path, RegistrySnapshot& snapshot) {
+    const auto mapped = sketch_file::Map(path);
+    const auto& info = mapped.info;
+
+    if (info.kind == sketch_file::SketchKind::RID_SAMPLE) {
+        snapshot.rid_sketches[info.table_name] = mapped.cells ? mapped.cells->GetCell(0) : mapped.compressed_cells[0];
+        return;
+    }
+
+    std::shared_ptr<PointOmniSketch> sketch;
+    if (info.kind == sketch_file::SketchKind::STANDARD) {
+        sketch = CreateSketch<TypedPointOmniSketch>(info);
+        snapshot.sketches[info.table_name][info.column_name].main_sketch = sketch;
+    } else if (info.kind == sketch_file::SketchKind::PRE_JOINED) {
+        sketch = CreateSketch<PreJoinedOmniSketch>(info);
+        snapshot.sketches[info.table_name][info.column_name].referencing_sketches[info.referencing_table_name] =
+            sketch;
+    } else {
+        throw std::runtime_error(path + " has an unknown sketch kind.");
+    }
+    if (mapped.cells) {
+        sketch->SetArena(mapped.cells);
+    } else if (info.sample_width == SampleWidth::BITS_32) {
+        // Decoded into 32-bit cells, so that the samples are still known to be truncated
+        std::vector<std::vector<std::shared_ptr<OmniSketchCell>>> cells(info.depth);
+        for (size_t row_idx = 0; row_idx < info.depth; row_idx++) {
+            for (size_t col_idx = 0; col_idx < info.width; col_idx++) {
+                const auto& compressed_cell = mapped.compressed_cells[row_idx * info.width + col_idx];
+                auto narrow_sketch = std::make_shared<MinHashSketchVector32>(info.min_hash_sketch_size);
+                narrow_sketch->Combine(*compressed_cell->GetMinHashSketch());
+                cells[row_idx].push_back(
+                    std::make_shared<OmniSketchCell>(std::move(narrow_sketch), compressed_cell->RecordCount()));
+            }
+        }
+        sketch->SetArena(CellArena::FromCells(cells, info.min_hash_sketch_size));
+    } else {
+        // Compressed cells stay compressed in memory, so the sketch is not flattened
+        for (size_t row_idx = 0; row_idx < info.depth; row_idx++) {
+            for (size_t col_idx = 0; col_idx < info.width; col_idx++) {
+                sketch->SetCell(row_idx, col_idx, mapped.compressed_cells[row_idx * info.width + col_idx]);
+            }
+        }
+    }
+    // AddNullValues also counts the nulls as records, record_count already includes them
+    sketch->AddNullValues(info.null_count);
+    sketch->SetRecordCount(info.record_count);
+}
+
 }  // namespace omnisketch
@@ -0,0 +1,243 @@
+#include "sketch_directory.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <stdexcept>
+
+#include "registry.hpp"
+
+namespace omnisketch {
+
+namespace {
+
+const std::string NAME_SEPARATOR = "__";
+const std::string RID_SAMPLE_NAME = "RIDS";
+
+bool HasExtension(const std::string& filename, const std::string& extension) {
+    return filename.size() >= extension.size() &&
+           filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+std::string StripExtension(const std::string& filename) {
+    return filename.substr(0, filename.rfind('.'));
+}
+
+std::vector<std::string> SplitName(const std::string& name) {
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    size_t end;
+    while ((end = name.find(NAME_SEPARATOR, begin)) != std::string::npos) {
+        parts.push_back(name.substr(begin, end - begin));
+        begin = end + NAME_SEPARATOR.size();
+    }
+    parts.push_back(name.substr(begin));
+    return parts;
+}
+
+}  // namespace
+
+SketchDirectory::SketchDirectory(const std::string& path, size_t memory_budget_p) : memory_budget(memory_budget_p) {
+    for (const auto& file_path : ListSketchFiles(path)) {
+        if (sketch_file::HasFileExtension(file_path)) {
+            struct stat file_stat;
+            IndexedFile indexed_file;
+            try {
+                indexed_file.info = sketch_file::ReadInfo(file_path);
+            } catch (const std::runtime_error& error) {
+                std::cerr << "Skipping sketch file: " << error.what() << std::endl;
+                continue;
+            }
+            if (stat(file_path.c_str(), &file_stat) == 0) {
+                indexed_file.byte_size = static_cast<size_t>(file_stat.st_size);
+            }
+            indexed_files.emplace(file_path, std::move(indexed_file));
+        }
+        const auto parts = SplitName(StripExtension(file_path.substr(file_path.rfind('/') + 1)));
+        if (parts.size() == 2 && parts[1] == RID_SAMPLE_NAME) {
+            rid_paths[parts[0]] = file_path;
+        } else if (parts.size() == 2) {
+            files[parts[0]][parts[1]].main_path = file_path;
+        } else if (parts.size() == 3) {
+            files[parts[0]][parts[1]].referencing_paths[parts[2]] = file_path;
+        } else {
+            std::cerr << "Skipping sketch file with unexpected name: " << file_path << std::endl;
+        }
+    }
+}
+
+bool SketchDirectory::HasOmniSketch(const std::string& table_name, const std::string& column_name) const {
+    const auto table_entry = files.find(table_name);
+    if (table_entry == files.end()) {
+        return false;
+    }
+    const auto column_entry = table_entry->second.find(column_name);
+    return column_entry != table_entry->second.end() && !column_entry->second.main_path.empty();
+}
+
+bool SketchDirectory::HasTable(const std::string& table_name) const {
+    return !FirstColumnName(table_name).empty();
+}
+
+std::shared_ptr<PointOmniSketch> SketchDirectory::FindOmniSketch(const std::string& table_name,
+                                                                 const std::string& column_name) {
+    if (!HasOmniSketch(table_name, column_name)) {
+        return nullptr;
+    }
+    return Load(files.at(table_name).at(column_name).main_path).sketch;
+}
+
+std::shared_ptr<PointOmniSketch> SketchDirectory::FindReferencingOmniSketch(const std::string& table_name,
+                                                                            const std::string& column_name,
+                                                                            const std::string& referencing_table_name) {
+    const auto table_entry = files.find(table_name);
+    if (table_entry == files.end()) {
+        return nullptr;
+    }
+    const auto column_entry = table_entry->second.find(column_name);
+    if (column_entry == table_entry->second.end()) {
+        return nullptr;
+    }
+    const auto& referencing_paths = column_entry->second.referencing_paths;
+    const auto referencing_path = referencing_paths.find(referencing_table_name);
+    return referencing_path == referencing_paths.end() ? nullptr : Load(referencing_path->second).sketch;
+}
+
+std::shared_ptr<OmniSketchCell> SketchDirectory::FindRidSample(const std::string& table_name) {
+    const auto rid_path = rid_paths.find(table_name);
+    return rid_path == rid_paths.end() ? nullptr : Load(rid_path->second).rid_sample;
+}
+
+std::string SketchDirectory::FirstColumnName(const std::string& table_name) const {
+    const auto table_entry = files.find(table_name);
+    if (table_entry == files.end()) {
+        return {};
+    }
+    for (const auto& column : table_entry->second) {
+        if (!column.second.main_path.empty()) {
+            return column.first;
+        }
+    }
+    return {};
+}
+
+const sketch_file::SketchInfo* SketchDirectory::FindFileInfo(const std::string& table_name,
+                                                             const std::string& column_name) const {
+    if (!HasOmniSketch(table_name, column_name)) {
+        return nullptr;
+    }
+    const auto indexed_file = indexed_files.find(files.at(table_name).at(column_name).main_path);
+    return indexed_file == indexed_files.end() ? nullptr : &indexed_file->second.info;
+}
+
+size_t SketchDirectory::LoadedSketchCount() const {
+    std::lock_guard<std::mutex> guard(cache_mutex);
+    return loaded_sketches.size();
+}
+
+size_t SketchDirectory::EstimateByteSize() const {
+    std::lock_guard<std::mutex> guard(cache_mutex);
+    return loaded_byte_size;
+}
+
+size_t SketchDirectory::IndexedByteSize() const {
+    size_t byte_size = 0;
+    for (const auto& indexed_file : indexed_files) {
+        byte_size += indexed_file.second.byte_size;
+    }
+    return byte_size;
+}
+
+SketchDirectory::LoadedSketch SketchDirectory::Load(const std::string& path) {
+    const auto indexed_file = indexed_files.find(path);
+    {
+        std::lock_guard<std::mutex> guard(cache_mutex);
+        auto cached = loaded_sketches.find(path);
+        if (cached != loaded_sketches.end()) {
+            lru.splice(lru.begin(), lru, cached->second.lru_position);
+            return cached->second;
+        }
+        if (indexed_file != indexed_files.end()) {
+            EvictColdSketches(indexed_file->second.byte_size);
+        }
+    }
+
+    // Read without holding the lock, so that other threads can use the cached sketches in the meantime. Two threads
+    // that miss the same path both read it, and the second one to finish uses the sketch of the first one.
+    LoadedSketch loaded = Read(path);
+    if (indexed_file != indexed_files.end()) {
+        loaded.byte_size = indexed_file->second.byte_size;
+    }
+
+    std::lock_guard<std::mutex> guard(cache_mutex);
+    auto cached = loaded_sketches.find(path);
+    if (cached != loaded_sketches.end()) {
+        lru.splice(lru.begin(), lru, cached->second.lru_position);
+        return cached->second;
+    }
+    lru.push_front(path);
+    loaded.lru_position = lru.begin();
+    loaded_byte_size += loaded.byte_size;
+    loaded_sketches.emplace(path, loaded);
+
+    EvictColdSketches();
+    return loaded;
+}
+
+SketchDirectory::LoadedSketch SketchDirectory::Read(const std::string& path) {
+    RegistrySnapshot snapshot;
+    Registry::DeserializeInto(path, snapshot);
+    LoadedSketch loaded;
+    if (!snapshot.rid_sketches.empty()) {
+        loaded.rid_sample = snapshot.rid_sketches.begin()->second;
+        loaded.byte_size = loaded.rid_sample->EstimateByteSize();
+    } else {
+        const auto& entry = snapshot.sketches.begin()->second.begin()->second;
+        loaded.sketch = entry.main_sketch ? entry.main_sketch : entry.referencing_sketches.begin()->second;
+        loaded.byte_size = loaded.sketch->EstimateByteSize();
+    }
+    return loaded;
+}
+
+void SketchDirectory::EvictColdSketches(size_t reserved_byte_size) {
+    // The most recently used sketch is only evicted to make room for another one, even if it exceeds the budget on its
+    // own
+    const size_t kept_sketch_count = reserved_byte_size == 0 ? 1 : 0;
+    while (memory_budget != 0 && loaded_byte_size + reserved_byte_size > memory_budget &&
+           lru.size() > kept_sketch_count) {
+        const auto evicted = loaded_sketches.find(lru.back());
+        loaded_byte_size -= evicted->second.byte_size;
+        loaded_sketches.erase(evicted);
+        lru.pop_back();
+    }
+}
+
+std::vector<std::string> SketchDirectory::ListSketchFiles(const std::string& path) {
+    std::vector<std::string> sketch_files;
+    DIR* dir = opendir(path.c_str());
+
+    if (dir == nullptr) {
+        std::cerr << "Could not open directory: " << path << std::endl;
+        return sketch_files;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN) {
+            std::string filename(entry->d_name);
+            if (HasExtension(filename, ".json") || HasExtension(filename, sketch_file::FILE_EXTENSION)) {
+                std::string full_path = path;
+                if (full_path.back() != '/') {
+                    full_path += '/';
+                }
+                full_path += filename;
+                sketch_files.push_back(full_path);
+            }
+        }
+    }
+    closedir(dir);
+    return sketch_files;
+}
+
+}  // namespace omnisketch
@@ -0,0 +1,297 @@
+#include "util/csv_reader.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define OMNISKETCH_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace omnisketch {
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 32;
+
+// Sets bit i if block[i] is a separator, newline, backslash, or quote
+uint32_t SpecialCharMaskScalar(const char* block, size_t size) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < size; i++) {
+        const char c = block[i];
+        if (c == ',' || c == '\n' || c == '\\' || c == '"') {
+            mask |= uint32_t(1) << i;
+        }
+    }
+    return mask;
+}
+
+#ifdef OMNISKETCH_X86_SIMD
+
+__attribute__((target("avx2"))) uint32_t SpecialCharMaskAVX2(const char* block) {
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i matches = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(','));
+    matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')));
+    matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')));
+    matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+}
+
+bool SupportsAVX2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+uint32_t SpecialCharMaskAVX2(const char* block) {
+    return SpecialCharMaskScalar(block, BLOCK_SIZE);
+}
+
+bool SupportsAVX2() {
+    return false;
+}
+
+#endif
+
+uint32_t SpecialCharMask(const char* block, size_t size) {
+    static const bool use_avx2 = SupportsAVX2();
+    return size == BLOCK_SIZE && use_avx2 ? SpecialCharMaskAVX2(block) : SpecialCharMaskScalar(block, size);
+}
+
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Powers of ten that are exactly representable as doubles
+constexpr double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+}  // namespace
+
+CSVReader::CSVReader(const std::string& path) : data(nullptr), size(0) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path + ".");
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat " + path + ".");
+    }
+    size = static_cast<size_t>(file_stat.st_size);
+    if (size == 0) {
+        close(fd);
+        return;
+    }
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + path + ".");
+    }
+    madvise(address, size, MADV_SEQUENTIAL);
+    const size_t mapped_size = size;
+    mapping = std::shared_ptr<const void>(
+        address, [mapped_size](const void* mapped) { munmap(const_cast<void*>(mapped), mapped_size); });
+    data = static_cast<const char*>(address);
+}
+
+size_t CSVReader::FileSize() const {
+    return size;
+}
+
+size_t CSVReader::FindLineStart(size_t offset) const {
+    if (offset == 0) {
+        return 0;
+    }
+    offset = std::min(offset, size);
+
+    // A newline only ends a logical line if it is not escaped, so start scanning before the run of backslashes that
+    // precedes offset - 1
+    size_t position = offset - 1;
+    while (position > 0 && data[position - 1] == '\\') {
+        position--;
+    }
+
+    bool escaping = false;
+    while (position < size) {
+        const char c = data[position++];
+        if (escaping) {
+            escaping = false;
+        } else if (c == '\\') {
+            escaping = true;
+        } else if (c == '\n' && position >= offset) {
+            return position;
+        }
+    }
+    return position;
+}
+
+bool CSVReader::ReadLine(size_t& position, size_t end, std::vector<CSVField>& fields) {
+    if (position >= std::min(end, size)) {
+        return false;
+    }
+
+    fields.clear();
+    const char* line_begin = data + position;
+    const char* file_end = data + size;
+    const char* field_begin = line_begin;
+    // Without a newline, the line ends at the end of the file
+    const char* line_end = file_end;
+    size_t next_position = size;
+    bool quoted = false;
+    bool line_complete = false;
+    // Set if the first character of the next block is escaped
+    uint32_t escaped_carry = 0;
+    for (const char* block = line_begin; block < file_end && !line_complete; block += BLOCK_SIZE) {
+        const size_t block_size = std::min<size_t>(BLOCK_SIZE, static_cast<size_t>(file_end - block));
+        uint32_t mask = SpecialCharMask(block, block_size) & ~escaped_carry;
+        escaped_carry = 0;
+        while (mask != 0) {
+            const auto char_idx = static_cast<size_t>(__builtin_ctz(mask));
+            mask &= mask - 1;
+            const char* c = block + char_idx;
+            if (*c == ',') {
+                fields.push_back(CSVField{field_begin, static_cast<size_t>(c - field_begin)});
+                field_begin = c + 1;
+            } else if (*c == '"') {
+                quoted = true;
+            } else if (*c == '\n') {
+                line_end = c;
+                next_position = static_cast<size_t>(c + 1 - data);
+                line_complete = true;
+                break;
+            } else if (c + 1 == file_end) {
+                // A trailing backslash escapes nothing and is dropped
+                line_end = c;
+                break;
+            } else if (c[1] == '\n' || c[1] == '\\') {
+                // Escaped newlines and backslashes are regular characters, other escaped characters keep their meaning
+                if (char_idx + 1 < BLOCK_SIZE) {
+                    mask &= ~(uint32_t(1) << (char_idx + 1));
+                } else {
+                    escaped_carry = 1;
+                }
+            }
+        }
+    }
+    position = next_position;
+
+    if (line_end == line_begin) {
+        // An unterminated empty line at the end of the file is no line
+        return line_complete;
+    }
+    if (quoted) {
+        SplitQuoted(line_begin, line_end, fields);
+    } else {
+        fields.push_back(CSVField{field_begin, static_cast<size_t>(line_end - field_begin)});
+    }
+    return true;
+}
+
+void CSVReader::SplitQuoted(const char* begin, const char* end, std::vector<CSVField>& fields) {
+    // The same as CSVImporter::Split(), which keeps the quotes if the line ends with one
+    const bool keep_quotes = end[-1] == '"';
+    unquoted_lines.emplace_back();
+    auto& line = unquoted_lines.back();
+    line.reserve(static_cast<size_t>(end - begin));
+    std::vector<size_t> field_ends;
+    bool in_escape = false;
+    for (const char* c = begin; c < end; c++) {
+        if (*c == '"') {
+            if (keep_quotes) {
+                line += *c;
+            }
+            in_escape = !in_escape;
+        } else if (*c == ',' && !in_escape) {
+            field_ends.push_back(line.size());
+        } else {
+            line += *c;
+        }
+    }
+    field_ends.push_back(line.size());
+
+    fields.clear();
+    size_t field_begin = 0;
+    for (const size_t field_end : field_ends) {
+        fields.push_back(CSVField{line.data() + field_begin, field_end - field_begin});
+        field_begin = field_end;
+    }
+}
+
+void CSVReader::ClearUnquotedLines() {
+    unquoted_lines.clear();
+}
+
+template <>
+std::string CSVReader::Parse<std::string>(const CSVField& field) {
+    return field.ToString();
+}
+
+template <>
+int32_t CSVReader::Parse<int32_t>(const CSVField& field) {
+    // Nine digits cannot overflow
+    const size_t digit_begin = field.size > 0 && field.data[0] == '-' ? 1 : 0;
+    if (field.size > digit_begin && field.size - digit_begin <= 9) {
+        int32_t value = 0;
+        size_t char_idx = digit_begin;
+        for (; char_idx < field.size && IsDigit(field.data[char_idx]); char_idx++) {
+            value = value * 10 + (field.data[char_idx] - '0');
+        }
+        if (char_idx == field.size) {
+            return digit_begin == 1 ? -value : value;
+        }
+    }
+    return std::stoi(field.ToString());
+}
+
+template <>
+size_t CSVReader::Parse<size_t>(const CSVField& field) {
+    // 19 digits cannot overflow
+    if (field.size > 0 && field.size <= 19) {
+        size_t value = 0;
+        size_t char_idx = 0;
+        for (; char_idx < field.size && IsDigit(field.data[char_idx]); char_idx++) {
+            value = value * 10 + static_cast<size_t>(field.data[char_idx] - '0');
+        }
+        if (char_idx == field.size) {
+            return value;
+        }
+    }
+    return std::stoul(field.ToString());
+}
+
+template <>
+double CSVReader::Parse<double>(const CSVField& field) {
+    // Decimals with at most 15 digits are an integer below 2^53 divided by an exact power of ten, so a single
+    // (correctly rounded) division yields the same double as std::stod()
+    size_t char_idx = field.size > 0 && field.data[0] == '-' ? 1 : 0;
+    const bool negative = char_idx == 1;
+    uint64_t mantissa = 0;
+    size_t digit_count = 0;
+    size_t fraction_digit_count = 0;
+    bool in_fraction = false;
+    for (; char_idx < field.size; char_idx++) {
+        const char c = field.data[char_idx];
+        if (IsDigit(c)) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+            digit_count++;
+            fraction_digit_count += in_fraction;
+        } else if (c == '.' && !in_fraction) {
+            in_fraction = true;
+        } else {
+            break;
+        }
+    }
+    if (char_idx == field.size && digit_count > 0 && digit_count <= 15) {
+        const double value = static_cast<double>(mantissa) / POWERS_OF_TEN[fraction_digit_count];
+        return negative ? -value : value;
+    }
+    return std::stod(field.ToString());
+}
+
+}  // namespace omnisketch
@@ -0,0 +1,135 @@
+#include "util/hash.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define OMNISKETCH_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace omnisketch {
+
+FastModulo32::FastModulo32(size_t divisor_p) {
+    assert(divisor_p > 0);
+    if (divisor_p > UINT32_MAX) {
+        // Every 32-bit x is its own remainder
+        return;
+    }
+    divisor = static_cast<uint32_t>(divisor_p);
+    if ((divisor & (divisor - 1)) == 0) {
+        mask = divisor - 1;
+        return;
+    }
+    // With l = ceil(log2(divisor)), multiplier = floor(2^32 * (2^l - divisor) / divisor) + 1, which fits 32 bits
+    const auto l = static_cast<uint32_t>(64 - __builtin_clzll(divisor - 1));
+    multiplier = static_cast<uint32_t>((((uint64_t(1) << l) - divisor) << 32) / divisor + 1);
+    shift = l - 1;
+}
+
+constexpr size_t BlockedSplitHashMapper::DEFAULT_BLOCK_WIDTH;
+
+BlockedSplitHashMapper::BlockedSplitHashMapper(size_t width_p, size_t block_width_p)
+    : CellIdxMapper(width_p), block_width(block_width_p),
+      block_count(block_width_p == 0 ? 0 : width_p / block_width_p) {
+    if (block_width == 0 || (block_width & (block_width - 1)) != 0 || width % block_width != 0) {
+        throw std::logic_error("The block width has to be a power of two that divides the width.");
+    }
+}
+
+namespace {
+
+#ifdef OMNISKETCH_X86_SIMD
+
+// The upper halves of the 32-bit products of the lanes of a and b
+__attribute__((target("avx2"))) inline __m256i MultiplyHigh(__m256i a, __m256i b) {
+    const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+// BarrettModSplitHashMapper::MapToColumn() for eight hashes
+__attribute__((target("avx2"))) void MapBlockAVX2(const uint64_t* hashes, size_t depth, const FastModulo32& modulo,
+                                                  size_t* col_idxs) {
+    static constexpr uint32_t PRIME = (1 << 19) - 1;
+    static constexpr uint64_t MU = UINT64_MAX / PRIME;
+
+    // Deinterleave the lower (h1) and upper (h2) halves of the hashes
+    const __m256i lower = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes));
+    const __m256i upper = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes + 4));
+    const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i lower_halves = _mm256_permutevar8x32_epi32(lower, order);
+    const __m256i upper_halves = _mm256_permutevar8x32_epi32(upper, order);
+    const __m256i h1 = _mm256_permute2x128_si256(lower_halves, upper_halves, 0x20);
+    const __m256i h2 = _mm256_permute2x128_si256(lower_halves, upper_halves, 0x31);
+
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME));
+    const __m256i mu_lower = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(MU)));
+    const __m256i mu_upper = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(MU >> 32)));
+    const __m256i divisor = _mm256_set1_epi32(static_cast<int>(modulo.Divisor()));
+    const __m256i multiplier = _mm256_set1_epi32(static_cast<int>(modulo.Multiplier()));
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(modulo.Shift()));
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(modulo.Mask()));
+
+    alignas(32) uint32_t row_cols[8];
+    for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+        const __m256i row_multiplier =
+            _mm256_set1_epi32(static_cast<int>(BarrettModSplitHashMapper::RowMultiplier(row_idx)));
+        const __m256i combined = _mm256_add_epi32(h1, _mm256_mullo_epi32(row_multiplier, h2));
+
+        // The (wrapping) 64-bit product combined * MU, shifted right by 32 and truncated to 32 bits
+        const __m256i quotient =
+            _mm256_add_epi32(MultiplyHigh(combined, mu_lower), _mm256_mullo_epi32(combined, mu_upper));
+        __m256i remainder = _mm256_sub_epi32(combined, _mm256_mullo_epi32(quotient, prime));
+        // Subtract the prime once from remainders >= prime (an unsigned comparison)
+        const __m256i at_least_prime = _mm256_cmpeq_epi32(_mm256_max_epu32(remainder, prime), remainder);
+        remainder = _mm256_sub_epi32(remainder, _mm256_and_si256(at_least_prime, prime));
+
+        __m256i cols;
+        if (modulo.Multiplier() == 0) {
+            cols = _mm256_and_si256(remainder, mask);
+        } else {
+            const __m256i t = MultiplyHigh(remainder, multiplier);
+            const __m256i q = _mm256_srl_epi32(
+                _mm256_add_epi32(t, _mm256_srli_epi32(_mm256_sub_epi32(remainder, t), 1)), shift);
+            cols = _mm256_sub_epi32(remainder, _mm256_mullo_epi32(q, divisor));
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(row_cols), cols);
+        for (size_t lane_idx = 0; lane_idx < 8; lane_idx++) {
+            col_idxs[lane_idx * depth + row_idx] = row_cols[lane_idx];
+        }
+    }
+}
+
+bool SupportsAVX2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+void MapBlockAVX2(const uint64_t*, size_t, const FastModulo32&, size_t*) {
+}
+
+bool SupportsAVX2() {
+    return false;
+}
+
+#endif
+
+}  // namespace
+
+void BarrettModSplitHashMapper::ComputeCellIdxs(const uint64_t* hashes, size_t count, size_t depth,
+                                                size_t* col_idxs) const {
+    static const bool use_avx2 = SupportsAVX2();
+    size_t hash_idx = 0;
+    if (use_avx2) {
+        for (; hash_idx + 8 <= count; hash_idx += 8) {
+            MapBlockAVX2(hashes + hash_idx, depth, width_modulo, col_idxs + hash_idx * depth);
+        }
+    }
+    for (; hash_idx < count; hash_idx++) {
+        BarrettModSplitHashMapper::ComputeCellIdxs(hashes[hash_idx], depth, col_idxs + hash_idx * depth);
+    }
+}
+
+}  // namespace omnisketch
@@ -0,0 +1,104 @@
+#include "util/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace omnisketch {
+
+struct ThreadPool::Job {
+    Job(size_t task_count_p, const std::function<void(size_t)>& task_p) : task_count(task_count_p), task(task_p) {
+    }
+
+    // Runs tasks until all of them have been claimed
+    void RunTasks() {
+        for (size_t task_idx = next_task++; task_idx < task_count; task_idx = next_task++) {
+            try {
+                task(task_idx);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+            }
+            std::lock_guard<std::mutex> guard(mutex);
+            if (++finished_count == task_count) {
+                finished.notify_all();
+            }
+        }
+    }
+
+    const size_t task_count;
+    const std::function<void(size_t)>& task;
+    std::atomic<size_t> next_task{0};
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t finished_count = 0;
+    std::exception_ptr exception;
+};
+
+ThreadPool::ThreadPool(size_t worker_count) {
+    workers.reserve(worker_count);
+    for (size_t worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job->RunTasks();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t task_count, const std::function<void(size_t)>& task) {
+    if (task_count == 0) {
+        return;
+    }
+
+    auto job = std::make_shared<Job>(task_count, task);
+    // The calling thread claims tasks as well, so at most task_count - 1 workers are needed
+    const size_t helper_count = std::min(task_count - 1, workers.size());
+    if (helper_count > 0) {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            jobs.insert(jobs.end(), helper_count, job);
+        }
+        job_available.notify_all();
+    }
+    job->RunTasks();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() { return job->finished_count == job->task_count; });
+    if (job->exception) {
+        std::rethrow_exception(job->exception);
+    }
+}
+
+ThreadPool& ThreadPool::Global() {
+    static ThreadPool pool(std::max<size_t>(std::thread::hardware_concurrency(), 1) - 1);
+    return pool;
+}
+
+}  // namespace omnisketch
@@ -124,3 +124,31 @@ TEST_F(CombinatorTestFixture, FilterProbeSet) {
     EXPECT_GE(result->RecordCount(), ((FK_SIDE_CARD / 2.0) / 8.0) * 6.0);
     EXPECT_GE(result->SampleCount(), 1);
 }
+
+TEST_F(CombinatorTestFixture, ParallelProbeSet) {
+    auto omni = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(64, 3, 32);
+    for (size_t i = 0; i < 10000; i++) {
+        omni->AddRecord(i % 500, i);
+    }
+    omni->Flatten();
+
+    omnisketch::ThreadPool serial_pool(0);
+    omnisketch::ThreadPool parallel_pool(3);
+    omnisketch::CombinedPredicateEstimator serial(32, serial_pool);
+    omnisketch::CombinedPredicateEstimator parallel(32, parallel_pool);
+    auto probe_range = omnisketch::PredicateConverter::ConvertRange((size_t)100, (size_t)131);
+    serial.AddPredicate(omni, probe_range);
+    parallel.AddPredicate(omni, probe_range);
+    serial.AddPredicate(omni, probe_range);
+    parallel.AddPredicate(omni, probe_range);
+
+    auto serial_result = serial.ComputeResult(SAMPLE_COUNT);
+    auto parallel_result = parallel.ComputeResult(SAMPLE_COUNT);
+    EXPECT_GT(parallel_result->RecordCount(), 0);
+    EXPECT_EQ(parallel_result->RecordCount(), serial_result->RecordCount());
+    ASSERT_EQ(parallel_result->SampleCount(), serial_result->SampleCount());
+    auto serial_it = serial_result->GetMinHashSketch()->Iterator();
+    for (auto it = parallel_result->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next(), serial_it->Next()) {
+        EXPECT_EQ(it->Current(), serial_it->Current());
+    }
+}
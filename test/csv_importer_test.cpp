@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include "include/csv_importer.hpp"
+#include "omni_sketch_test.hpp"
+
+TEST(CSVReaderTest, MatchesLogicalLinesAndSplit) {
+    // Random lines of separators, quotes, escapes, and newlines, checked against line reading and Split()
+    std::mt19937 gen(42);
+    const std::string alphabet = "abcdefghijklmnopqrstuvwxyz0123456789,,,,\"\\\\\\\n";
+    std::string content;
+    for (size_t char_idx = 0; char_idx < 50000; char_idx++) {
+        content += alphabet[gen() % alphabet.size()];
+    }
+    const std::string path = testing::TempDir() + "csv_reader.csv";
+    std::ofstream(path) << content;
+
+    std::vector<std::vector<std::string>> expected;
+    std::string line;
+    bool escaping = false;
+    for (const char c : content) {
+        if (escaping) {
+            line += '\\';
+            line += c;
+            escaping = false;
+        } else if (c == '\\') {
+            escaping = true;
+        } else if (c == '\n') {
+            expected.push_back(omnisketch::CSVImporter::Split(line));
+            line.clear();
+        } else {
+            line += c;
+        }
+    }
+    if (!line.empty()) {
+        expected.push_back(omnisketch::CSVImporter::Split(line));
+    }
+
+    omnisketch::CSVReader reader(path);
+    for (const size_t range_count : {1, 3, 7}) {
+        std::vector<std::vector<std::string>> lines;
+        std::vector<omnisketch::CSVField> fields;
+        for (size_t range_idx = 0; range_idx < range_count; range_idx++) {
+            size_t position = reader.FindLineStart(reader.FileSize() / range_count * range_idx);
+            const size_t end = reader.FindLineStart(reader.FileSize() / range_count * (range_idx + 1));
+            while (reader.ReadLine(position, end, fields)) {
+                lines.emplace_back();
+                for (const auto& field : fields) {
+                    lines.back().push_back(field.ToString());
+                }
+            }
+        }
+        EXPECT_EQ(lines, expected);
+        reader.ClearUnquotedLines();
+    }
+    std::remove(path.c_str());
+}
+
+TEST(CSVReaderTest, ParseLikeStandardConversions) {
+    std::mt19937_64 gen(42);
+    std::vector<std::string> ints = {"0", "-0", "7", "-2147483648", "2147483647", "+5", " 12"};
+    std::vector<std::string> uints = {"0", "7", "18446744073709551615", "0012", "+5"};
+    std::vector<std::string> doubles = {"0",   "-0",  "1.5",         "-.25", "3.", "1e5", "0.1", "123456789012345",
+                                        "1234567890123456", "0.000000000000001", "2147483648"};
+    for (size_t value_idx = 0; value_idx < 1000; value_idx++) {
+        ints.push_back(std::to_string(static_cast<int32_t>(gen())));
+        uints.push_back(std::to_string(gen()));
+        doubles.push_back(std::to_string(static_cast<double>(gen() % 100000000) / 1000));
+    }
+    auto to_field = [](const std::string& value) { return omnisketch::CSVField{value.data(), value.size()}; };
+    for (const auto& value : ints) {
+        EXPECT_EQ(omnisketch::CSVReader::Parse<int32_t>(to_field(value)), std::stoi(value)) << value;
+    }
+    for (const auto& value : uints) {
+        EXPECT_EQ(omnisketch::CSVReader::Parse<size_t>(to_field(value)), std::stoul(value)) << value;
+    }
+    for (const auto& value : doubles) {
+        EXPECT_EQ(omnisketch::CSVReader::Parse<double>(to_field(value)), std::stod(value)) << value;
+    }
+}
+
+TEST(CSVImporterTest, DictionaryCacheMatchesUncachedInsert) {
+    // A low-cardinality column, and one with more distinct values than the cache holds
+    for (const size_t distinct_count : {size_t(13), size_t(50000)}) {
+        std::vector<std::shared_ptr<omnisketch::TypedPointOmniSketch<std::string>>> sketches;
+        std::vector<omnisketch::InsertFunc> insert_funcs;
+        for (const bool use_cache : {true, false}) {
+            sketches.push_back(std::make_shared<omnisketch::TypedPointOmniSketch<std::string>>(16, 3, 32));
+            insert_funcs.push_back(
+                omnisketch::CSVImporter::CreateInsertFunc<std::string>(sketches.back(), {}, use_cache));
+        }
+
+        std::mt19937 gen(42);
+        std::vector<std::string> tokens(1024);
+        std::vector<omnisketch::CSVField> column(tokens.size());
+        std::vector<uint64_t> rids(tokens.size());
+        for (size_t chunk_idx = 0; chunk_idx < 20; chunk_idx++) {
+            for (size_t row_idx = 0; row_idx < tokens.size(); row_idx++) {
+                // Every 17th value is null
+                const size_t value = gen() % distinct_count;
+                tokens[row_idx] = value % 17 == 0 ? "" : "kind " + std::to_string(value);
+                column[row_idx] = omnisketch::CSVField{tokens[row_idx].data(), tokens[row_idx].size()};
+                rids[row_idx] = chunk_idx * tokens.size() + row_idx;
+            }
+            for (auto& insert_func : insert_funcs) {
+                insert_func(column, rids);
+            }
+        }
+
+        const auto& cached = *sketches[0];
+        const auto& uncached = *sketches[1];
+        EXPECT_EQ(cached.CountNulls(), uncached.CountNulls());
+        EXPECT_EQ(cached.GetMin(), uncached.GetMin());
+        EXPECT_EQ(cached.GetMax(), uncached.GetMax());
+        ExpectSameCells(cached, uncached);
+    }
+}
@@ -1,6 +1,14 @@
 #include <gtest/gtest.h>
 
 #include "include/min_hash_sketch/min_hash_sketch.hpp"
+#include "min_hash_sketch/min_hash_sketch_buffered.hpp"
+#include "min_hash_sketch/min_hash_sketch_compressed.hpp"
+#include "min_hash_sketch/min_hash_sketch_map.hpp"
+#include "min_hash_sketch/min_hash_sketch_span.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
+#include "min_hash_sketch/sorted_intersection.hpp"
+
+#include <random>
 #include "min_hash_sketch_test.hpp"
 
 using MinHashSketchSet = MinHashSketchTestFixture<omnisketch::MinHashSketchSet>;
@@ -133,4 +141,323 @@ TEST_F(MinHashSketchVec, MultiwayCombine) {
     auto combine_result = a->Combine({a, b, c});
     EXPECT_EQ(combine_result->MaxCount(), a->MaxCount());
     EXPECT_EQ(combine_result->Size(), a->Size());
-}
\ No newline at end of file
+}
+
+TEST_F(MinHashSketchSet, TypedIntersectionKernels) {
+    FillSketches();
+
+    // Every sketch is available as a set, vector, map, span, buffered sketch and a vector with an erased entry
+    auto as_all_types = [](const std::shared_ptr<omnisketch::MinHashSketch>& sketch) {
+        auto vector = std::dynamic_pointer_cast<omnisketch::MinHashSketchVector>(sketch->Flatten());
+        auto map = std::make_shared<omnisketch::MinHashSketchMap>(SKETCH_SIZE);
+        auto erased = std::make_shared<omnisketch::MinHashSketchVector>(
+            vector->Data(), std::make_unique<omnisketch::ValidityMask>(SKETCH_SIZE));
+        erased->EraseRecord(vector->Data().back());
+        for (const uint64_t hash : vector->Data()) {
+            map->AddRecord(hash, 1);
+        }
+        auto span = std::make_shared<omnisketch::MinHashSketchSpan>(vector->Data().data(), vector->Size(),
+                                                                    SKETCH_SIZE, vector);
+        auto buffered = std::make_shared<omnisketch::MinHashSketchBuffered>(SKETCH_SIZE);
+        buffered->Combine(*vector);
+        auto compressed = omnisketch::MinHashSketchCompressed::Compress(*vector);
+        return std::vector<std::shared_ptr<omnisketch::MinHashSketch>>{sketch, vector, map, span, buffered, erased,
+                                                                      compressed};
+    };
+    auto a_types = as_all_types(a);
+    auto b_types = as_all_types(b);
+    auto c_types = as_all_types(c);
+
+    auto collect = [](const std::shared_ptr<omnisketch::MinHashSketch>& sketch) {
+        std::vector<uint64_t> hashes;
+        for (auto it = sketch->Iterator(); !it->IsAtEnd(); it->Next()) {
+            hashes.push_back(it->Current());
+        }
+        return hashes;
+    };
+    auto reference = [&](std::vector<std::shared_ptr<omnisketch::MinHashSketch>> sketches) {
+        std::vector<uint64_t> result = collect(sketches.front());
+        for (size_t i = 1; i < sketches.size(); i++) {
+            auto other = collect(sketches[i]);
+            std::vector<uint64_t> tmp;
+            std::set_intersection(result.begin(), result.end(), other.begin(), other.end(), std::back_inserter(tmp));
+            result = std::move(tmp);
+        }
+        return result;
+    };
+
+    for (const auto& a_sketch : a_types) {
+        for (const auto& b_sketch : b_types) {
+            const std::vector<std::shared_ptr<omnisketch::MinHashSketch>> pair{a_sketch, b_sketch};
+            EXPECT_EQ(collect(omnisketch::MinHashSketchVector::ComputeIntersection(pair)), reference(pair));
+            for (const auto& c_sketch : c_types) {
+                const std::vector<std::shared_ptr<omnisketch::MinHashSketch>> triple{a_sketch, b_sketch, c_sketch};
+                EXPECT_EQ(collect(omnisketch::MinHashSketchVector::ComputeIntersection(triple)), reference(triple));
+            }
+        }
+    }
+}
+
+TEST(MinHashSketchBuffered, MatchesSet) {
+    constexpr size_t MAX_COUNT = 64;
+    std::mt19937_64 rng(7);
+    omnisketch::MinHashSketchBuffered buffered(MAX_COUNT);
+    omnisketch::MinHashSketchSet set(MAX_COUNT);
+    omnisketch::MinHashSketchBuffered other_buffered(MAX_COUNT);
+    omnisketch::MinHashSketchSet other_set(MAX_COUNT);
+
+    auto collect = [](const omnisketch::MinHashSketch& sketch) {
+        std::vector<uint64_t> hashes;
+        for (auto it = sketch.Iterator(); !it->IsAtEnd(); it->Next()) {
+            hashes.push_back(it->Current());
+        }
+        return hashes;
+    };
+
+    // Duplicates are inserted only once, just like in the set
+    for (size_t i = 0; i < 10000; i++) {
+        const uint64_t hash = rng() % 20000;
+        buffered.AddRecord(hash);
+        set.AddRecord(hash);
+        other_buffered.AddRecord(hash + 1);
+        other_set.AddRecord(hash + 1);
+        if (i == 10 || i == 5000) {
+            EXPECT_EQ(collect(buffered), collect(set));
+        }
+    }
+    EXPECT_EQ(buffered.Size(), MAX_COUNT);
+    EXPECT_EQ(collect(buffered), collect(set));
+
+    auto flattened = std::dynamic_pointer_cast<omnisketch::MinHashSketchVector>(buffered.Flatten());
+    ASSERT_TRUE(flattened);
+    EXPECT_EQ(flattened->Data(), collect(set));
+    EXPECT_EQ(collect(*buffered.Resize(MAX_COUNT / 2)), collect(*set.Resize(MAX_COUNT / 2)));
+
+    buffered.Combine(other_buffered);
+    set.Combine(other_set);
+    EXPECT_EQ(collect(buffered), collect(set));
+
+    const uint64_t erased_hash = collect(set)[3];
+    buffered.EraseRecord(erased_hash);
+    set.EraseRecord(erased_hash);
+    EXPECT_EQ(collect(buffered), collect(set));
+}
+
+TEST(MinHashSketchCompressed, RoundTripAndIntersect) {
+    std::mt19937_64 rng(11);
+    auto draw = [&](size_t count, uint64_t domain) {
+        std::set<uint64_t> values;
+        while (values.size() < count) {
+            values.insert(domain == 0 ? rng() : rng() % domain);
+        }
+        return std::vector<uint64_t>(values.begin(), values.end());
+    };
+    auto collect = [](const omnisketch::MinHashSketch& sketch) {
+        std::vector<uint64_t> hashes;
+        for (auto it = sketch.Iterator(); !it->IsAtEnd(); it->Next()) {
+            hashes.push_back(it->Current());
+        }
+        return hashes;
+    };
+
+    // Covers empty and partial blocks as well as bit widths from 1 up to 64
+    for (const size_t count : {0, 1, 2, 31, 32, 33, 100, 256}) {
+        for (const uint64_t domain : {uint64_t(0), uint64_t(1) << 40, uint64_t(512)}) {
+            const auto hashes = draw(std::min<uint64_t>(count, domain == 0 ? count : domain), domain);
+            omnisketch::MinHashSketchCompressed compressed(hashes.data(), hashes.size(), 256);
+            EXPECT_EQ(compressed.Size(), hashes.size());
+            EXPECT_EQ(collect(compressed), hashes);
+            EXPECT_EQ(collect(*compressed.Resize(20)),
+                      std::vector<uint64_t>(hashes.begin(), hashes.begin() + std::min<size_t>(20, hashes.size())));
+            EXPECT_THROW(compressed.AddRecord(1), std::logic_error);
+
+            for (size_t probe = 0; probe < 50 && !hashes.empty(); probe++) {
+                const uint64_t target = hashes[rng() % hashes.size()] + rng() % 3;
+                auto it = compressed.TypedIterator(hashes.size());
+                it.SeekGE(target);
+                const auto expected = std::lower_bound(hashes.begin(), hashes.end(), target);
+                ASSERT_EQ(it.IsAtEnd(), expected == hashes.end());
+                if (!it.IsAtEnd()) {
+                    EXPECT_EQ(it.Current(), *expected);
+                    EXPECT_EQ(it.CurrentIdx(), static_cast<size_t>(expected - hashes.begin()));
+                }
+            }
+        }
+    }
+
+    const std::vector<std::vector<uint64_t>> inputs{draw(1000, 4096), draw(300, 4096), draw(2000, 4096)};
+    std::vector<std::shared_ptr<omnisketch::MinHashSketch>> sketches;
+    for (const auto& input : inputs) {
+        sketches.push_back(std::make_shared<omnisketch::MinHashSketchCompressed>(input.data(), input.size(), 2000));
+    }
+    for (const size_t max_sample_count : {size_t(0), size_t(100), size_t(5000)}) {
+        const size_t limit = max_sample_count == 0 ? 2000 : max_sample_count;
+        std::vector<uint64_t> expected(inputs[0].begin(), inputs[0].begin() + std::min(limit, inputs[0].size()));
+        for (size_t i = 1; i < inputs.size(); i++) {
+            std::vector<uint64_t> tmp;
+            std::set_intersection(expected.begin(), expected.end(), inputs[i].begin(),
+                                  inputs[i].begin() + std::min(limit, inputs[i].size()), std::back_inserter(tmp));
+            expected = std::move(tmp);
+        }
+        EXPECT_EQ(collect(*sketches[0]->Intersect(sketches, max_sample_count)), expected);
+    }
+}
+
+TEST(SortedIntersection, KernelParity) {
+    namespace si = omnisketch::sorted_intersection;
+    std::mt19937_64 rng(42);
+
+    // Draws a sorted, duplicate-free sample of size count from [0, domain)
+    auto draw = [&](size_t count, uint64_t domain) {
+        std::set<uint64_t> values;
+        while (values.size() < count) {
+            values.insert(rng() % domain);
+        }
+        return std::vector<uint64_t>(values.begin(), values.end());
+    };
+
+    for (const size_t a_size : {0, 1, 3, 4, 7, 8, 9, 31, 64, 513, 1024}) {
+        for (const size_t b_size : {0, 1, 5, 8, 16, 100, 1024}) {
+            for (const uint64_t domain : {2048, 1 << 20}) {
+                const auto a = draw(a_size, domain);
+                const auto b = draw(b_size, domain);
+                std::vector<uint64_t> expected;
+                std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+                auto check = [&](size_t (*intersect)(const uint64_t*, size_t, const uint64_t*, size_t, uint64_t*)) {
+                    std::vector<uint64_t> out(std::min(a_size, b_size));
+                    out.resize(intersect(a.data(), a.size(), b.data(), b.size(), out.data()));
+                    EXPECT_EQ(out, expected);
+
+                    // The output may alias the first input
+                    auto in_place = a;
+                    in_place.resize(intersect(in_place.data(), in_place.size(), b.data(), b.size(), in_place.data()));
+                    EXPECT_EQ(in_place, expected);
+                };
+                check(si::IntersectScalar);
+                check(si::IntersectLinear);
+                check(si::IntersectGalloping);
+                check([](const uint64_t* a, size_t a_size, const uint64_t* b, size_t b_size, uint64_t* out) {
+                    return si::Intersect(a, a_size, b, b_size, out);
+                });
+                if (si::SupportsAVX2()) {
+                    check(si::IntersectAVX2);
+                }
+                if (si::SupportsAVX512()) {
+                    check(si::IntersectAVX512);
+                }
+            }
+        }
+    }
+
+    const std::vector<std::vector<uint64_t>> ranges{draw(1024, 4096), draw(512, 4096), draw(900, 4096), draw(64, 4096)};
+    std::vector<uint64_t> expected = ranges[0];
+    std::vector<const uint64_t*> offsets;
+    std::vector<const uint64_t*> ends;
+    for (const auto& range : ranges) {
+        std::vector<uint64_t> tmp;
+        std::set_intersection(expected.begin(), expected.end(), range.begin(), range.end(), std::back_inserter(tmp));
+        expected = std::move(tmp);
+        offsets.push_back(range.data());
+        ends.push_back(range.data() + range.size());
+    }
+    expected.insert(expected.begin(), 17);
+    for (const auto strategy : {omnisketch::IntersectionStrategy::ADAPTIVE, omnisketch::IntersectionStrategy::GALLOPING,
+                                omnisketch::IntersectionStrategy::LINEAR_MERGE}) {
+        std::vector<uint64_t> result{17};
+        si::IntersectMany(offsets, ends, result, strategy);
+        EXPECT_EQ(result, expected);
+    }
+}
+
+TEST(SortedIntersection, NarrowKernelParity) {
+    namespace si = omnisketch::sorted_intersection;
+    std::mt19937 rng(42);
+
+    auto draw = [&](size_t count, uint32_t domain) {
+        std::set<uint32_t> values;
+        while (values.size() < count) {
+            values.insert(static_cast<uint32_t>(rng() % domain));
+        }
+        return std::vector<uint32_t>(values.begin(), values.end());
+    };
+
+    for (const size_t a_size : {0, 1, 7, 8, 9, 16, 17, 64, 513}) {
+        for (const size_t b_size : {0, 1, 8, 16, 100, 1024}) {
+            // The second domain reaches into the upper half of the 32-bit range
+            for (const uint32_t domain : {2048u, 0xFFFFFFF0u}) {
+                const auto a = draw(a_size, domain);
+                const auto b = draw(b_size, domain);
+                std::vector<uint32_t> expected;
+                std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+                auto check = [&](size_t (*intersect)(const uint32_t*, size_t, const uint32_t*, size_t, uint32_t*)) {
+                    auto in_place = a;
+                    in_place.resize(intersect(in_place.data(), in_place.size(), b.data(), b.size(), in_place.data()));
+                    EXPECT_EQ(in_place, expected);
+                };
+                check(si::IntersectScalar);
+                check(si::IntersectLinear);
+                check(si::IntersectGalloping);
+                if (si::SupportsAVX2()) {
+                    check(si::IntersectAVX2);
+                }
+                if (si::SupportsAVX512()) {
+                    check(si::IntersectAVX512);
+                }
+            }
+        }
+    }
+}
+
+TEST(MinHashSketchVector32, TruncatedSamples) {
+    constexpr size_t MAX_COUNT = 64;
+    auto collect = [](const omnisketch::MinHashSketch& sketch) {
+        std::vector<uint64_t> hashes;
+        for (auto it = sketch.Iterator(); !it->IsAtEnd(); it->Next()) {
+            hashes.push_back(it->Current());
+        }
+        return hashes;
+    };
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> hashes(1000);
+    for (auto& hash : hashes) {
+        hash = rng();
+    }
+    // Two hashes that only differ in their lower half share a sample
+    hashes.push_back(hashes[0] ^ 1);
+
+    auto narrow = std::make_shared<omnisketch::MinHashSketchVector32>(MAX_COUNT);
+    auto wide = std::make_shared<omnisketch::MinHashSketchVector>(MAX_COUNT);
+    std::set<uint64_t> truncated;
+    for (const uint64_t hash : hashes) {
+        narrow->AddRecord(hash);
+        truncated.insert(omnisketch::TruncateHash(hash));
+    }
+    for (size_t hash_idx = 0; hash_idx < hashes.size(); hash_idx += 2) {
+        wide->AddRecord(hashes[hash_idx]);
+    }
+
+    const std::vector<uint64_t> expected(truncated.begin(), std::next(truncated.begin(), MAX_COUNT));
+    EXPECT_EQ(collect(*narrow), expected);
+    EXPECT_LT(narrow->EstimateByteSize(), wide->EstimateByteSize());
+
+    // Intersections with 64-bit sketches truncate them, whichever side starts
+    std::set<uint64_t> wide_truncated;
+    for (const uint64_t hash : collect(*wide)) {
+        wide_truncated.insert(omnisketch::TruncateHash(hash));
+    }
+    std::vector<uint64_t> expected_intersection;
+    std::set_intersection(expected.begin(), expected.end(), wide_truncated.begin(), wide_truncated.end(),
+                          std::back_inserter(expected_intersection));
+    EXPECT_FALSE(expected_intersection.empty());
+    const std::vector<std::shared_ptr<omnisketch::MinHashSketch>> sketches{narrow, wide};
+    EXPECT_EQ(collect(*narrow->Intersect(sketches)), expected_intersection);
+    EXPECT_EQ(collect(*wide->Intersect({wide, narrow})), expected_intersection);
+
+    auto combined = narrow->Combine({wide});
+    EXPECT_EQ(combined->Size(), MAX_COUNT);
+    for (const uint64_t hash : collect(*combined)) {
+        EXPECT_EQ(hash, omnisketch::TruncateHash(hash));
+    }
+}
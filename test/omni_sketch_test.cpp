@@ -1,7 +1,18 @@
 #include <gtest/gtest.h>
 
 #include "min_hash_sketch/min_hash_sketch_set.hpp"
+#include "min_hash_sketch/min_hash_sketch_vector32.hpp"
+#include "combinator.hpp"
+#include "omni_sketch/sketch_file.hpp"
 #include "omni_sketch/standard_omni_sketch.hpp"
+#include "omni_sketch/static_omni_sketch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include "omni_sketch_test.hpp"
 
 TEST(OmniSketchTest, BasicEstimation) {
     auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<int>>(4, 3, 8);
@@ -66,3 +77,631 @@ TEST(OmniSketchTest, GetAllRids) {
     auto intersection = control_sketch->Intersect({control_sketch, unfiltered_rids->GetMinHashSketch()});
     EXPECT_EQ(intersection->Size(), control_sketch->Size());
 }
+
+TEST(OmniSketchTest, FlattenIntoArena) {
+    auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    for (size_t i = 0; i < 5000; i++) {
+        sketch->AddRecord(i % 100, i);
+        control->AddRecord(i % 100, i);
+    }
+
+    const size_t byte_size_before = sketch->EstimateByteSize();
+    sketch->Flatten();
+    EXPECT_TRUE(sketch->IsFlattened());
+    EXPECT_LT(sketch->EstimateByteSize(), byte_size_before);
+
+    for (size_t row_idx = 0; row_idx < sketch->Depth(); row_idx++) {
+        for (size_t col_idx = 0; col_idx < sketch->Width(); col_idx++) {
+            const auto cell = sketch->GetCell(row_idx, col_idx);
+            const auto control_cell = control->GetCell(row_idx, col_idx);
+            EXPECT_EQ(cell.RecordCount(), control_cell.RecordCount());
+            EXPECT_EQ(cell.SampleCount(), control_cell.SampleCount());
+        }
+    }
+
+    for (size_t i = 0; i < 120; i++) {
+        auto card_est = sketch->Probe(i);
+        auto control_est = control->Probe(i);
+        EXPECT_EQ(card_est->RecordCount(), control_est->RecordCount());
+        EXPECT_EQ(card_est->SampleCount(), control_est->SampleCount());
+    }
+    EXPECT_EQ(sketch->GetRids()->SampleCount(), control->GetRids()->SampleCount());
+
+    // Inserting into a flattened sketch moves it back to individual cells
+    sketch->AddRecord(7, 5000);
+    control->AddRecord(7, 5000);
+    EXPECT_FALSE(sketch->IsFlattened());
+    EXPECT_EQ(sketch->Probe(7)->RecordCount(), control->Probe(7)->RecordCount());
+}
+
+TEST(OmniSketchTest, ProbeContext) {
+    auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    for (size_t i = 0; i < 5000; i++) {
+        sketch->AddRecord(i % 100, i);
+    }
+
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    omnisketch::ProbeContext context;
+    std::vector<std::shared_ptr<omnisketch::OmniSketchCell>> matches(sketch->Depth());
+    for (const bool flatten : {false, true}) {
+        if (flatten) {
+            sketch->Flatten();
+        }
+        for (size_t i = 0; i < 120; i++) {
+            for (const size_t max_samples : {0, 8}) {
+                const auto expected = sketch->ProbeHash(hf.Hash(i), matches, max_samples);
+                sketch->ProbeHash(hf.Hash(i), context, max_samples);
+                EXPECT_EQ(context.RecordCount(), expected->RecordCount());
+                EXPECT_EQ(context.SampleCount(), expected->SampleCount());
+
+                size_t n_max = 0;
+                for (const auto& match : matches) {
+                    n_max = std::max(n_max, match->RecordCount());
+                }
+                EXPECT_EQ(context.MaxRecordCount(), n_max);
+
+                const auto cell = context.ToCell();
+                auto expected_it = expected->GetMinHashSketch()->Iterator();
+                for (auto it = cell->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next(), expected_it->Next()) {
+                    ASSERT_FALSE(expected_it->IsAtEnd());
+                    EXPECT_EQ(it->Current(), expected_it->Current());
+                }
+            }
+        }
+    }
+}
+
+TEST(OmniSketchTest, AddRecordsBatched) {
+    auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    std::vector<size_t> values;
+    std::vector<uint64_t> rids;
+    for (size_t i = 0; i < 5000; i++) {
+        values.push_back((i * 7) % 100 + 3);
+        rids.push_back(i);
+        control->AddRecord(values.back(), i);
+    }
+
+    // Batches smaller than the width take the per-record path, larger ones are grouped by cell
+    size_t offset = 0;
+    for (const size_t batch_size : {1, 5, 2000, 16, 2978}) {
+        sketch->AddRecords(values.data() + offset, rids.data() + offset, batch_size);
+        offset += batch_size;
+    }
+    ASSERT_EQ(offset, values.size());
+
+    EXPECT_EQ(sketch->RecordCount(), control->RecordCount());
+    EXPECT_EQ(sketch->GetMin(), control->GetMin());
+    EXPECT_EQ(sketch->GetMax(), control->GetMax());
+    for (size_t row_idx = 0; row_idx < sketch->Depth(); row_idx++) {
+        for (size_t col_idx = 0; col_idx < sketch->Width(); col_idx++) {
+            const auto cell = sketch->GetCell(row_idx, col_idx);
+            const auto control_cell = control->GetCell(row_idx, col_idx);
+            EXPECT_EQ(cell.RecordCount(), control_cell.RecordCount());
+            auto control_it = control_cell.GetMinHashSketch()->Iterator();
+            for (auto it = cell.GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next(), control_it->Next()) {
+                ASSERT_FALSE(control_it->IsAtEnd());
+                EXPECT_EQ(it->Current(), control_it->Current());
+            }
+            EXPECT_TRUE(control_it->IsAtEnd());
+        }
+    }
+}
+
+TEST(OmniSketchTest, CombinePartials) {
+    auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    std::vector<std::shared_ptr<omnisketch::TypedPointOmniSketch<size_t>>> partials;
+    for (size_t partial_idx = 0; partial_idx < 3; partial_idx++) {
+        partials.push_back(std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32));
+    }
+    for (size_t i = 0; i < 3000; i++) {
+        const size_t value = (i * 13) % 500 + 7;
+        control->AddRecord(value, i);
+        partials[i / 1000]->AddRecord(value, i);
+    }
+    control->AddNullValues(5);
+    partials[1]->AddNullValues(5);
+
+    partials[0]->Combine(partials[1]);
+    partials[0]->Combine(partials[2]);
+    const auto& combined = partials[0];
+    EXPECT_EQ(combined->RecordCount(), control->RecordCount());
+    EXPECT_EQ(combined->CountNulls(), control->CountNulls());
+    EXPECT_EQ(combined->GetMin(), control->GetMin());
+    EXPECT_EQ(combined->GetMax(), control->GetMax());
+    for (size_t row_idx = 0; row_idx < combined->Depth(); row_idx++) {
+        for (size_t col_idx = 0; col_idx < combined->Width(); col_idx++) {
+            const auto cell = combined->GetCell(row_idx, col_idx);
+            const auto control_cell = control->GetCell(row_idx, col_idx);
+            EXPECT_EQ(cell.RecordCount(), control_cell.RecordCount());
+            auto control_it = control_cell.GetMinHashSketch()->Iterator();
+            for (auto it = cell.GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next(), control_it->Next()) {
+                ASSERT_FALSE(control_it->IsAtEnd());
+                EXPECT_EQ(it->Current(), control_it->Current());
+            }
+            EXPECT_TRUE(control_it->IsAtEnd());
+        }
+    }
+}
+
+TEST(OmniSketchTest, NarrowSamples) {
+    auto wide = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    auto narrow = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+        16, 3, 32, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+        std::make_shared<omnisketch::ProbeAllSum>(), std::make_shared<omnisketch::BarrettModSplitHashMapper>(16),
+        std::make_shared<omnisketch::MinHashSketchVector32::SketchFactory>());
+    for (size_t i = 0; i < 5000; i++) {
+        wide->AddRecord(i % 100, i);
+        narrow->AddRecord(i % 100, i);
+    }
+    EXPECT_EQ(narrow->GetSampleWidth(), omnisketch::SampleWidth::BITS_32);
+
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    omnisketch::ProbeContext context;
+    std::vector<std::shared_ptr<omnisketch::OmniSketchCell>> matches(narrow->Depth());
+    for (const bool flatten : {false, true}) {
+        if (flatten) {
+            wide->Flatten();
+            narrow->Flatten();
+            EXPECT_EQ(narrow->GetSampleWidth(), omnisketch::SampleWidth::BITS_32);
+            EXPECT_LT(narrow->EstimateByteSize(), wide->EstimateByteSize());
+        }
+        for (size_t i = 0; i < 120; i++) {
+            // Without collisions, the samples are the truncated ones of the 64-bit sketch
+            const auto expected = wide->ProbeHash(hf.Hash(i), matches);
+            narrow->ProbeHash(hf.Hash(i), context);
+            EXPECT_EQ(context.RecordCount(), expected->RecordCount());
+            std::vector<uint64_t> expected_samples;
+            for (auto it = expected->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
+                expected_samples.push_back(omnisketch::TruncateHash(it->Current()));
+            }
+            EXPECT_EQ(context.Samples(), expected_samples);
+            EXPECT_EQ(narrow->Probe(i)->RecordCount(), expected->RecordCount());
+        }
+    }
+}
+
+TEST(OmniSketchTest, RemoveAndUpdateRecords) {
+    for (const size_t max_sample_count : {16, 4096}) {
+        auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(4, 3, max_sample_count);
+        std::vector<size_t> values(2000);
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = i % 10;
+            sketch->AddRecord(values[i], i);
+        }
+        // Removals work on flattened sketches, too
+        sketch->Flatten();
+        std::vector<bool> removed(values.size(), false);
+        for (size_t i = 0; i < values.size(); i += 3) {
+            sketch->RemoveRecord(values[i], i);
+            removed[i] = true;
+        }
+        for (size_t i = 1; i < values.size(); i += 6) {
+            sketch->UpdateRecord(values[i], (values[i] + 1) % 10, i);
+            values[i] = (values[i] + 1) % 10;
+        }
+        if (max_sample_count == 16) {
+            EXPECT_GT(sketch->UnderfilledCellCount(), 0);
+            EXPECT_LT(sketch->MinSampleFill(), 1.0);
+        } else {
+            EXPECT_EQ(sketch->UnderfilledCellCount(), 0);
+        }
+        for (size_t i = values.size(); i < 2500; i++) {
+            values.push_back(i % 10);
+            removed.push_back(false);
+            sketch->AddRecord(values[i], i);
+        }
+
+        auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(4, 3, max_sample_count);
+        for (size_t i = 0; i < values.size(); i++) {
+            if (!removed[i]) {
+                control->AddRecord(values[i], i);
+            }
+        }
+        EXPECT_EQ(sketch->RecordCount(), control->RecordCount());
+        for (size_t row_idx = 0; row_idx < sketch->Depth(); row_idx++) {
+            for (size_t col_idx = 0; col_idx < sketch->Width(); col_idx++) {
+                const auto cell = sketch->GetCell(row_idx, col_idx);
+                const auto control_cell = control->GetCell(row_idx, col_idx);
+                EXPECT_EQ(cell.RecordCount(), control_cell.RecordCount());
+                // Underfilled cells keep the smallest record id hashes of the rebuilt cell
+                auto control_it = control_cell.GetMinHashSketch()->Iterator();
+                for (auto it = cell.GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next(), control_it->Next()) {
+                    ASSERT_FALSE(control_it->IsAtEnd());
+                    EXPECT_EQ(it->Current(), control_it->Current());
+                }
+                if (max_sample_count == 4096) {
+                    EXPECT_TRUE(control_it->IsAtEnd());
+                }
+            }
+        }
+    }
+}
+
+// Cell assignments have to stay the same, since they are part of serialized sketches
+class ReferenceBarrettMapper : public omnisketch::BarrettModSplitHashMapper {
+public:
+    using omnisketch::BarrettModSplitHashMapper::BarrettModSplitHashMapper;
+
+    size_t ReferenceCellIdx(uint64_t hash, size_t row_idx) const {
+        const auto hash_h1 = static_cast<uint32_t>(hash);
+        const auto hash_h2 = static_cast<uint32_t>(hash >> 32);
+        uint32_t combined = hash_h1 + (uint32_t)std::pow(row_idx + 7, 2) * hash_h2;
+        return BarrettReduction(combined) % width;
+    }
+};
+
+// String hashes decide the cells of string sketches, so they have to stay the same for serialized sketches
+TEST(OmniSketchTest, StringHashesAreStable) {
+    std::mt19937_64 gen(11);
+    std::string value;
+    for (size_t length = 0; length < 40; length++) {
+        const uint64_t hash = omnisketch::hash_functions::Hash(value);
+        EXPECT_EQ(omnisketch::hash_functions::HashBytes(value.data(), value.size()), hash);
+#ifdef __GLIBCXX__
+        // Strings were hashed with std::hash before
+        EXPECT_EQ(hash, std::hash<std::string>()(value));
+#endif
+        value.push_back(static_cast<char>(gen()));
+    }
+    EXPECT_EQ(omnisketch::hash_functions::Hash(std::string("omnisketch")), 0x1e2ff208df35159eULL);
+}
+
+TEST(OmniSketchTest, CellIdxMapperMatchesReference) {
+    std::mt19937_64 gen(7);
+    std::vector<uint64_t> hashes(1003);
+    for (auto& hash : hashes) {
+        hash = gen();
+    }
+    // Include hashes whose halves hit the edges of the Barrett reduction
+    hashes[0] = 0;
+    hashes[1] = UINT64_MAX;
+    hashes[2] = (uint64_t(524287) << 32) | 524287;
+
+    const size_t depth = 5;
+    for (const size_t width : {size_t(1), size_t(2), size_t(3), size_t(7), size_t(64), size_t(100), size_t(256),
+                               size_t(1000), size_t(4093), size_t(524287), size_t(524288), size_t(1) << 33}) {
+        ReferenceBarrettMapper mapper(width);
+        std::vector<size_t> batch_col_idxs(hashes.size() * depth);
+        mapper.ComputeCellIdxs(hashes.data(), hashes.size(), depth, batch_col_idxs.data());
+        std::vector<size_t> col_idxs(depth);
+        for (size_t hash_idx = 0; hash_idx < hashes.size(); hash_idx++) {
+            mapper.ComputeCellIdxs(hashes[hash_idx], depth, col_idxs.data());
+            for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+                const size_t expected = mapper.ReferenceCellIdx(hashes[hash_idx], row_idx);
+                ASSERT_EQ(col_idxs[row_idx], expected);
+                ASSERT_EQ(batch_col_idxs[hash_idx * depth + row_idx], expected);
+                ASSERT_EQ(mapper.ComputeCellIdx(hashes[hash_idx], row_idx), expected);
+            }
+        }
+    }
+
+    // The fast modulo is exact for every divisor
+    for (uint32_t divisor = 1; divisor < 2000; divisor++) {
+        const omnisketch::FastModulo32 modulo(divisor);
+        for (int i = 0; i < 100; i++) {
+            const auto x = static_cast<uint32_t>(gen());
+            ASSERT_EQ(modulo.Mod(x), x % divisor);
+        }
+        ASSERT_EQ(modulo.Mod(UINT32_MAX), UINT32_MAX % divisor);
+    }
+}
+
+TEST(OmniSketchTest, ConcurrentProbes) {
+    // Both sketches share one mapper, like the columns created from one OmniSketchConfig
+    const auto mapper = std::make_shared<omnisketch::BarrettModSplitHashMapper>(64);
+    std::vector<std::shared_ptr<omnisketch::TypedPointOmniSketch<size_t>>> sketches;
+    for (size_t sketch_idx = 0; sketch_idx < 2; sketch_idx++) {
+        auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+            64, 4, 32, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+            std::make_shared<omnisketch::ProbeAllSum>(), mapper);
+        for (size_t i = 0; i < 20000; i++) {
+            sketch->AddRecord((i * (sketch_idx + 1)) % 500, i);
+        }
+        sketches.push_back(std::move(sketch));
+    }
+    sketches[1]->Flatten();
+
+    const size_t value_count = 600;
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    auto samples_of = [](const std::shared_ptr<omnisketch::OmniSketchCell>& cell) {
+        std::vector<uint64_t> samples;
+        for (auto it = cell->GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next()) {
+            samples.push_back(it->Current());
+        }
+        return samples;
+    };
+    std::vector<std::vector<uint64_t>> expected;
+    for (const auto& sketch : sketches) {
+        for (size_t value = 0; value < value_count; value++) {
+            expected.push_back(samples_of(sketch->Probe(value)));
+        }
+    }
+
+    std::atomic<size_t> mismatches{0};
+    std::vector<std::thread> threads;
+    for (size_t thread_idx = 0; thread_idx < 8; thread_idx++) {
+        threads.emplace_back([&, thread_idx]() {
+            omnisketch::ProbeContext context;
+            for (size_t round = 0; round < 5; round++) {
+                for (size_t sketch_idx = 0; sketch_idx < sketches.size(); sketch_idx++) {
+                    for (size_t i = 0; i < value_count; i++) {
+                        // Threads walk the values in different orders
+                        const size_t value = (i * 7 + thread_idx * 31) % value_count;
+                        const auto& samples = expected[sketch_idx * value_count + value];
+                        if (samples_of(sketches[sketch_idx]->Probe(value)) != samples) {
+                            mismatches++;
+                        }
+                        sketches[sketch_idx]->ProbeHash(hf.Hash(value), context);
+                        if (context.Samples() != samples) {
+                            mismatches++;
+                        }
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches, 0);
+}
+
+template <size_t WIDTH, size_t DEPTH, size_t SAMPLE_COUNT>
+void CheckStaticSketch() {
+    using StaticSketch = omnisketch::StaticOmniSketch<size_t, WIDTH, DEPTH, SAMPLE_COUNT>;
+    auto sketch = std::make_shared<StaticSketch>();
+    auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(WIDTH, DEPTH, SAMPLE_COUNT);
+    auto other = std::make_shared<StaticSketch>();
+    auto other_control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(WIDTH, DEPTH, SAMPLE_COUNT);
+    for (size_t i = 0; i < 20000; i++) {
+        sketch->AddRecord(i % 300, i);
+        control->AddRecord(i % 300, i);
+        other->AddRecord(i % 50, i + 20000);
+        other_control->AddRecord(i % 50, i + 20000);
+    }
+    ExpectSameCells(*sketch, *control);
+
+    // Removals leave the same underfilled cells, which the following inserts and combinations respect
+    for (size_t i = 0; i < 20000; i += 3) {
+        sketch->RemoveRecord(i % 300, i);
+        control->RemoveRecord(i % 300, i);
+    }
+    for (size_t i = 20000; i < 21000; i++) {
+        sketch->AddRecord(i % 300, i);
+        control->AddRecord(i % 300, i);
+    }
+    ExpectSameCells(*sketch, *control);
+    sketch->Combine(other);
+    control->Combine(other_control);
+    ExpectSameCells(*sketch, *control);
+    EXPECT_EQ(sketch->GetMin(), control->GetMin());
+    EXPECT_EQ(sketch->GetMax(), control->GetMax());
+    EXPECT_EQ(sketch->EstimateAverageMatchesPerProbe(), control->EstimateAverageMatchesPerProbe());
+
+    omnisketch::ProbeContext context;
+    omnisketch::ProbeContext control_context;
+    for (size_t value = 0; value < 320; value++) {
+        sketch->Probe(value, context);
+        control->ProbeHash(omnisketch::hash_functions::Hash(value), control_context);
+        ASSERT_EQ(context.RecordCount(), control_context.RecordCount());
+        ASSERT_EQ(context.Samples(), control_context.Samples());
+        ASSERT_EQ(sketch->Probe(value)->RecordCount(), control->Probe(value)->RecordCount());
+    }
+    const auto values = omnisketch::ValueSet::FromRange<size_t>(10, 40);
+    EXPECT_EQ(sketch->ProbeValueSet(values)->RecordCount(), control->ProbeValueSet(values)->RecordCount());
+
+    // Static and dynamic sketches can be mixed in one estimation
+    auto probe_set = omnisketch::PredicateConverter::ConvertRange(5, 20);
+    omnisketch::CombinedPredicateEstimator mixed(SAMPLE_COUNT);
+    mixed.AddPredicate(sketch, probe_set);
+    mixed.AddPredicate(other_control, probe_set);
+    mixed.Finalize();
+    omnisketch::CombinedPredicateEstimator dynamic(SAMPLE_COUNT);
+    dynamic.AddPredicate(control, probe_set);
+    dynamic.AddPredicate(other_control, probe_set);
+    dynamic.Finalize();
+    EXPECT_EQ(mixed.ComputeResult(UINT64_MAX)->RecordCount(), dynamic.ComputeResult(UINT64_MAX)->RecordCount());
+
+    // Dynamic sketches contribute their bounds, too
+    auto larger_values = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(WIDTH, DEPTH, SAMPLE_COUNT);
+    for (size_t i = 0; i < 100; i++) {
+        larger_values->AddRecord(1000 + i, i + 30000);
+    }
+    sketch->Combine(larger_values);
+    control->Combine(larger_values);
+    ExpectSameCells(*sketch, *control);
+    EXPECT_EQ(sketch->GetMin(), control->GetMin());
+    EXPECT_EQ(sketch->GetMax(), 1099);
+}
+
+TEST(OmniSketchTest, StaticSketchMatchesDynamic) {
+    CheckStaticSketch<16, 3, 32>();
+    CheckStaticSketch<100, 4, 8>();
+
+    auto sketch = std::make_shared<omnisketch::StaticOmniSketch<size_t, 16, 3, 32>>();
+    EXPECT_THROW(sketch->Combine(std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 2, 32)),
+                 std::logic_error);
+}
+
+TEST(OmniSketchTest, CombineMixedSketchKinds) {
+    using StaticSketch = omnisketch::StaticOmniSketch<size_t, 16, 3, 32>;
+    // The same underfilled cells in a static and in a dynamic sketch
+    auto underfilled_static = std::make_shared<StaticSketch>();
+    auto underfilled_dynamic = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+    for (size_t i = 0; i < 20000; i++) {
+        underfilled_static->AddRecord(i % 300, i);
+        underfilled_dynamic->AddRecord(i % 300, i);
+    }
+    for (size_t i = 0; i < 20000; i += 3) {
+        underfilled_static->RemoveRecord(i % 300, i);
+        underfilled_dynamic->RemoveRecord(i % 300, i);
+    }
+    ASSERT_GT(underfilled_dynamic->UnderfilledCellCount(), 0);
+    for (size_t row_idx = 0; row_idx < 3; row_idx++) {
+        for (size_t col_idx = 0; col_idx < 16; col_idx++) {
+            ASSERT_EQ(underfilled_static->SampleThreshold(row_idx, col_idx),
+                      underfilled_dynamic->SampleThreshold(row_idx, col_idx));
+        }
+    }
+
+    // Either kind of sketch respects the sample thresholds of either kind of underfilled sketch
+    std::vector<std::shared_ptr<omnisketch::OmniSketch>> combined;
+    for (const bool is_static : {false, true}) {
+        for (const std::shared_ptr<omnisketch::OmniSketch>& underfilled :
+             std::vector<std::shared_ptr<omnisketch::OmniSketch>>{underfilled_static, underfilled_dynamic}) {
+            std::shared_ptr<omnisketch::OmniSketch> sketch = std::make_shared<StaticSketch>();
+            if (!is_static) {
+                sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 32);
+            }
+            for (size_t i = 0; i < 5000; i++) {
+                sketch->AddValueRecord(omnisketch::Value::From(i % 50), i + 20000);
+            }
+            sketch->Combine(underfilled);
+            combined.push_back(sketch);
+        }
+    }
+    for (const auto& sketch : combined) {
+        ExpectSameCells(*sketch, *combined[0]);
+        for (size_t row_idx = 0; row_idx < 3; row_idx++) {
+            for (size_t col_idx = 0; col_idx < 16; col_idx++) {
+                EXPECT_EQ(sketch->SampleThreshold(row_idx, col_idx), combined[0]->SampleThreshold(row_idx, col_idx));
+            }
+        }
+    }
+}
+
+TEST(OmniSketchTest, ProbeHashes) {
+    auto wide = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(64, 3, 32);
+    auto narrow = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+        64, 3, 32, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+        std::make_shared<omnisketch::ProbeAllSum>(), std::make_shared<omnisketch::BarrettModSplitHashMapper>(64),
+        std::make_shared<omnisketch::MinHashSketchVector32::SketchFactory>());
+    auto static_sketch = std::make_shared<omnisketch::StaticOmniSketch<size_t, 64, 3, 32>>();
+    for (size_t i = 0; i < 20000; i++) {
+        wide->AddRecord(i % 400, i);
+        narrow->AddRecord(i % 400, i);
+        static_sketch->AddRecord(i % 400, i);
+    }
+
+    // Enough hashes for whole blocks of the vectorized cell mapping and a remainder
+    const omnisketch::MurmurHashFunction<size_t> hf;
+    std::vector<uint64_t> hashes;
+    for (size_t value = 380; value < 425; value++) {
+        hashes.push_back(hf.Hash(value));
+    }
+    omnisketch::ProbeBatch batch;
+    omnisketch::ProbeContext context;
+    auto expect_same_probes = [&](const omnisketch::OmniSketch& sketch, size_t max_samples) {
+        // Probing a prefix first checks that the batch starts over
+        sketch.ProbeHashes(hashes.data(), 5, batch, max_samples);
+        sketch.ProbeHashes(hashes.data(), hashes.size(), batch, max_samples);
+        ASSERT_EQ(batch.Size(), hashes.size());
+        for (size_t probe_idx = 0; probe_idx < hashes.size(); probe_idx++) {
+            sketch.ProbeHash(hashes[probe_idx], context, max_samples);
+            EXPECT_EQ(batch.RecordCount(probe_idx), context.RecordCount());
+            EXPECT_EQ(batch.MaxRecordCount(probe_idx), context.MaxRecordCount());
+            ASSERT_EQ(batch.SampleCount(probe_idx), context.SampleCount());
+            EXPECT_TRUE(std::equal(batch.SamplesBegin(probe_idx), batch.SamplesEnd(probe_idx),
+                                   context.Samples().begin()));
+        }
+    };
+    for (const size_t max_samples : {0, 8}) {
+        expect_same_probes(*wide, max_samples);
+        expect_same_probes(*narrow, max_samples);
+        expect_same_probes(*static_sketch, max_samples);
+    }
+    wide->Flatten();
+    narrow->Flatten();
+    for (const size_t max_samples : {0, 8}) {
+        expect_same_probes(*wide, max_samples);
+        expect_same_probes(*narrow, max_samples);
+    }
+
+    wide->ProbeHashes(hashes.data(), 0, batch);
+    EXPECT_EQ(batch.Size(), 0);
+}
+
+TEST(OmniSketchTest, BlockedCellLayout) {
+    EXPECT_THROW(omnisketch::BlockedSplitHashMapper(64, 6), std::logic_error);
+    EXPECT_THROW(omnisketch::BlockedSplitHashMapper(60, 8), std::logic_error);
+
+    const size_t width = 64;
+    const size_t depth = 3;
+    const auto mapper = std::make_shared<omnisketch::BlockedSplitHashMapper>(width);
+    std::vector<size_t> col_idxs(depth);
+    for (size_t i = 0; i < 1000; i++) {
+        const uint64_t hash = omnisketch::hash_functions::Hash(i);
+        mapper->ComputeCellIdxs(hash, depth, col_idxs.data());
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            EXPECT_LT(col_idxs[row_idx], width);
+            EXPECT_EQ(col_idxs[row_idx] / mapper->BlockWidth(), col_idxs[0] / mapper->BlockWidth());
+            EXPECT_EQ(mapper->ComputeCellIdx(hash, row_idx), col_idxs[row_idx]);
+        }
+    }
+
+    for (const bool narrow : {false, true}) {
+        std::shared_ptr<omnisketch::MinHashSketch::SketchFactory> factory =
+            std::make_shared<omnisketch::MinHashSketchSet::SketchFactory>();
+        if (narrow) {
+            factory = std::make_shared<omnisketch::MinHashSketchVector32::SketchFactory>();
+        }
+        auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+            width, depth, 16, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+            std::make_shared<omnisketch::ProbeAllSum>(), mapper, factory);
+        for (size_t i = 0; i < 10000; i++) {
+            sketch->AddRecord(i % 300, i);
+        }
+        std::vector<std::vector<std::shared_ptr<omnisketch::OmniSketchCell>>> cells(depth);
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            for (size_t col_idx = 0; col_idx < width; col_idx++) {
+                cells[row_idx].push_back(
+                    std::make_shared<omnisketch::OmniSketchCell>(sketch->GetCell(row_idx, col_idx)));
+            }
+        }
+        std::vector<size_t> record_counts;
+        omnisketch::ProbeContext context;
+        std::vector<std::vector<uint64_t>> samples;
+        for (size_t value = 0; value < 320; value++) {
+            sketch->ProbeHash(omnisketch::hash_functions::Hash(value), context);
+            record_counts.push_back(context.RecordCount());
+            samples.push_back(context.Samples());
+        }
+
+        // The blocked arena holds the same cells, and the cells of a hash lie within depth * block width cells
+        sketch->Flatten();
+        for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+            for (size_t col_idx = 0; col_idx < width; col_idx++) {
+                const auto cell = sketch->GetCell(row_idx, col_idx);
+                ASSERT_EQ(cell.RecordCount(), cells[row_idx][col_idx]->RecordCount());
+                ASSERT_EQ(cell.SampleCount(), cells[row_idx][col_idx]->SampleCount());
+            }
+        }
+        for (size_t value = 0; value < 320; value++) {
+            sketch->ProbeHash(omnisketch::hash_functions::Hash(value), context);
+            EXPECT_EQ(context.RecordCount(), record_counts[value]);
+            EXPECT_EQ(context.Samples(), samples[value]);
+        }
+
+        const auto arena = omnisketch::CellArena::FromCells(cells, 16, mapper->BlockWidth());
+        EXPECT_EQ(arena->BlockWidth(), mapper->BlockWidth());
+        for (size_t i = 0; i < 1000; i++) {
+            mapper->ComputeCellIdxs(omnisketch::hash_functions::Hash(i), depth, col_idxs.data());
+            size_t min_cell_idx = arena->CellCount();
+            size_t max_cell_idx = 0;
+            for (size_t row_idx = 0; row_idx < depth; row_idx++) {
+                const size_t cell_idx = arena->CellIdx(row_idx, col_idxs[row_idx]);
+                EXPECT_EQ(arena->RecordCount(cell_idx), cells[row_idx][col_idxs[row_idx]]->RecordCount());
+                min_cell_idx = std::min(min_cell_idx, cell_idx);
+                max_cell_idx = std::max(max_cell_idx, cell_idx);
+            }
+            EXPECT_LT(max_cell_idx - min_cell_idx, depth * mapper->BlockWidth());
+        }
+        // Sketch files are laid out row by row
+        omnisketch::sketch_file::SketchInfo info;
+        info.width = width;
+        info.depth = depth;
+        EXPECT_THROW(omnisketch::sketch_file::Write("blocked.omni", info, *arena), std::logic_error);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+// Expects both sketches to hold the same records and the same samples in every cell. With allow_underfilled, a cell
+// of sketch may hold fewer samples than the control cell, as long as they are its smallest ones.
+template <typename Sketch, typename ControlSketch>
+void ExpectSameCells(const Sketch& sketch, const ControlSketch& control, bool allow_underfilled = false) {
+    ASSERT_EQ(sketch.RecordCount(), control.RecordCount());
+    for (size_t row_idx = 0; row_idx < control.Depth(); row_idx++) {
+        for (size_t col_idx = 0; col_idx < control.Width(); col_idx++) {
+            const auto cell = sketch.GetCell(row_idx, col_idx);
+            const auto control_cell = control.GetCell(row_idx, col_idx);
+            ASSERT_EQ(cell.RecordCount(), control_cell.RecordCount());
+            if (allow_underfilled) {
+                ASSERT_LE(cell.SampleCount(), control_cell.SampleCount());
+            } else {
+                ASSERT_EQ(cell.SampleCount(), control_cell.SampleCount());
+            }
+            auto control_it = control_cell.GetMinHashSketch()->Iterator();
+            for (auto it = cell.GetMinHashSketch()->Iterator(); !it->IsAtEnd(); it->Next(), control_it->Next()) {
+                ASSERT_EQ(it->Current(), control_it->Current());
+            }
+        }
+    }
+}
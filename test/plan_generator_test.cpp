@@ -43,3 +43,39 @@ TEST(PlanGeneratorTest, StarShape) {
     auto result_2 = combinator_fact->ComputeResult(UINT64_MAX);
     EXPECT_EQ(result, result_2->RecordCount());
 }
+
+TEST(PlanGeneratorTest, NarrowSampleJoins) {
+    const size_t FACT_TABLE_SIZE = 1000;
+    const size_t DIM_TABLE_SIZE = 500;
+
+    auto& registry = omnisketch::Registry::Get();
+    omnisketch::OmniSketchConfig narrow_config;
+    narrow_config.SetSampleWidth(omnisketch::SampleWidth::BITS_32);
+    // Tables prefixed with "narrow" have 32-bit samples
+    auto fact_fk = registry.CreateOmniSketch<size_t>("fact_64", "fk");
+    auto narrow_fact_fk = registry.CreateOmniSketch<size_t>("narrow_fact", "fk", narrow_config);
+    auto dim_att = registry.CreateOmniSketch<size_t>("dim_64", "att");
+    auto narrow_dim_att = registry.CreateOmniSketch<size_t>("narrow_dim", "att", narrow_config);
+    for (size_t i = 0; i < FACT_TABLE_SIZE; i++) {
+        fact_fk->AddRecord(i % DIM_TABLE_SIZE, i);
+        narrow_fact_fk->AddRecord(i % DIM_TABLE_SIZE, i);
+    }
+    for (size_t i = 0; i < DIM_TABLE_SIZE; i++) {
+        dim_att->AddRecord(i, i);
+        narrow_dim_att->AddRecord(i, i);
+    }
+    auto estimate = [](const std::string& fact_table_name, const std::string& dim_table_name) {
+        omnisketch::PlanGenerator gen;
+        gen.AddPredicate(dim_table_name, "att", omnisketch::PredicateConverter::ConvertRange(0, 249));
+        gen.AddJoin(fact_table_name, "fk", dim_table_name);
+        return gen.EstimateCardinality();
+    };
+
+    const double expected = estimate("fact_64", "dim_64");
+    EXPECT_GT(expected, 0);
+    // The record ids of the foreign key side are not probed, so they may be truncated
+    EXPECT_EQ(estimate("narrow_fact", "dim_64"), expected);
+    // Truncated primary keys would be probed into the wrong cells of the foreign key sketch
+    EXPECT_THROW(estimate("fact_64", "narrow_dim"), std::runtime_error);
+    EXPECT_THROW(estimate("narrow_fact", "narrow_dim"), std::runtime_error);
+}
@@ -0,0 +1,601 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/batch_importer.hpp"
+#include "include/csv_importer.hpp"
+#include "include/registry.hpp"
+#include "min_hash_sketch/min_hash_sketch_compressed.hpp"
+#include "omni_sketch_test.hpp"
+
+namespace {
+
+// Replaces the table with one that only has the column "att"
+void ReplaceWithColumn(const std::string& table_name, const std::shared_ptr<omnisketch::PointOmniSketch>& sketch,
+                       std::shared_ptr<omnisketch::OmniSketchCell> rids = nullptr) {
+    if (!rids) {
+        rids = std::make_shared<omnisketch::OmniSketchCell>(sketch->MinHashSketchSize());
+    }
+    omnisketch::Registry::Get().ReplaceTable(
+        table_name, omnisketch::TableEntry{{"att", omnisketch::OmniSketchEntry{sketch, {}}}}, std::move(rids));
+}
+
+// Reads the sketch of the column "att" from the file, without registering it
+template <typename T>
+std::shared_ptr<omnisketch::TypedPointOmniSketch<T>> ReadColumn(const std::string& path) {
+    omnisketch::RegistrySnapshot snapshot;
+    omnisketch::Registry::DeserializeInto(path, snapshot);
+    return std::dynamic_pointer_cast<omnisketch::TypedPointOmniSketch<T>>(
+        snapshot.sketches.begin()->second.at("att").main_sketch);
+}
+
+} // namespace
+
+TEST(RegistryTest, ReplaceTableWhileReading) {
+    auto& registry = omnisketch::Registry::Get();
+    auto create_table = [](size_t record_count) {
+        auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 16);
+        for (size_t i = 0; i < record_count; i++) {
+            sketch->AddRecord(i % 10, i);
+        }
+        sketch->Flatten();
+        return omnisketch::TableEntry{{"att", omnisketch::OmniSketchEntry{sketch, {}}}};
+    };
+    registry.ReplaceTable("replaced", create_table(100), std::make_shared<omnisketch::OmniSketchCell>(16));
+
+    {
+        // A pinned snapshot keeps the sketches that were current when it was taken
+        omnisketch::Registry::SnapshotPin snapshot_pin;
+        registry.ReplaceTable("replaced", create_table(200), std::make_shared<omnisketch::OmniSketchCell>(16));
+        EXPECT_EQ(registry.GetBaseTableCard("replaced"), 100);
+        EXPECT_EQ(registry.GetOmniSketch("replaced", "att")->RecordCount(), 100);
+    }
+    EXPECT_EQ(registry.GetBaseTableCard("replaced"), 200);
+    EXPECT_FALSE(registry.HasOmniSketch("replaced", "missing"));
+    EXPECT_FALSE(registry.HasOmniSketch("missing", "att"));
+
+    // Readers only ever see complete tables while another thread keeps replacing them
+    std::atomic<bool> done{false};
+    std::atomic<size_t> invalid_reads{0};
+    std::vector<std::thread> readers;
+    for (size_t reader_idx = 0; reader_idx < 3; reader_idx++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                omnisketch::Registry::SnapshotPin snapshot_pin;
+                const size_t card = registry.GetBaseTableCard("replaced");
+                const auto sketch = registry.GetOmniSketch("replaced", "att");
+                if (card % 100 != 0 || sketch->RecordCount() != card) {
+                    invalid_reads++;
+                }
+            }
+        });
+    }
+    for (size_t update_idx = 0; update_idx < 200; update_idx++) {
+        registry.ReplaceTable("replaced", create_table(100 * (update_idx % 5 + 1)),
+                              std::make_shared<omnisketch::OmniSketchCell>(16));
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(invalid_reads, 0);
+}
+
+TEST(RegistryTest, BinaryRoundTrip) {
+    auto& registry = omnisketch::Registry::Get();
+    auto original = std::make_shared<omnisketch::TypedPointOmniSketch<double>>(8, 3, 16);
+    for (size_t i = 0; i < 1000; i++) {
+        original->AddRecord(static_cast<double>(i % 50) - 10.5, i);
+    }
+    original->AddNullValues(7);
+    original->Flatten();
+    auto rids = std::make_shared<omnisketch::OmniSketchCell>(16);
+    for (size_t i = 0; i < 1000; i++) {
+        rids->AddRecord(i);
+    }
+    const std::string sketch_path = testing::TempDir() + "binary__att.omni";
+    const std::string rid_path = testing::TempDir() + "binary__RIDS.omni";
+    for (const auto sample_encoding :
+         {omnisketch::sketch_file::SampleEncoding::RAW, omnisketch::sketch_file::SampleEncoding::DELTA}) {
+        ReplaceWithColumn("binary", original, rids);
+        omnisketch::Registry::SerializeBinary("binary", "att", {}, sketch_path, sample_encoding);
+        omnisketch::Registry::SerializeBinary("binary", {}, {}, rid_path, sample_encoding);
+        registry.Deserialize(sketch_path);
+        registry.Deserialize(rid_path);
+
+        const auto loaded = registry.GetOmniSketchTyped<double>("binary", "att");
+        ASSERT_NE(loaded, original);
+        // Raw samples are used in place, delta-encoded ones stay compressed
+        EXPECT_EQ(loaded->IsFlattened(), sample_encoding == omnisketch::sketch_file::SampleEncoding::RAW);
+        EXPECT_EQ(loaded->RecordCount(), original->RecordCount());
+        EXPECT_EQ(loaded->CountNulls(), 7);
+        EXPECT_EQ(loaded->GetMin(), -10.5);
+        EXPECT_EQ(loaded->GetMax(), 38.5);
+        for (size_t row_idx = 0; row_idx < original->Depth(); row_idx++) {
+            for (size_t col_idx = 0; col_idx < original->Width(); col_idx++) {
+                const auto expected = original->GetCell(row_idx, col_idx);
+                const auto actual = loaded->GetCell(row_idx, col_idx);
+                EXPECT_EQ(actual.RecordCount(), expected.RecordCount());
+                EXPECT_EQ(actual.SampleCount(), expected.SampleCount());
+            }
+        }
+        for (double value : {-10.5, 0.0, 12.5}) {
+            EXPECT_EQ(loaded->Probe(value)->RecordCount(), original->Probe(value)->RecordCount());
+            EXPECT_EQ(loaded->Probe(value)->SampleCount(), original->Probe(value)->SampleCount());
+        }
+        const auto loaded_rids = registry.GetRidSample("binary");
+        EXPECT_EQ(loaded_rids->RecordCount(), 1000);
+        EXPECT_EQ(loaded_rids->SampleCount(), rids->SampleCount());
+    }
+
+    std::remove(sketch_path.c_str());
+    std::remove(rid_path.c_str());
+}
+
+TEST(RegistryTest, NarrowSampleRoundTrip) {
+    auto original = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+        8, 3, 16, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+        std::make_shared<omnisketch::ProbeAllSum>(), std::make_shared<omnisketch::BarrettModSplitHashMapper>(8),
+        std::make_shared<omnisketch::MinHashSketchVector32::SketchFactory>());
+    for (size_t i = 0; i < 1000; i++) {
+        original->AddRecord(i % 50, i);
+    }
+    original->Flatten();
+    EXPECT_EQ(original->GetSampleWidth(), omnisketch::SampleWidth::BITS_32);
+
+    const std::string json_path = testing::TempDir() + "narrow__att.json";
+    const std::string raw_path = testing::TempDir() + "narrow__att.omni";
+    const std::string delta_path = testing::TempDir() + "narrow_delta__att.omni";
+    ReplaceWithColumn("narrow", original);
+    omnisketch::Registry::Serialize("narrow", "att", {}, json_path);
+    omnisketch::Registry::SerializeBinary("narrow", "att", {}, raw_path, omnisketch::sketch_file::SampleEncoding::RAW);
+    omnisketch::Registry::SerializeBinary("narrow", "att", {}, delta_path,
+                                          omnisketch::sketch_file::SampleEncoding::DELTA);
+
+    for (const auto& path : {json_path, raw_path, delta_path}) {
+        const auto loaded = ReadColumn<size_t>(path);
+        ASSERT_NE(loaded, nullptr);
+        EXPECT_EQ(loaded->GetSampleWidth(), omnisketch::SampleWidth::BITS_32);
+        EXPECT_EQ(loaded->RecordCount(), original->RecordCount());
+        for (size_t value : {0, 7, 49}) {
+            const auto expected = original->ProbeValue(omnisketch::Value::From(value));
+            const auto actual = loaded->ProbeValue(omnisketch::Value::From(value));
+            EXPECT_EQ(actual->RecordCount(), expected->RecordCount());
+            EXPECT_EQ(actual->SampleCount(), expected->SampleCount());
+        }
+        std::remove(path.c_str());
+    }
+}
+
+TEST(RegistryTest, ModifyDeltaEncodedSketch) {
+    auto original = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(8, 3, 64);
+    auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(8, 3, 64);
+    auto other = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(8, 3, 64);
+    for (size_t i = 0; i < 1000; i++) {
+        original->AddRecord(i % 50, i);
+        control->AddRecord(i % 50, i);
+        other->AddRecord(i % 30, i + 2000);
+    }
+    const std::string path = testing::TempDir() + "delta_write__att.omni";
+    ReplaceWithColumn("delta_write", original);
+    omnisketch::Registry::SerializeBinary("delta_write", "att", {}, path,
+                                          omnisketch::sketch_file::SampleEncoding::DELTA);
+    auto loaded = ReadColumn<size_t>(path);
+    std::remove(path.c_str());
+    ASSERT_NE(loaded, nullptr);
+
+    // The compressed cells are decoded on the first change
+    for (size_t i = 1000; i < 1200; i++) {
+        loaded->AddRecord(i % 50, i);
+        control->AddRecord(i % 50, i);
+    }
+    loaded->Combine(other);
+    control->Combine(other);
+    ExpectSameCells(*loaded, *control);
+}
+
+TEST(RegistryTest, RemoveFromLoadedSketch) {
+    auto original = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(4, 3, 16);
+    auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(4, 3, 16);
+    for (size_t i = 0; i < 2000; i++) {
+        original->AddRecord(i % 10, i);
+        if (i % 3 != 0) {
+            control->AddRecord(i % 10, i);
+        }
+    }
+    original->Flatten();
+    ReplaceWithColumn("remove_loaded", original);
+    const std::string path = testing::TempDir() + "remove_loaded__att.omni";
+    for (const auto sample_encoding :
+         {omnisketch::sketch_file::SampleEncoding::RAW, omnisketch::sketch_file::SampleEncoding::DELTA}) {
+        omnisketch::Registry::SerializeBinary("remove_loaded", "att", {}, path, sample_encoding);
+        auto loaded = ReadColumn<size_t>(path);
+        ASSERT_NE(loaded, nullptr);
+        for (size_t i = 0; i < 2000; i += 3) {
+            loaded->RemoveRecord(i % 10, i);
+        }
+        EXPECT_GT(loaded->UnderfilledCellCount(), 0);
+        // Underfilled cells keep the smallest record id hashes of the rebuilt cell
+        ExpectSameCells(*loaded, *control, true);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(RegistryTest, AppendToLoadedUnderfilledSketch) {
+    auto original = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(4, 3, 16);
+    // Holds the smallest record id hashes of the remaining records
+    auto control = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(4, 3, 16);
+    for (size_t i = 0; i < 2000; i++) {
+        original->AddRecord(i % 10, i);
+        if (i % 3 != 0) {
+            control->AddRecord(i % 10, i);
+        }
+    }
+    for (size_t i = 0; i < 2000; i += 3) {
+        original->RemoveRecord(i % 10, i);
+    }
+    ASSERT_GT(original->UnderfilledCellCount(), 0);
+    ReplaceWithColumn("append_underfilled", original);
+    const std::string path = testing::TempDir() + "append_underfilled__att";
+    const std::vector<std::string> paths = {path + ".json", path + "_raw.omni", path + "_delta.omni"};
+    omnisketch::Registry::Serialize("append_underfilled", "att", {}, paths[0]);
+    omnisketch::Registry::SerializeBinary("append_underfilled", "att", {}, paths[1],
+                                          omnisketch::sketch_file::SampleEncoding::RAW);
+    omnisketch::Registry::SerializeBinary("append_underfilled", "att", {}, paths[2],
+                                          omnisketch::sketch_file::SampleEncoding::DELTA);
+    for (size_t i = 2000; i < 2400; i++) {
+        original->AddRecord(i % 10, i);
+        control->AddRecord(i % 10, i);
+    }
+    ExpectSameCells(*original, *control, true);
+
+    for (const auto& file : paths) {
+        auto loaded = ReadColumn<size_t>(file);
+        ASSERT_NE(loaded, nullptr);
+        EXPECT_GT(loaded->UnderfilledCellCount(), 0);
+        for (size_t i = 2000; i < 2400; i++) {
+            loaded->AddRecord(i % 10, i);
+        }
+        // The loaded sketch only samples records up to the largest sample of an underfilled cell, so it may hold
+        // fewer samples than the in-memory one, but never others than the smallest
+        ExpectSameCells(*loaded, *original, true);
+        ExpectSameCells(*loaded, *control, true);
+        std::remove(file.c_str());
+    }
+}
+
+TEST(RegistryTest, OverwriteMappedSketchFile) {
+    auto original = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(64, 3, 256);
+    for (size_t i = 0; i < 100000; i++) {
+        original->AddRecord(i % 1000, i);
+    }
+    original->Flatten();
+    ReplaceWithColumn("overwrite", original);
+    const std::string path = testing::TempDir() + "overwrite__att.omni";
+    omnisketch::Registry::SerializeBinary("overwrite", "att", {}, path, omnisketch::sketch_file::SampleEncoding::RAW);
+    const auto loaded = ReadColumn<size_t>(path);
+    ASSERT_NE(loaded, nullptr);
+    ASSERT_TRUE(loaded->IsFlattened());
+
+    // A much smaller sketch replaces the file while the loaded one still reads its cells from the mapping
+    ReplaceWithColumn("overwrite", std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(64, 3, 256));
+    omnisketch::Registry::SerializeBinary("overwrite", "att", {}, path, omnisketch::sketch_file::SampleEncoding::RAW);
+    ExpectSameCells(*loaded, *original);
+    EXPECT_EQ(ReadColumn<size_t>(path)->RecordCount(), 0);
+    struct stat buffer;
+    EXPECT_NE(stat((path + ".tmp").c_str(), &buffer), 0);
+    std::remove(path.c_str());
+}
+
+TEST(RegistryTest, RejectCorruptedBinaryFiles) {
+    auto original = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(8, 3, 16);
+    for (size_t i = 0; i < 1000; i++) {
+        original->AddRecord(i % 50, i);
+    }
+    original->Flatten();
+    ReplaceWithColumn("corrupt", original);
+    const std::string path = testing::TempDir() + "corrupt__att.omni";
+    omnisketch::Registry::SerializeBinary("corrupt", "att", {}, path, omnisketch::sketch_file::SampleEncoding::RAW);
+    std::string bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    // Offsets of the header fields, see FileHeader in sketch_file.cpp
+    constexpr size_t WIDTH_OFFSET = 24;
+    constexpr size_t STRING_LENGTHS_OFFSET = 88;
+    constexpr size_t SAMPLE_WIDTH_OFFSET = 132;
+    constexpr size_t HEADER_SIZE = 136;
+    size_t string_bytes = 0;
+    for (size_t string_idx = 0; string_idx < 5; string_idx++) {
+        uint64_t length;
+        std::memcpy(&length, bytes.data() + STRING_LENGTHS_OFFSET + string_idx * sizeof(uint64_t), sizeof(length));
+        string_bytes += length;
+    }
+    const size_t cell_count = original->Width() * original->Depth();
+    const size_t arrays_offset = (HEADER_SIZE + string_bytes + 7) / 8 * 8;
+    const size_t first_offset = arrays_offset + cell_count * sizeof(uint64_t);
+
+    auto expect_rejected = [&](size_t position, const void* value, size_t size) {
+        std::string corrupted = bytes;
+        std::memcpy(&corrupted[position], value, size);
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(corrupted.data(), static_cast<std::streamsize>(corrupted.size()));
+        }
+        omnisketch::RegistrySnapshot snapshot;
+        EXPECT_THROW(omnisketch::Registry::DeserializeInto(path, snapshot), std::runtime_error);
+    };
+    const uint64_t huge_width = uint64_t(1) << 62;
+    expect_rejected(WIDTH_OFFSET, &huge_width, sizeof(huge_width));
+    const uint32_t unknown_sample_width = 48;
+    expect_rejected(SAMPLE_WIDTH_OFFSET, &unknown_sample_width, sizeof(unknown_sample_width));
+    // An offset beyond its successor would make the cell's sample count wrap around
+    const uint64_t out_of_order_offset = original->GetCell(0, 0).SampleCount() + 1000;
+    expect_rejected(first_offset + sizeof(uint64_t), &out_of_order_offset, sizeof(out_of_order_offset));
+
+    // Delta-encoded cells: record counts, sample counts, block offsets, word offsets, then the blocks
+    omnisketch::Registry::SerializeBinary("corrupt", "att", {}, path, omnisketch::sketch_file::SampleEncoding::DELTA);
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    ASSERT_EQ(original->GetCell(0, 0).SampleCount(), 16);
+    const size_t first_sample_count = arrays_offset + cell_count * sizeof(uint64_t);
+    const size_t first_block = arrays_offset + (4 * cell_count + 2) * sizeof(uint64_t);
+    const uint64_t excess_sample_count = 17;
+    expect_rejected(first_sample_count, &excess_sample_count, sizeof(excess_sample_count));
+    const uint32_t huge_word_offset = 1000;
+    expect_rejected(first_block + offsetof(omnisketch::MinHashSketchCompressed::Block, word_offset),
+                    &huge_word_offset, sizeof(huge_word_offset));
+    for (const uint32_t bit_width : {0, 65}) {
+        expect_rejected(first_block + offsetof(omnisketch::MinHashSketchCompressed::Block, bit_width), &bit_width,
+                        sizeof(bit_width));
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST(RegistryTest, RejectBlockedCellMapper) {
+    auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(
+        64, 3, 16, std::make_shared<omnisketch::MurmurHashFunction<size_t>>(),
+        std::make_shared<omnisketch::ProbeAllSum>(), std::make_shared<omnisketch::BlockedSplitHashMapper>(64),
+        std::make_shared<omnisketch::MinHashSketchSet::SketchFactory>());
+    for (size_t i = 0; i < 1000; i++) {
+        sketch->AddRecord(i % 50, i);
+    }
+    ReplaceWithColumn("blocked", sketch);
+    // Loaded sketches would map the hashes to other columns than the ones the records were added to
+    const std::string path = testing::TempDir() + "blocked__att";
+    EXPECT_THROW(omnisketch::Registry::SerializeBinary("blocked", "att", {}, path + ".omni",
+                                                       omnisketch::sketch_file::SampleEncoding::RAW),
+                 std::logic_error);
+    EXPECT_THROW(omnisketch::Registry::Serialize("blocked", "att", {}, path + ".json"), std::logic_error);
+    struct stat buffer;
+    EXPECT_NE(stat((path + ".omni").c_str(), &buffer), 0);
+    EXPECT_NE(stat((path + ".json").c_str(), &buffer), 0);
+}
+
+TEST(RegistryTest, LazySketchDirectory) {
+    auto& registry = omnisketch::Registry::Get();
+    auto create_column = [](size_t record_count) {
+        auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 16);
+        for (size_t i = 0; i < record_count; i++) {
+            sketch->AddRecord(i % 10, i);
+        }
+        sketch->Flatten();
+        return omnisketch::OmniSketchEntry{sketch, {}};
+    };
+    registry.ReplaceTable("lazy_a", {{"x", create_column(100)}}, std::make_shared<omnisketch::OmniSketchCell>(16));
+    registry.ReplaceTable("lazy_b", {{"y", create_column(200)}, {"z", create_column(200)}},
+                          std::make_shared<omnisketch::OmniSketchCell>(16));
+
+    const std::string directory = testing::TempDir() + "lazy_sketches/";
+    mkdir(directory.c_str(), 0755);
+    const std::vector<std::string> files = {directory + "lazy_a__x.json", directory + "lazy_a__RIDS.json",
+                                            directory + "lazy_b__y.omni", directory + "lazy_b__z.omni",
+                                            directory + "lazy_b__RIDS.omni"};
+    omnisketch::Registry::Serialize("lazy_a", "x", {}, files[0]);
+    omnisketch::Registry::Serialize("lazy_a", {}, {}, files[1]);
+    omnisketch::Registry::SerializeBinary("lazy_b", "y", {}, files[2]);
+    omnisketch::Registry::SerializeBinary("lazy_b", "z", {}, files[3]);
+    omnisketch::Registry::SerializeBinary("lazy_b", {}, {}, files[4]);
+
+    // With a budget of a single byte, only the most recently used sketch stays loaded
+    registry.SetLazySketchDirectory(directory, 1);
+    const auto sketch_directory = registry.Snapshot()->directory;
+    ASSERT_NE(sketch_directory, nullptr);
+    EXPECT_TRUE(registry.HasOmniSketch("lazy_b", "y"));
+    EXPECT_FALSE(registry.HasOmniSketch("lazy_b", "x"));
+    EXPECT_EQ(sketch_directory->LoadedSketchCount(), 0);
+    // The headers of binary files are indexed, so their shape is known before they are loaded
+    const auto* file_info = sketch_directory->FindFileInfo("lazy_b", "y");
+    ASSERT_NE(file_info, nullptr);
+    EXPECT_EQ(file_info->record_count, 200);
+    EXPECT_EQ(file_info->width, 16);
+    EXPECT_EQ(sketch_directory->FindFileInfo("lazy_a", "x"), nullptr);
+    EXPECT_GT(sketch_directory->IndexedByteSize(), 0);
+    EXPECT_EQ(registry.GetMinHashSketchSize("lazy_b"), 16);
+    EXPECT_EQ(sketch_directory->LoadedSketchCount(), 0);
+
+    EXPECT_EQ(registry.GetBaseTableCard("lazy_b"), 200);
+    EXPECT_EQ(sketch_directory->LoadedSketchCount(), 1);
+    const auto evicted_sketch = registry.GetOmniSketch("lazy_b", "y");
+    EXPECT_EQ(registry.GetOmniSketch("lazy_a", "x")->RecordCount(), 100);
+    EXPECT_NE(registry.GetRidSample("lazy_a"), nullptr);
+    EXPECT_EQ(sketch_directory->LoadedSketchCount(), 1);
+    EXPECT_EQ(evicted_sketch->RecordCount(), 200);
+
+    registry.SetLazySketchDirectory(directory);
+    EXPECT_EQ(registry.GetOmniSketch("lazy_b", "z")->RecordCount(), 200);
+    EXPECT_EQ(registry.GetOmniSketch("lazy_b", "z"), registry.GetOmniSketch("lazy_b", "z"));
+    EXPECT_EQ(registry.GetMinHashSketchSize("lazy_a"), 16);
+    EXPECT_EQ(registry.Snapshot()->directory->LoadedSketchCount(), 2);
+
+    for (const auto& file : files) {
+        std::remove(file.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+TEST(RegistryTest, ParallelSketchDirectory) {
+    auto& registry = omnisketch::Registry::Get();
+    const std::string directory = testing::TempDir() + "parallel_sketches/";
+    mkdir(directory.c_str(), 0755);
+    std::vector<std::string> files;
+    for (size_t table_idx = 0; table_idx < 8; table_idx++) {
+        auto sketch = std::make_shared<omnisketch::TypedPointOmniSketch<size_t>>(16, 3, 16);
+        for (size_t i = 0; i < 100 * (table_idx + 1); i++) {
+            sketch->AddRecord(i % 10, i);
+        }
+        sketch->Flatten();
+        const std::string table_name = "parallel_" + std::to_string(table_idx);
+        registry.ReplaceTable(table_name, {{"x", omnisketch::OmniSketchEntry{sketch, {}}}},
+                              std::make_shared<omnisketch::OmniSketchCell>(16));
+        files.push_back(directory + table_name + "__x.json");
+        files.push_back(directory + table_name + "__RIDS.omni");
+        omnisketch::Registry::Serialize(table_name, "x", {}, files[files.size() - 2]);
+        omnisketch::Registry::SerializeBinary(table_name, {}, {}, files.back());
+    }
+
+    omnisketch::ThreadPool thread_pool(3);
+    registry.SetSketchDirectory(directory, thread_pool);
+    for (size_t table_idx = 0; table_idx < 8; table_idx++) {
+        const std::string table_name = "parallel_" + std::to_string(table_idx);
+        EXPECT_EQ(registry.GetBaseTableCard(table_name), 100 * (table_idx + 1));
+        EXPECT_TRUE(registry.GetOmniSketch(table_name, "x")->IsFlattened());
+        EXPECT_NE(registry.GetRidSample(table_name), nullptr);
+    }
+    EXPECT_EQ(registry.Snapshot()->sketches.size(), 8);
+
+    for (const auto& file : files) {
+        std::remove(file.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+TEST(RegistryTest, AppendTableToCheckpoint) {
+    auto& registry = omnisketch::Registry::Get();
+    const std::string base_path = testing::TempDir() + "append_base.csv";
+    const std::string delta_path = testing::TempDir() + "append_delta.csv";
+    const std::string full_path = testing::TempDir() + "append_full.csv";
+    {
+        std::ofstream base(base_path);
+        std::ofstream delta(delta_path);
+        std::ofstream full(full_path);
+        for (size_t rid = 0; rid < 3000; rid++) {
+            const std::string line = std::to_string(rid) + "," + std::to_string(rid % 37) + "\n";
+            (rid < 2500 ? base : delta) << line;
+            full << line;
+        }
+    }
+    omnisketch::OmniSketchConfig config;
+    config.SetWidth(16);
+    config.sample_count = 32;
+    const std::vector<std::string> column_names = {"rid", "x"};
+    const std::vector<omnisketch::ColumnType> types = {omnisketch::ColumnType::UINT, omnisketch::ColumnType::UINT};
+
+    // Checkpoint of the base rows, appended to with the delta rows
+    omnisketch::CSVImporter::ImportTable(base_path, "append", column_names, {}, {}, types, config);
+    const std::string sketch_path = testing::TempDir() + "append__x.omni";
+    const std::string rid_path = testing::TempDir() + "append__RIDS.omni";
+    omnisketch::Registry::SerializeBinary("append", "x", {}, sketch_path);
+    omnisketch::Registry::SerializeBinary("append", {}, {}, rid_path);
+    registry.Deserialize(sketch_path);
+    registry.Deserialize(rid_path);
+    omnisketch::CSVImporter::AppendTable(delta_path, "append", column_names, {}, {}, types, 2);
+
+    omnisketch::CSVImporter::ImportTable(full_path, "append_control", column_names, {}, {}, types, config);
+    const auto appended = registry.GetOmniSketchTyped<size_t>("append", "x");
+    const auto control = registry.GetOmniSketchTyped<size_t>("append_control", "x");
+    EXPECT_EQ(appended->RecordCount(), 3000);
+    EXPECT_EQ(appended->GetMax(), control->GetMax());
+    EXPECT_EQ(registry.GetRidSample("append")->RecordCount(), 3000);
+    ExpectSameCells(*appended, *control);
+
+    for (const auto& path : {base_path, delta_path, full_path, sketch_path, rid_path}) {
+        std::remove(path.c_str());
+    }
+}
+
+TEST(RegistryTest, BatchImportMatchesCsvImport) {
+    auto& registry = omnisketch::Registry::Get();
+    const size_t row_count = 3000;
+    const std::string path = testing::TempDir() + "batch_control.csv";
+    std::vector<uint64_t> rids(row_count);
+    std::vector<size_t> xs(row_count);
+    std::vector<double> ys(row_count);
+    std::string s_data;
+    std::vector<uint32_t> s_offsets = {0};
+    std::vector<uint64_t> x_validity((row_count + 63) / 64);
+    std::vector<uint64_t> s_validity((row_count + 63) / 64);
+    {
+        // Empty fields are nulls
+        std::ofstream file(path);
+        for (size_t rid = 0; rid < row_count; rid++) {
+            rids[rid] = rid;
+            xs[rid] = rid % 37;
+            ys[rid] = static_cast<double>(rid % 101) * 0.5;
+            const std::string s = "v" + std::to_string(rid % 53);
+            file << rid << "," << (rid % 7 == 0 ? "" : std::to_string(xs[rid])) << "," << std::to_string(ys[rid])
+                 << "," << (rid % 5 == 0 ? "" : s) << "\n";
+            if (rid % 7 != 0) {
+                x_validity[rid / 64] |= uint64_t(1) << (rid % 64);
+            }
+            if (rid % 5 != 0) {
+                s_validity[rid / 64] |= uint64_t(1) << (rid % 64);
+                s_data += s;
+            }
+            s_offsets.push_back(static_cast<uint32_t>(s_data.size()));
+        }
+    }
+    omnisketch::OmniSketchConfig config;
+    config.SetWidth(16);
+    config.sample_count = 32;
+    const std::vector<omnisketch::ColumnType> types = {omnisketch::ColumnType::UINT, omnisketch::ColumnType::DOUBLE,
+                                                       omnisketch::ColumnType::VARCHAR};
+    omnisketch::CSVImporter::ImportTable(path, "batch_control", {"rid", "x", "y", "s"}, {}, {},
+                                         {omnisketch::ColumnType::UINT, types[0], types[1], types[2]}, config);
+
+    // Two batches, the second one does not fill its last validity word
+    omnisketch::BatchImporter importer("batch", {"x", "y", "s"}, types, config);
+    for (const size_t begin : {size_t(0), size_t(2048)}) {
+        const size_t end = begin == 0 ? 2048 : row_count;
+        omnisketch::ColumnBatch batch;
+        batch.row_count = end - begin;
+        batch.rids = rids.data() + begin;
+        batch.columns = {omnisketch::ColumnVector::FromValues(xs.data() + begin, x_validity.data() + begin / 64),
+                         omnisketch::ColumnVector::FromValues(ys.data() + begin),
+                         omnisketch::ColumnVector::FromStrings(s_data.data(), s_offsets.data() + begin,
+                                                               s_validity.data() + begin / 64)};
+        importer.Append(batch);
+    }
+    importer.Finish();
+    // The registered sketches may already be probed
+    omnisketch::ColumnBatch late_batch;
+    late_batch.columns.resize(3);
+    EXPECT_THROW(importer.Append(late_batch), std::logic_error);
+
+    EXPECT_EQ(registry.GetRidSample("batch")->RecordCount(), row_count);
+    EXPECT_EQ(registry.GetOmniSketchTyped<std::string>("batch", "s")->GetMax(),
+              registry.GetOmniSketchTyped<std::string>("batch_control", "s")->GetMax());
+    EXPECT_EQ(registry.GetOmniSketchTyped<double>("batch", "y")->GetMin(),
+              registry.GetOmniSketchTyped<double>("batch_control", "y")->GetMin());
+    for (const std::string column_name : {"x", "y", "s"}) {
+        const auto sketch = registry.GetOmniSketch("batch", column_name);
+        const auto control = registry.GetOmniSketch("batch_control", column_name);
+        EXPECT_EQ(sketch->CountNulls(), control->CountNulls());
+        ExpectSameCells(*sketch, *control);
+    }
+
+    std::remove(path.c_str());
+}